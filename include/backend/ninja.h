@@ -8,9 +8,16 @@
 
 #include "lang/workspace.h"
 
+struct ninja_compdb;
+struct ninja_compiler_rules;
+
 struct write_tgt_ctx {
 	FILE *out;
+	// where compiler rules are written, as they must be visible to all targets
+	FILE *rules_out;
 	const struct project *proj;
+	struct ninja_compdb *compdb;
+	struct ninja_compiler_rules *compiler_rules;
 	bool wrote_default;
 };
 
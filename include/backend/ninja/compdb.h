@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_BACKEND_NINJA_COMPDB_H
+#define MUON_BACKEND_NINJA_COMPDB_H
+#include "lang/workspace.h"
+
+struct ninja_compdb {
+	struct sbuf buf;
+	bool have_entries;
+};
+
+void ninja_compdb_init(struct workspace *wk, struct ninja_compdb *db);
+void ninja_compdb_destroy(struct ninja_compdb *db);
+void ninja_compdb_push(struct workspace *wk,
+	struct ninja_compdb *db,
+	obj comp_id,
+	obj ninja_args,
+	const char *src,
+	const char *out);
+bool ninja_compdb_write(struct workspace *wk, void *_ctx, FILE *out);
+#endif
@@ -7,6 +7,28 @@
 #define MUON_BACKEND_NINJA_RULES_H
 #include "lang/workspace.h"
 
-bool
-ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bool need_phony, obj compiler_rule_arr);
+struct obj_compiler;
+
+obj ninja_compiler_command(struct workspace *wk,
+	struct obj_compiler *comp,
+	obj rule_args,
+	const char *in,
+	const char *out,
+	const char *depfile);
+
+struct ninja_compiler_rules {
+	struct hash h, ids;
+	struct arr keys;
+};
+
+void ninja_compiler_rules_init(struct ninja_compiler_rules *rules);
+void ninja_compiler_rules_destroy(struct ninja_compiler_rules *rules);
+obj ninja_compiler_rule(struct workspace *wk,
+	struct ninja_compiler_rules *rules,
+	FILE *out,
+	const struct project *proj,
+	enum compiler_language l,
+	obj args);
+
+bool ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bool need_phony);
 #endif
@@ -9,7 +9,8 @@
 #include "lang/workspace.h"
 
 struct output_path {
-	const char *private_dir, *summary, *tests, *install, *compiler_check_cache, *option_info;
+	const char *private_dir, *summary, *tests, *install, *compiler_check_cache, *pkgconf_cache,
+		*program_version_cache, *python_cache, *bytecode_cache, *option_info, *configure_fingerprint;
 };
 
 extern const struct output_path output_path;
@@ -18,4 +19,15 @@ typedef bool((with_open_callback)(struct workspace *wk, void *ctx, FILE *out));
 
 FILE *output_open(const char *dir, const char *name);
 bool with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, with_open_callback cb);
+/*
+ * Like with_open, and sets *changed if the output was replaced.  If *changed
+ * is already set once cb returns, the output is replaced even if its
+ * contents are the same.
+ */
+bool with_open_changed(const char *dir,
+	const char *name,
+	struct workspace *wk,
+	void *ctx,
+	with_open_callback cb,
+	bool *changed);
 #endif
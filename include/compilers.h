@@ -27,12 +27,13 @@ struct obj_compiler;
 	_(nasm, "nasm", "nasm")                    \
 	_(yasm, "yasm", "yasm")
 
-#define FOREACH_TOOLCHAIN_LINKER_TYPE(_)    \
-	_(posix, "posix", "posix")          \
-	_(ld, "ld", "ld")                   \
-	_(clang, "lld", "lld")              \
-	_(apple, "ld64", "ld64")            \
-	_(lld_link, "lld-link", "lld-link") \
+#define FOREACH_TOOLCHAIN_LINKER_TYPE(_)             \
+	_(posix, "posix", "posix")                   \
+	_(ld, "ld", "ld")                            \
+	_(clang, "lld", "lld")                       \
+	_(llvm_plugin, "llvm-plugin", "llvm-plugin") \
+	_(apple, "ld64", "ld64")                     \
+	_(lld_link, "lld-link", "lld-link")          \
 	_(msvc, "link", "link")
 
 #define FOREACH_TOOLCHAIN_STATIC_LINKER_TYPE(_) \
@@ -173,11 +174,16 @@ typedef const struct args *((*compiler_get_arg_func_ns)(TOOLCHAIN_SIG_ns));
 	_(specify_lang, compiler, TOOLCHAIN_PARAMS_1s)       \
 	_(color_output, compiler, TOOLCHAIN_PARAMS_1s)       \
 	_(enable_lto, compiler, TOOLCHAIN_PARAMS_0)          \
+	_(enable_thinlto, compiler, TOOLCHAIN_PARAMS_0)      \
 	_(always, compiler, TOOLCHAIN_PARAMS_0)              \
 	_(crt, compiler, TOOLCHAIN_PARAMS_1s1b)              \
 	_(debugfile, compiler, TOOLCHAIN_PARAMS_1s)          \
 	_(object_ext, compiler, TOOLCHAIN_PARAMS_0)          \
-	_(deps_type, compiler, TOOLCHAIN_PARAMS_0)
+	_(deps_type, compiler, TOOLCHAIN_PARAMS_0)           \
+	_(pch_type, compiler, TOOLCHAIN_PARAMS_0)            \
+	_(pch_ext, compiler, TOOLCHAIN_PARAMS_0)             \
+	_(pch_create, compiler, TOOLCHAIN_PARAMS_2s)         \
+	_(pch_use, compiler, TOOLCHAIN_PARAMS_2s)
 
 #define FOREACH_LINKER_ARG(_)                                \
 	_(lib, linker, TOOLCHAIN_PARAMS_1s)                  \
@@ -197,6 +203,9 @@ typedef const struct args *((*compiler_get_arg_func_ns)(TOOLCHAIN_SIG_ns));
 	_(fatal_warnings, linker, TOOLCHAIN_PARAMS_0)        \
 	_(whole_archive, linker, TOOLCHAIN_PARAMS_1s)        \
 	_(enable_lto, linker, TOOLCHAIN_PARAMS_0)            \
+	_(enable_thinlto, linker, TOOLCHAIN_PARAMS_0)        \
+	_(lto_threads, linker, TOOLCHAIN_PARAMS_1i)          \
+	_(thinlto_cache_dir, linker, TOOLCHAIN_PARAMS_1s)    \
 	_(input_output, linker, TOOLCHAIN_PARAMS_2s)         \
 	_(always, linker, TOOLCHAIN_PARAMS_0)
 
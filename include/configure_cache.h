@@ -0,0 +1,16 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_CONFIGURE_CACHE_H
+#define MUON_CONFIGURE_CACHE_H
+
+#include "lang/workspace.h"
+
+bool configure_cache_enabled(struct workspace *wk);
+bool configure_cache_load(struct workspace *wk, const char *name, obj *res);
+obj configure_cache_stamp(struct workspace *wk, const char *path);
+void configure_cache_record(struct workspace *wk, obj files, const char *path);
+bool configure_cache_files_changed(struct workspace *wk, obj files);
+#endif
@@ -0,0 +1,17 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_CONFIGURE_FINGERPRINT_H
+#define MUON_CONFIGURE_FINGERPRINT_H
+
+#include "lang/workspace.h"
+
+struct run_cmd_ctx;
+
+const char *configure_fingerprint_getenv(struct workspace *wk, const char *name);
+void configure_fingerprint_run_command(struct workspace *wk, obj args, obj env, const struct run_cmd_ctx *cmd_ctx);
+bool configure_fingerprint_check(struct workspace *wk, bool force, obj *opts);
+bool configure_fingerprint_write(struct workspace *wk, obj opts);
+#endif
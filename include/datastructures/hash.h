@@ -18,7 +18,9 @@ typedef bool((*hash_keycmp)(const struct hash *h, const void *a, const void *b))
 typedef uint64_t((*hash_func)(const struct hash *h, const void *k));
 
 struct hash {
-	struct arr meta, e, keys;
+	// keys are stored in insertion order, key_slots maps each of them to
+	// its slot in the table, or hash_key_removed.
+	struct arr meta, e, keys, key_slots;
 	uint32_t cap, len, load, max_load, capm;
 	hash_keycmp keycmp;
 	hash_func hash_func;
@@ -38,6 +40,14 @@ void hash_unset(struct hash *h, const void *key);
 void hash_unset_strn(struct hash *h, const char *s, uint64_t len);
 void hash_clear(struct hash *h);
 
+// Advance *i to the next key in h->keys that hasn't been removed, starting at
+// *i, and return its value.  Returns NULL once all keys have been visited.
+uint64_t *hash_next_at(const struct hash *h, uint32_t *i);
+
 void hash_for_each(struct hash *h, void *ctx, iterator_func ifnc);
 void hash_for_each_with_keys(struct hash *h, void *ctx, hash_with_keys_iterator_func ifnc);
+
+// The hash function used for keys, for fingerprinting arbitrary data.
+uint64_t hash_bytes(const void *buf, uint64_t len);
+uint64_t hash_bytes_seeded(const void *buf, uint64_t len, uint64_t seed);
 #endif
@@ -5,5 +5,8 @@
 
 #ifndef MUON_EMBEDDED_H
 #define MUON_EMBEDDED_H
+#include <stdint.h>
+
+uint32_t embedded_hash(const char *name, uint32_t seed);
 const char *embedded_get(const char *name);
 #endif
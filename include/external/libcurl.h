@@ -11,7 +11,17 @@
 
 extern const bool have_libcurl;
 
+struct muon_curl_fetch_req {
+	const char *url;
+	void *ctx;
+	// called with each piece of data as it arrives, return false to abort
+	// the transfer
+	bool (*write)(void *ctx, const uint8_t *buf, uint64_t len);
+	// called once the transfer is complete
+	void (*done)(void *ctx, bool ok);
+};
+
 void muon_curl_init(void);
 void muon_curl_deinit(void);
-bool muon_curl_fetch(const char *url, uint8_t **buf, uint64_t *len);
+bool muon_curl_fetch_all(struct muon_curl_fetch_req *reqs, uint32_t len, uint32_t jobs);
 #endif
@@ -13,6 +13,11 @@ bool tgt_src_to_object_path(struct workspace *wk,
 	bool relative,
 	struct sbuf *res);
 
+void build_target_compile_units(struct workspace *wk,
+	const struct project *proj,
+	const struct obj_build_target *tgt,
+	obj *units,
+	obj *unity_sources);
 bool build_target_extract_all_objects(struct workspace *wk, uint32_t ip, obj self, obj *res, bool recursive);
 
 extern const struct func_impl impl_tbl_build_target[8];
@@ -7,6 +7,7 @@
 #define MUON_FUNCTIONS_EXTERNAL_PROGRAM_H
 #include "lang/func_lookup.h"
 
+bool find_program_in_path(struct workspace *wk, struct sbuf *buf, const char *cmd);
 void find_program_guess_version(struct workspace *wk, obj cmd_array, obj *ver);
 
 extern const struct func_impl impl_tbl_external_program[5];
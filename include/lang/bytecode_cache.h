@@ -0,0 +1,18 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_LANG_BYTECODE_CACHE_H
+#define MUON_LANG_BYTECODE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct workspace;
+struct source;
+
+bool bytecode_cache_key(struct workspace *wk, const struct source *src, uint32_t flags, uint8_t key[32]);
+bool bytecode_cache_load(struct workspace *wk, const uint8_t key[32], uint32_t *entry);
+void bytecode_cache_store(struct workspace *wk, const uint8_t key[32], uint32_t entry, uint32_t locations_start);
+#endif
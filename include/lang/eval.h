@@ -20,6 +20,8 @@ enum eval_mode {
 	eval_mode_default,
 	eval_mode_repl,
 	eval_mode_first,
+	// Look up and store the compiled code in the bytecode cache
+	eval_mode_cache = 1 << 2,
 };
 
 bool eval_project(struct workspace *wk,
@@ -22,6 +22,8 @@ struct func_impl {
 struct func_impl_group {
 	const struct func_impl *impls;
 	uint32_t off, len;
+	// perfect hash table of impls, see build_func_impl_tables
+	uint32_t slots, mask, disp, disp_mask;
 };
 
 extern struct func_impl_group func_impl_groups[obj_type_count][language_mode_count];
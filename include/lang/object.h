@@ -83,7 +83,9 @@ struct obj_func {
 
 	/*--------*/
 
-	uint32_t entry;
+	uint32_t entry, nlocals;
+	// When set, arguments and locals live in slots instead of a scope dict.
+	bool local_slots;
 	struct args_norm an[32];
 	struct args_kw akw[64];
 };
@@ -169,14 +171,20 @@ struct obj_module {
 	obj exports;
 };
 
+enum obj_array_flags {
+	// the array's elements may be shared with another array and must be
+	// copied before they are modified
+	obj_array_flag_cow = 1 << 0,
+};
+
 struct obj_array {
-	obj val; // any
-	obj next; // obj_array
-	obj tail; // obj_array
-	uint32_t len;
-	bool have_next;
+	uint32_t data; // offset into vm.objects.array_elems
+	uint32_t len, cap;
+	uint32_t flags; // enum obj_array_flags
 };
 
+#define obj_array_elem(__wk, __a, __i) (((obj *)(__wk)->vm.objects.array_elems.e)[(__a)->data + (__i)])
+
 enum obj_dict_flags {
 	obj_dict_flag_big = 1 << 0,
 	obj_dict_flag_int_key = 1 << 1,
@@ -245,6 +253,7 @@ struct obj_build_target {
 	obj generated_pc; // obj_string
 	obj override_options; // obj_array
 	obj required_compilers; // obj_dict
+	obj pch; // obj_dict
 
 	struct build_dep dep;
 	struct build_dep dep_internal;
@@ -494,7 +503,10 @@ struct range_params {
 struct obj_iterator {
 	enum obj_iterator_type type;
 	union {
-		struct obj_array *array;
+		struct {
+			struct obj_array *a;
+			uint32_t i;
+		} array;
 		struct obj_dict_elem *dict_small;
 		struct {
 			struct hash *h;
@@ -512,8 +524,10 @@ struct obj_iterator {
 
 struct obj_clear_mark {
 	uint32_t obji;
-	struct bucket_arr_save objs, chrs;
+	struct bucket_arr_save objs, chrs, dict_elems, dict_hashes;
 	struct bucket_arr_save obj_aos[obj_type_count - _obj_aos_start];
+	uint32_t array_elems_len, dict_elems_len, dict_hashes_len, prev_clear_mark_obji;
+	uint32_t array_elems_pinned, dict_elems_pinned, dict_hashes_pinned;
 };
 
 void make_obj(struct workspace *wk, obj *id, enum obj_type type);
@@ -522,9 +536,19 @@ enum obj_type get_obj_type(struct workspace *wk, obj id);
 void obj_set_clear_mark(struct workspace *wk, struct obj_clear_mark *mk);
 void obj_clear(struct workspace *wk, const struct obj_clear_mark *mk);
 
-void set_obj_bool(struct workspace *wk, obj o, bool v);
+/* Integers in the range [OBJ_IMMEDIATE_NUMBER_MIN, OBJ_IMMEDIATE_NUMBER_MAX]
+ * made with make_number are stored in the obj handle itself, tagged with
+ * OBJ_IMMEDIATE_NUMBER_BIT, instead of on the heap.  Numbers created with
+ * make_obj are always boxed so that set_obj_number can modify them.
+ */
+#define OBJ_IMMEDIATE_NUMBER_BIT (UINT32_C(1) << 31)
+#define OBJ_IMMEDIATE_NUMBER_MIN (-(INT64_C(1) << 30))
+#define OBJ_IMMEDIATE_NUMBER_MAX ((INT64_C(1) << 30) - 1)
+
+// Booleans are always one of the two constant objects obj_bool_true and
+// obj_bool_false and are never allocated.
+obj make_obj_bool(struct workspace *wk, bool v);
 bool get_obj_bool(struct workspace *wk, obj o);
-void set_obj_bool(struct workspace *wk, obj o, bool v);
 obj make_number(struct workspace *wk, int64_t n);
 int64_t get_obj_number(struct workspace *wk, obj o);
 void set_obj_number(struct workspace *wk, obj o, int64_t v);
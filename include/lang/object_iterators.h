@@ -18,15 +18,15 @@
 
 struct obj_array_for_helper {
 	struct obj_array *a;
+	uint32_t i;
 };
 
-#define obj_array_for_(__wk, __arr, __val, __iter)                                        \
-	struct obj_array_for_helper __iter = {                                            \
-		.a = get_obj_array(__wk, __arr),                                          \
-	};                                                                                \
-	for (__val = __iter.a->len ? __iter.a->val : 0; __val;                            \
-		__iter.a = __iter.a->have_next ? get_obj_array(__wk, __iter.a->next) : 0, \
-	    __val = __iter.a ? __iter.a->val : 0)
+#define obj_array_for_(__wk, __arr, __val, __iter)                                                \
+	struct obj_array_for_helper __iter = {                                                    \
+		.a = get_obj_array(__wk, __arr),                                                  \
+	};                                                                                        \
+	for (__val = __iter.a->len ? obj_array_elem(__wk, __iter.a, 0) : 0; __val;                \
+		__val = ++__iter.i < __iter.a->len ? obj_array_elem(__wk, __iter.a, __iter.i) : 0)
 
 #define obj_array_for(__wk, __arr, __val) obj_array_for_(__wk, __arr, __val, CONCAT(__iter, __LINE__))
 
@@ -38,15 +38,13 @@ struct obj_dict_for_helper {
 	struct obj_dict *d;
 	struct hash *h;
 	struct obj_dict_elem *e;
-	void *k;
 	uint64_t *v;
 	uint32_t i;
 	bool big;
 };
 
-#define obj_dict_for_get_kv_big(__iter, __key, __val)                                           \
-	__iter.k = arr_get(&__iter.h->keys, __iter.i), __iter.v = hash_get(__iter.h, __iter.k), \
-	__key = *__iter.v >> 32, __val = *__iter.v & 0xffffffff
+#define obj_dict_for_get_kv_big(__iter, __key, __val) \
+	(__iter.v = hash_next_at(__iter.h, &__iter.i)) ? (__key = *__iter.v >> 32, __val = *__iter.v & 0xffffffff) : 0
 
 #define obj_dict_for_get_kv(__iter, __key, __val) __key = __iter.e->key, __val = __iter.e->val
 
@@ -61,11 +59,10 @@ struct obj_dict_for_helper {
 	    __iter.e = __iter.big    ? 0 :                                                                       \
 		       __iter.d->len ? bucket_arr_get(&__wk->vm.objects.dict_elems, __iter.d->data) :            \
 				       0,                                                                        \
-	    __iter.big ? (__iter.i < __iter.h->keys.len ? (obj_dict_for_get_kv_big(__iter, __key, __val)) : 0) : \
+	    __iter.big ? (obj_dict_for_get_kv_big(__iter, __key, __val)) :                                      \
 			 (__iter.e ? (obj_dict_for_get_kv(__iter, __key, __val)) : 0);                           \
-		__iter.big ? __iter.i < __iter.h->keys.len : !!__iter.e;                                         \
-		__iter.big ? (++__iter.i,                                                                        \
-			(__iter.i < __iter.h->keys.len ? (obj_dict_for_get_kv_big(__iter, __key, __val)) : 0)) : \
+		__iter.big ? !!__iter.v : !!__iter.e;                                                            \
+		__iter.big ? (++__iter.i, (obj_dict_for_get_kv_big(__iter, __key, __val))) :                     \
 			     (__iter.e = __iter.e->next ?                                                        \
 						 bucket_arr_get(&__wk->vm.objects.dict_elems, __iter.e->next) :  \
 						 0,                                                              \
@@ -77,8 +74,13 @@ struct obj_dict_for_helper {
  * obj_array_flat_for
  ******************************************************************************/
 
-struct obj_array_flat_iter_ctx {
+struct obj_array_flat_iter_pos {
 	struct obj_array *a;
+	uint32_t i;
+};
+
+struct obj_array_flat_iter_ctx {
+	struct obj_array_flat_iter_pos pos;
 	uint32_t pushed;
 	bool init;
 };
@@ -73,6 +73,7 @@ void str_app(struct workspace *wk, obj *s, const char *str);
 void str_appf(struct workspace *wk, obj *s, const char *fmt, ...) MUON_ATTR_FORMAT(printf, 3, 4);
 void str_appn(struct workspace *wk, obj *s, const char *str, uint32_t n);
 void str_apps(struct workspace *wk, obj *s, obj s_id);
+void str_apps_owned(struct workspace *wk, obj s, uint32_t *cap, obj s_id);
 
 obj str_clone(struct workspace *wk_src, struct workspace *wk_dest, obj val);
 obj str_clone_mutable(struct workspace *wk, obj val);
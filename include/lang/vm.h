@@ -34,6 +34,9 @@ enum op {
 	op_add_store,
 	op_load,
 	op_try_load,
+	op_load_local,
+	op_store_local,
+	op_add_store_local,
 	op_return,
 	op_return_end,
 	op_call,
@@ -73,6 +76,7 @@ enum compile_time_constant_objects {
 	disabler_id = 1,
 	obj_bool_true = 2,
 	obj_bool_false = 3,
+	vm_reserved_objects_end,
 };
 
 struct obj_stack_entry {
@@ -100,7 +104,7 @@ struct call_frame {
 	type_tag expected_return_type;
 	enum call_frame_type type;
 	obj scope_stack;
-	uint32_t return_ip, call_stack_base;
+	uint32_t return_ip, call_stack_base, locals_base;
 	enum language_mode lang_mode;
 };
 
@@ -108,6 +112,10 @@ struct vm_compiler_state {
 	struct bucket_arr nodes;
 	struct arr node_stack;
 	struct arr loop_jmp_stack, if_jmp_stack;
+	// Names of the locals of the function body being compiled, indexed by
+	// slot.  Only used while resolve_locals is set.
+	struct arr locals;
+	bool resolve_locals;
 	bool err;
 };
 
@@ -144,8 +152,29 @@ struct vm_objects {
 	struct bucket_arr objs;
 	struct bucket_arr dict_elems, dict_hashes;
 	struct bucket_arr obj_aos[obj_type_count - _obj_aos_start];
+	struct arr array_elems;
 	struct hash obj_hash, str_hash;
+	// buffers loaded by serial_load, which strings may point into
+	struct arr serial_bufs;
 	bool obj_clear_mark_set;
+	// obji of the innermost clear mark, and the end of the furthest
+	// array_elems, dict_elems, or dict_hashes allocation made for a container
+	// older than it.  See obj_clear.
+	uint32_t clear_mark_obji, array_elems_pinned, dict_elems_pinned, dict_hashes_pinned;
+	// containers older than the outermost clear mark that were handed an
+	// object newer than the innermost one, checked by obj_clear in debug
+	// builds.
+	struct arr clear_mark_stores;
+	// Total bytes released by obj_clear, for profiling.
+	uint64_t reclaimed_bytes;
+};
+
+// Inline cache for a single op_call_method call site, remembering the
+// native function the last receiver type resolved to.
+struct vm_method_cache_entry {
+	uint32_t idx;
+	uint8_t type, lang_mode;
+	bool valid;
 };
 
 typedef void((*vm_op_fn)(struct workspace *wk));
@@ -153,12 +182,27 @@ struct vm_ops {
 	vm_op_fn ops[op_count];
 };
 
+// A string built up by += that is referenced only by the variable holding
+// it.  cap is the capacity of its buffer, or 0 if it has no growable buffer
+// yet.
+struct vm_owned_str {
+	obj s;
+	uint32_t cap;
+};
+
 struct vm {
 	struct object_stack stack;
 	struct arr call_stack, locations, code, src;
+	struct arr method_cache;
+	// Local variable slots of all active function frames, the current
+	// frame's slots begin at locals_base.
+	struct arr locals;
+	uint32_t locals_base;
 	uint32_t ip, nargs, nkwargs;
 	obj scope_stack, default_scope_stack;
 	obj module_path;
+	// Direct-mapped by object id, see vm_add_store_value.
+	struct vm_owned_str owned_strs[16];
 
 	struct vm_ops ops;
 	struct vm_objects objects;
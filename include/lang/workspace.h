@@ -78,8 +78,24 @@ struct workspace {
 	obj global_opts;
 	/* dict[sha_512 -> [bool, any]] */
 	obj compiler_check_cache;
+	/* dict, pkgconf lookup cache.  Only set if it should be persisted */
+	obj pkgconf_cache;
+	/* find_program caches, initialized on first use.
+	 * dict[str -> str|false], see find_program_in_path */
+	obj find_program_path_cache;
+	/* dict[str -> [str|false, dict]], see find_program_guess_version */
+	obj program_version_cache;
+	/* dict[str -> dict], see python_cache.  Initialized on first use */
+	obj python_cache;
+	/* dict[sha_256 -> [str, list, list]], see bytecode_cache_load.
+	 * Initialized on first use */
+	obj bytecode_cache, bytecode_cache_prev;
 	/* dict -> capture */
 	obj dependency_handlers;
+	/* dict[str -> str|false] of environment variables read and
+	 * list[[list, dict, str]] of run_command() results, see
+	 * configure_fingerprint.c */
+	obj fingerprint_env, fingerprint_run_commands;
 	/* list[str], used for error reporting */
 	obj backend_output_stack;
 	/* ----------------- */
@@ -92,6 +108,9 @@ struct workspace {
 
 	uint32_t cur_project;
 
+	/* set by muon setup -p, see profile.c */
+	struct profile *profile;
+
 #ifdef TRACY_ENABLE
 	struct {
 		bool is_master_workspace;
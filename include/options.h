@@ -51,6 +51,7 @@ enum wrap_mode {
 enum wrap_mode get_option_wrap_mode(struct workspace *wk);
 enum tgt_type get_option_default_library(struct workspace *wk);
 bool get_option_bool(struct workspace *wk, obj overrides, const char *name, bool fallback);
+bool get_option_unity(struct workspace *wk, const struct project *proj, obj overrides, uint32_t *unity_size);
 
 struct list_options_opts {
 	bool list_all, only_modified;
@@ -12,4 +12,9 @@ __declspec(noreturn) void win_assert_fail(const char *msg, const char *file, uin
 #  else
 #    include <assert.h>
 #  endif
+
+// C99 has no _Static_assert, a negative array size fails the build instead.
+#  define STATIC_ASSERT_CAT_(a, b) a##b
+#  define STATIC_ASSERT_CAT(a, b) STATIC_ASSERT_CAT_(a, b)
+#  define STATIC_ASSERT(x) typedef char STATIC_ASSERT_CAT(static_assertion_, __LINE__)[(x) ? 1 : -1]
 #endif
@@ -52,6 +52,18 @@ bool fs_is_a_tty(FILE *f);
 bool fs_chmod(const char *path, uint32_t mode);
 bool fs_copy_metadata(const char *src, const char *dest);
 bool fs_remove(const char *path);
+bool fs_rename(const char *src, const char *dest);
+
+// A FILE * whose contents are collected in memory.  buf and len are valid
+// after fs_memstream_close.
+struct fs_memstream {
+	FILE *f;
+	char *buf;
+	size_t len;
+};
+bool fs_memstream_open(struct fs_memstream *ms);
+bool fs_memstream_close(struct fs_memstream *ms);
+void fs_memstream_destroy(struct fs_memstream *ms);
 /* Windows only */
 bool fs_has_extension(const char *path, const char *ext);
 
@@ -77,6 +77,9 @@ bool run_cmd_determine_interpreter(struct source *src,
 	const char **new_argv0,
 	const char **new_argv1);
 
+// total seconds spent waiting on synchronously run commands, see profile.c
+extern double run_cmd_wait_time;
+
 bool run_cmd(struct run_cmd_ctx *ctx, const char *argstr, uint32_t argc, const char *envstr, uint32_t envc);
 bool run_cmd_argv(struct run_cmd_ctx *ctx, char *const *argv, const char *envstr, uint32_t envc);
 enum run_cmd_state run_cmd_collect(struct run_cmd_ctx *ctx);
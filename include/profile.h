@@ -0,0 +1,17 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_PROFILE_H
+#define MUON_PROFILE_H
+
+#include "lang/workspace.h"
+
+void profile_init(struct workspace *wk, const char *path);
+void profile_push(struct workspace *wk, const char *name);
+void profile_pop(struct workspace *wk);
+void profile_compiler_check(struct workspace *wk, bool cached);
+bool profile_write(struct workspace *wk);
+void profile_destroy(struct workspace *wk);
+#endif
@@ -9,5 +9,14 @@
 #include <stddef.h>
 #include <stdint.h>
 
+struct sha_256 {
+	uint32_t h[8];
+	uint8_t chunk[64];
+	size_t chunk_len, total_len;
+};
+
+void sha_256_init(struct sha_256 *sha);
+void sha_256_write(struct sha_256 *sha, const void *input, size_t len);
+void sha_256_close(struct sha_256 *sha, uint8_t hash[32]);
 void calc_sha_256(uint8_t hash[32], const void *input, size_t len);
 #endif
@@ -73,5 +73,6 @@ enum wrap_provides_key {
 void wrap_destroy(struct wrap *wrap);
 bool wrap_parse(const char *wrap_file, struct wrap *wrap);
 bool wrap_handle(const char *wrap_file, const char *subprojects, struct wrap *wrap, bool download);
+bool wrap_handle_all(const char *const wrap_files[], uint32_t len, const char *subprojects, uint32_t parallel);
 bool wrap_load_all_provides(struct workspace *wk, const char *subprojects);
 #endif
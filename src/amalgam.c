@@ -15,6 +15,7 @@
 #include "backend/ninja.c"
 #include "backend/ninja/alias_target.c"
 #include "backend/ninja/build_target.c"
+#include "backend/ninja/compdb.c"
 #include "backend/ninja/custom_target.c"
 #include "backend/ninja/rules.c"
 #include "backend/output.c"
@@ -22,11 +23,15 @@
 #include "cmd_test.c"
 #include "coerce.c"
 #include "compilers.c"
+#include "configure_cache.c"
+#include "configure_fingerprint.c"
 #include "datastructures/arr.c"
 #include "datastructures/bucket_arr.c"
 #include "datastructures/hash.c"
 #include "datastructures/stack.c"
+#include "datastructures/wyhash.c"
 #include "embedded.c"
+#include "embedded_hash.c"
 #include "error.c"
 #include "external/libarchive_null.c"
 #include "external/libcurl_null.c"
@@ -77,6 +82,7 @@
 #include "guess.c"
 #include "install.c"
 #include "lang/analyze.c"
+#include "lang/bytecode_cache.c"
 #include "lang/compiler.c"
 #include "lang/eval.c"
 #include "lang/fmt.c"
@@ -105,6 +111,7 @@
 #include "platform/path.c"
 #include "platform/run_cmd.c"
 #include "platform/uname.c"
+#include "profile.c"
 #include "rpmvercmp.c"
 #include "sha_256.c"
 #include "version.c.in"
@@ -264,7 +264,19 @@ setup_optional_b_args_compiler(struct workspace *wk,
 
 	get_option_value_for_tgt(wk, proj, tgt, "b_lto", &opt);
 	if (get_obj_bool(wk, opt)) {
-		push_args(wk, args, toolchain_compiler_enable_lto(wk, comp));
+		const struct args *lto_args = 0;
+
+		get_option_value_for_tgt(wk, proj, tgt, "b_lto_mode", &opt);
+		if (str_eql(get_str(wk, opt), &WKSTR("thin"))) {
+			lto_args = toolchain_compiler_enable_thinlto(wk, comp);
+		}
+
+		// compilers without thin lto fall back to regular lto
+		if (!lto_args || !lto_args->len) {
+			lto_args = toolchain_compiler_enable_lto(wk, comp);
+		}
+
+		push_args(wk, args, lto_args);
 	}
 }
 
@@ -551,7 +563,42 @@ setup_optional_b_args_linker(struct workspace *wk,
 
 	get_option_value_for_tgt(wk, proj, tgt, "b_lto", &opt);
 	if (get_obj_bool(wk, opt)) {
-		push_args(wk, args, toolchain_linker_enable_lto(wk, comp));
+		const struct args *lto_args = 0;
+
+		get_option_value_for_tgt(wk, proj, tgt, "b_lto_mode", &opt);
+		bool thin = str_eql(get_str(wk, opt), &WKSTR("thin"));
+		if (thin) {
+			lto_args = toolchain_linker_enable_thinlto(wk, comp);
+		}
+
+		if (!lto_args || !lto_args->len) {
+			thin = false;
+			lto_args = toolchain_linker_enable_lto(wk, comp);
+		}
+
+		push_args(wk, args, lto_args);
+
+		get_option_value_for_tgt(wk, proj, tgt, "b_lto_threads", &opt);
+		push_args(wk, args, toolchain_linker_lto_threads(wk, comp, get_obj_number(wk, opt)));
+
+		get_option_value_for_tgt(wk, proj, tgt, "b_thinlto_cache", &opt);
+		if (thin && get_obj_bool(wk, opt)) {
+			SBUF(cache_dir);
+			get_option_value_for_tgt(wk, proj, tgt, "b_thinlto_cache_dir", &opt);
+			if (get_str(wk, opt)->len) {
+				path_copy(wk, &cache_dir, get_cstr(wk, opt));
+			} else {
+				path_join(wk, &cache_dir, wk->build_root, output_path.private_dir);
+				path_push(wk, &cache_dir, "thinlto-cache");
+			}
+
+			const struct args *cache_args = toolchain_linker_thinlto_cache_dir(wk, comp, cache_dir.buf);
+			if (comp->linker_passthrough) {
+				cache_args = toolchain_compiler_linker_passthrough(wk, comp, cache_args);
+			}
+
+			push_args(wk, args, cache_args);
+		}
 	}
 	return true;
 }
@@ -777,24 +824,38 @@ regenerate_build_command(struct workspace *wk, bool opts_only)
 	obj regen_args;
 	make_obj(wk, &regen_args, obj_array);
 
+	SBUF(compiler_check_cache_path);
+	path_join(wk, &compiler_check_cache_path, wk->muon_private, output_path.compiler_check_cache);
+
 	if (!opts_only) {
 		obj_array_push(wk, regen_args, make_str(wk, wk->argv0));
 		obj_array_push(wk, regen_args, make_str(wk, "-C"));
 		obj_array_push(wk, regen_args, make_str(wk, wk->source_root));
 		obj_array_push(wk, regen_args, make_str(wk, "setup"));
 
-		SBUF(compiler_check_cache_path);
-		path_join(wk, &compiler_check_cache_path, wk->muon_private, output_path.compiler_check_cache);
-
 		obj_array_push(wk, regen_args, make_str(wk, "-c"));
 		obj_array_push(wk, regen_args, make_str(wk, compiler_check_cache_path.buf));
+		obj_array_push(wk, regen_args, make_str(wk, "-r"));
 	}
 
 	obj_dict_foreach(wk, wk->global_opts, &regen_args, add_global_opts_set_from_env_iter);
 
+	// When this configure was itself a regeneration, the -c and -r
+	// arguments added above are already part of the original command line.
+	// Skip them so the command doesn't grow every time the build is
+	// regenerated.
 	uint32_t i;
 	for (i = 0; i < wk->original_commandline.argc; ++i) {
-		obj_array_push(wk, regen_args, make_str(wk, wk->original_commandline.argv[i]));
+		const char *arg = wk->original_commandline.argv[i];
+		if (strcmp(arg, "-c") == 0 && i + 1 < wk->original_commandline.argc
+			&& strcmp(wk->original_commandline.argv[i + 1], compiler_check_cache_path.buf) == 0) {
+			++i;
+			continue;
+		} else if (strcmp(arg, "-r") == 0) {
+			continue;
+		}
+
+		obj_array_push(wk, regen_args, make_str(wk, arg));
 	}
 
 	return regen_args;
@@ -11,9 +11,11 @@
 #include "backend/ninja.h"
 #include "backend/ninja/alias_target.h"
 #include "backend/ninja/build_target.h"
+#include "backend/ninja/compdb.h"
 #include "backend/ninja/custom_target.h"
 #include "backend/ninja/rules.h"
 #include "backend/output.h"
+#include "configure_cache.h"
 #include "error.h"
 #include "external/samurai.h"
 #include "lang/serial.h"
@@ -99,16 +101,100 @@ write_tgt_iter(struct workspace *wk, void *_ctx, obj tgt_id)
 }
 
 struct write_build_ctx {
-	obj compiler_rule_arr;
+	struct ninja_compiler_rules compiler_rules;
+	struct ninja_compdb compdb;
+	bool fragment_changed;
 };
 
+/*
+ * Targets are written to one ninja fragment per build directory, which is
+ * included from build.ninja with subninja.  Fragments are only rewritten
+ * when their contents change.  ninja only reloads its manifest if
+ * build.ninja itself changed, so build.ninja is rewritten as well whenever
+ * any fragment was.  Compiler rules are shared between fragments, so they go
+ * into build.ninja.
+ */
+struct ninja_fragment_tgt {
+	struct project *proj;
+	obj tgt;
+};
+
+struct ninja_fragment {
+	char *dir; // relative to the build root
+	struct arr tgts; // struct ninja_fragment_tgt
+};
+
+struct write_fragment_ctx {
+	struct write_build_ctx *build;
+	struct ninja_fragment *frag;
+	FILE *rules_out;
+	bool wrote_default;
+};
+
+static void
+ninja_tgt_dir(struct workspace *wk, obj tgt_id, struct sbuf *dir)
+{
+	const char *path = wk->build_root;
+
+	switch (get_obj_type(wk, tgt_id)) {
+	case obj_both_libs: tgt_id = get_obj_both_libs(wk, tgt_id)->dynamic_lib;
+	/* fallthrough */
+	case obj_build_target: path = get_cstr(wk, get_obj_build_target(wk, tgt_id)->build_dir); break;
+	case obj_custom_target: {
+		const struct obj_custom_target *tgt = get_obj_custom_target(wk, tgt_id);
+		if (tgt->output && get_obj_array(wk, tgt->output)->len) {
+			obj out;
+			obj_array_index(wk, tgt->output, 0, &out);
+
+			SBUF(out_dir);
+			path_dirname(wk, &out_dir, get_file_path(wk, out));
+			path_relative_to(wk, dir, wk->build_root, out_dir.buf);
+			return;
+		}
+		break;
+	}
+	case obj_alias_target: break;
+	default: UNREACHABLE;
+	}
+
+	path_relative_to(wk, dir, wk->build_root, path);
+}
+
+static bool
+ninja_write_fragment(struct workspace *wk, void *_ctx, FILE *out)
+{
+	struct write_fragment_ctx *ctx = _ctx;
+
+	uint32_t i;
+	for (i = 0; i < ctx->frag->tgts.len; ++i) {
+		const struct ninja_fragment_tgt *t = arr_get(&ctx->frag->tgts, i);
+
+		struct write_tgt_ctx tgt_ctx = {
+			.out = out,
+			.rules_out = ctx->rules_out,
+			.proj = t->proj,
+			.compdb = &ctx->build->compdb,
+			.compiler_rules = &ctx->build->compiler_rules,
+		};
+
+		if (write_tgt_iter(wk, &tgt_ctx, t->tgt) == ir_err) {
+			LOG_E("failed to write rules for project %s", get_cstr(wk, t->proj->cfg.name));
+			return false;
+		}
+
+		ctx->wrote_default |= tgt_ctx.wrote_default;
+	}
+
+	return true;
+}
+
 static bool
 ninja_write_build(struct workspace *wk, void *_ctx, FILE *out)
 {
 	struct write_build_ctx *ctx = _ctx;
 	struct check_tgt_ctx check_ctx = { 0 };
 
-	uint32_t i;
+	uint32_t i, j;
 	for (i = 0; i < wk->projects.len; ++i) {
 		struct project *proj = arr_get(&wk->projects, i);
 		if (proj->not_ok) {
@@ -118,11 +204,14 @@ ninja_write_build(struct workspace *wk, void *_ctx, FILE *out)
 		obj_array_foreach(wk, proj->targets, &check_ctx, check_tgt_iter);
 	}
 
-	if (!ninja_write_rules(out, wk, arr_get(&wk->projects, 0), check_ctx.need_phony, ctx->compiler_rule_arr)) {
+	if (!ninja_write_rules(out, wk, arr_get(&wk->projects, 0), check_ctx.need_phony)) {
 		return false;
 	}
 
-	bool wrote_default = false;
+	struct arr frags;
+	struct hash frag_dirs;
+	arr_init(&frags, 16, sizeof(struct ninja_fragment));
+	hash_init_str(&frag_dirs, 16);
 
 	for (i = 0; i < wk->projects.len; ++i) {
 		struct project *proj = arr_get(&wk->projects, i);
@@ -130,14 +219,59 @@ ninja_write_build(struct workspace *wk, void *_ctx, FILE *out)
 			continue;
 		}
 
-		struct write_tgt_ctx ctx = { .out = out, .proj = proj };
+		const struct obj_array *targets = get_obj_array(wk, proj->targets);
+		for (j = 0; j < targets->len; ++j) {
+			obj tgt = obj_array_elem(wk, targets, j);
+
+			SBUF(dir);
+			ninja_tgt_dir(wk, tgt, &dir);
+
+			struct ninja_fragment *frag;
+			const uint64_t *v;
+			if ((v = hash_get_strn(&frag_dirs, dir.buf, dir.len))) {
+				frag = arr_get(&frags, *v);
+			} else {
+				struct ninja_fragment new_frag = { .dir = z_malloc(dir.len + 1) };
+				memcpy(new_frag.dir, dir.buf, dir.len + 1);
+				arr_init(&new_frag.tgts, 16, sizeof(struct ninja_fragment_tgt));
+
+				uint32_t idx = arr_push(&frags, &new_frag);
+				hash_set_strn(&frag_dirs, new_frag.dir, dir.len, idx);
+				frag = arr_get(&frags, idx);
+			}
 
-		if (!obj_array_foreach(wk, proj->targets, &ctx, write_tgt_iter)) {
-			LOG_E("failed to write rules for project %s", get_cstr(wk, proj->cfg.name));
-			return false;
+			arr_push(&frag->tgts, &(struct ninja_fragment_tgt){ .proj = proj, .tgt = tgt });
 		}
+	}
+
+	bool ret = false, wrote_default = false;
+
+	for (i = 0; i < frags.len; ++i) {
+		struct ninja_fragment *frag = arr_get(&frags, i);
 
-		wrote_default |= ctx.wrote_default;
+		SBUF(rel);
+		SBUF(abs);
+		path_join(wk, &rel, output_path.private_dir, "ninja");
+		path_push(wk, &rel, frag->dir);
+		path_join(wk, &abs, wk->build_root, rel.buf);
+		path_push(wk, &rel, "targets.ninja");
+
+		if (!fs_mkdir_p(abs.buf)) {
+			goto ret;
+		}
+
+		struct write_fragment_ctx frag_ctx = { .build = ctx, .frag = frag, .rules_out = out };
+		bool changed = false;
+		if (!with_open_changed(abs.buf, "targets.ninja", wk, &frag_ctx, ninja_write_fragment, &changed)) {
+			goto ret;
+		}
+
+		wrote_default |= frag_ctx.wrote_default;
+		ctx->fragment_changed |= changed;
+
+		SBUF(esc);
+		ninja_escape(wk, &esc, rel.buf);
+		fprintf(out, "subninja %s\n\n", esc.buf);
 	}
 
 	if (!wrote_default) {
@@ -146,7 +280,16 @@ ninja_write_build(struct workspace *wk, void *_ctx, FILE *out)
 			"default muon_do_nothing\n");
 	}
 
-	return true;
+	ret = true;
+ret:
+	for (i = 0; i < frags.len; ++i) {
+		struct ninja_fragment *frag = arr_get(&frags, i);
+		z_free(frag->dir);
+		arr_destroy(&frag->tgts);
+	}
+	arr_destroy(&frags);
+	hash_destroy(&frag_dirs);
+	return ret;
 }
 
 static bool
@@ -154,6 +297,9 @@ ninja_write_tests(struct workspace *wk, void *_ctx, FILE *out)
 {
 	bool wrote_header = false;
 
+	struct obj_clear_mark mk;
+	obj_set_clear_mark(wk, &mk);
+
 	obj tests;
 	make_obj(wk, &tests, obj_dict);
 
@@ -186,12 +332,17 @@ ninja_write_tests(struct workspace *wk, void *_ctx, FILE *out)
 		}
 	}
 
-	return serial_dump(wk, tests, out);
+	bool ret = serial_dump(wk, tests, out);
+	obj_clear(wk, &mk);
+	return ret;
 }
 
 static bool
 ninja_write_install(struct workspace *wk, void *_ctx, FILE *out)
 {
+	struct obj_clear_mark mk;
+	obj_set_clear_mark(wk, &mk);
+
 	obj o;
 	make_obj(wk, &o, obj_array);
 	obj_array_push(wk, o, wk->install);
@@ -203,7 +354,9 @@ ninja_write_install(struct workspace *wk, void *_ctx, FILE *out)
 	get_option_value(wk, proj, "prefix", &prefix);
 	obj_array_push(wk, o, prefix);
 
-	return serial_dump(wk, o, out);
+	bool ret = serial_dump(wk, o, out);
+	obj_clear(wk, &mk);
+	return ret;
 }
 
 static bool
@@ -212,6 +365,30 @@ ninja_write_compiler_check_cache(struct workspace *wk, void *_ctx, FILE *out)
 	return serial_dump(wk, wk->compiler_check_cache, out);
 }
 
+static bool
+ninja_write_pkgconf_cache(struct workspace *wk, void *_ctx, FILE *out)
+{
+	return serial_dump(wk, wk->pkgconf_cache, out);
+}
+
+static bool
+ninja_write_program_version_cache(struct workspace *wk, void *_ctx, FILE *out)
+{
+	return serial_dump(wk, wk->program_version_cache, out);
+}
+
+static bool
+ninja_write_python_cache(struct workspace *wk, void *_ctx, FILE *out)
+{
+	return serial_dump(wk, wk->python_cache, out);
+}
+
+static bool
+ninja_write_bytecode_cache(struct workspace *wk, void *_ctx, FILE *out)
+{
+	return serial_dump(wk, wk->bytecode_cache, out);
+}
+
 static bool
 ninja_write_summary_file(struct workspace *wk, void *_ctx, FILE *out)
 {
@@ -222,6 +399,9 @@ ninja_write_summary_file(struct workspace *wk, void *_ctx, FILE *out)
 static bool
 ninja_write_option_info(struct workspace *wk, void *_ctx, FILE *out)
 {
+	struct obj_clear_mark mk;
+	obj_set_clear_mark(wk, &mk);
+
 	obj arr;
 	make_obj(wk, &arr, obj_array);
 	obj_array_push(wk, arr, wk->global_opts);
@@ -229,18 +409,22 @@ ninja_write_option_info(struct workspace *wk, void *_ctx, FILE *out)
 	struct project *main_proj = arr_get(&wk->projects, 0);
 	obj_array_push(wk, arr, main_proj->opts);
 
-	return serial_dump(wk, arr, out);
+	bool ret = serial_dump(wk, arr, out);
+	obj_clear(wk, &mk);
+	return ret;
 }
 
 bool
 ninja_write_all(struct workspace *wk)
 {
+	bool ret = false;
 	struct write_build_ctx ctx = { 0 };
-	make_obj(wk, &ctx.compiler_rule_arr, obj_array);
+	ninja_compiler_rules_init(&ctx.compiler_rules);
+	ninja_compdb_init(wk, &ctx.compdb);
 
 	obj_array_push(wk, wk->backend_output_stack, make_str(wk, "ninja_write_all"));
 
-	if (!(with_open(wk->build_root, "build.ninja", wk, &ctx, ninja_write_build)
+	if (!(with_open_changed(wk->build_root, "build.ninja", wk, &ctx, ninja_write_build, &ctx.fragment_changed)
 		    && with_open(wk->muon_private, output_path.tests, wk, NULL, ninja_write_tests)
 		    && with_open(wk->muon_private, output_path.install, wk, NULL, ninja_write_install)
 		    && with_open(wk->muon_private,
@@ -248,9 +432,21 @@ ninja_write_all(struct workspace *wk)
 			    wk,
 			    NULL,
 			    ninja_write_compiler_check_cache)
+		    && (!wk->pkgconf_cache
+			    || with_open(wk->muon_private, output_path.pkgconf_cache, wk, NULL, ninja_write_pkgconf_cache))
+		    && (!wk->program_version_cache || !configure_cache_enabled(wk)
+			    || with_open(wk->muon_private,
+				    output_path.program_version_cache,
+				    wk,
+				    NULL,
+				    ninja_write_program_version_cache))
+		    && (!wk->python_cache || !configure_cache_enabled(wk)
+			    || with_open(wk->muon_private, output_path.python_cache, wk, NULL, ninja_write_python_cache))
+		    && (!wk->bytecode_cache || !configure_cache_enabled(wk)
+			    || with_open(wk->muon_private, output_path.bytecode_cache, wk, NULL, ninja_write_bytecode_cache))
 		    && with_open(wk->muon_private, output_path.summary, wk, NULL, ninja_write_summary_file)
 		    && with_open(wk->muon_private, output_path.option_info, wk, NULL, ninja_write_option_info))) {
-		return false;
+		goto ret;
 	}
 
 	obj_array_pop(wk, wk->backend_output_stack);
@@ -258,21 +454,18 @@ ninja_write_all(struct workspace *wk)
 	{ /* compile_commands.json */
 		TracyCZoneN(tctx_compdb, "output compile_commands.json", true);
 
-		obj compdb_args;
-		make_obj(wk, &compdb_args, obj_array);
-		obj_array_push(wk, compdb_args, make_str(wk, "-C"));
-		obj_array_push(wk, compdb_args, make_str(wk, wk->build_root));
-		obj_array_push(wk, compdb_args, make_str(wk, "-t"));
-		obj_array_push(wk, compdb_args, make_str(wk, "compdb"));
-		obj_array_extend_nodup(wk, compdb_args, ctx.compiler_rule_arr);
-		if (!ninja_run(wk, compdb_args, wk->build_root, "compile_commands.json")) {
+		if (!with_open(wk->build_root, "compile_commands.json", wk, &ctx.compdb, ninja_compdb_write)) {
 			LOG_E("error writing compile_commands.json");
 		}
 
 		TracyCZoneEnd(tctx_compdb);
 	}
 
-	return true;
+	ret = true;
+ret:
+	ninja_compiler_rules_destroy(&ctx.compiler_rules);
+	ninja_compdb_destroy(&ctx.compdb);
+	return ret;
 }
 
 bool
@@ -9,21 +9,32 @@
 
 #include "args.h"
 #include "backend/common_args.h"
+#include "backend/output.h"
 #include "backend/ninja.h"
 #include "backend/ninja/build_target.h"
+#include "backend/ninja/compdb.h"
+#include "backend/ninja/rules.h"
 #include "error.h"
 #include "functions/build_target.h"
+#include "lang/object_iterators.h"
 #include "lang/workspace.h"
 #include "log.h"
+#include "options.h"
 #include "platform/filesystem.h"
 #include "platform/path.h"
 
 struct write_tgt_iter_ctx {
-	FILE *out;
+	FILE *out, *rules_out;
+	struct ninja_compdb *compdb;
+	struct ninja_compiler_rules *compiler_rules;
 	const struct obj_build_target *tgt;
 	const struct project *proj;
 	struct build_dep args;
 	obj joined_args;
+	obj rule_names;
+	obj unity_sources;
+	obj pch; // lang -> header, for languages that use a pch
+	obj pch_args, pch_deps; // lang -> joined args / implicit deps
 	obj object_names;
 	obj order_deps;
 	obj implicit_deps;
@@ -43,12 +54,159 @@ add_tgt_objects_iter(struct workspace *wk, void *_ctx, obj val)
 	return ir_cont;
 }
 
+static bool
+write_include_file_cb(struct workspace *wk, void *_ctx, FILE *out)
+{
+	obj srcs = *(obj *)_ctx, src;
+	obj_array_for(wk, srcs, src) {
+		fprintf(out, "#include \"%s\"\n", get_file_path(wk, src));
+	}
+
+	return true;
+}
+
+// Unity files and pch sources are written through with_open so that they keep
+// their mtime, and don't cause a rebuild, unless the list of sources changed.
+static bool
+write_include_file(struct workspace *wk, const char *path, obj srcs)
+{
+	SBUF(dir);
+	SBUF(name);
+	path_dirname(wk, &dir, path);
+	path_basename(wk, &name, path);
+
+	if (!fs_mkdir_p(dir.buf)) {
+		return false;
+	}
+
+	return with_open(dir.buf, name.buf, wk, &srcs, write_include_file_cb);
+}
+
+/*
+ * The pch is built from a generated source in the target's private dir that
+ * includes the header, using an ordinary compiler rule so that it gets the
+ * target's args and depfile tracking.  Sources then force-include it, which
+ * also means they don't need to include the header themselves.
+ */
+static bool
+write_tgt_pch(struct workspace *wk, struct write_tgt_iter_ctx *ctx, enum compiler_language lang, obj header, obj args)
+{
+	obj comp_id;
+	if (!obj_dict_geti(wk, ctx->proj->compilers, lang, &comp_id)) {
+		UNREACHABLE;
+	}
+
+	struct obj_compiler *comp = get_obj_compiler(wk, comp_id);
+	const char *header_path = get_file_path(wk, header);
+
+	SBUF(name);
+	SBUF(src_path);
+	SBUF(pch_path);
+	path_basename(wk, &name, header_path);
+	sbuf_pushf(wk,
+		&src_path,
+		"%s/%s_pch/%s.%s",
+		get_cstr(wk, ctx->tgt->private_path),
+		compiler_language_to_s(lang),
+		name.buf,
+		compiler_language_extension(lang));
+
+	{
+		obj srcs;
+		make_obj(wk, &srcs, obj_array);
+		obj_array_push(wk, srcs, header);
+		if (!write_include_file(wk, src_path.buf, srcs)) {
+			return false;
+		}
+	}
+
+	obj src;
+	make_obj(wk, &src, obj_file);
+	*get_obj_file(wk, src) = make_str(wk, src_path.buf);
+
+	SBUF(rel_src_path);
+	path_relative_to(wk, &rel_src_path, wk->build_root, src_path.buf);
+	path_relative_to(wk, &pch_path, wk->build_root, get_cstr(wk, ctx->tgt->private_path));
+	sbuf_pushf(wk,
+		&pch_path,
+		"/%s_pch/%s%s",
+		compiler_language_to_s(lang),
+		name.buf,
+		toolchain_compiler_pch_ext(wk, comp)->args[0]);
+
+	obj create_args, use_args;
+	{
+		obj arr;
+		make_obj(wk, &arr, obj_array);
+		push_args(wk, arr, toolchain_compiler_pch_create(wk, comp, header_path, pch_path.buf));
+		create_args = make_strf(wk, "%s %s", get_cstr(wk, args), get_cstr(wk, join_args_shell_ninja(wk, arr)));
+
+		make_obj(wk, &arr, obj_array);
+		push_args(wk, arr, toolchain_compiler_pch_use(wk, comp, header_path, pch_path.buf));
+		use_args = make_strf(wk, "%s %s", get_cstr(wk, join_args_shell_ninja(wk, arr)), get_cstr(wk, args));
+	}
+
+	obj rule_name = ninja_compiler_rule(wk, ctx->compiler_rules, ctx->rules_out, ctx->proj, lang, create_args);
+
+	SBUF(esc_pch_path);
+	SBUF(esc_src_path);
+	ninja_escape(wk, &esc_pch_path, pch_path.buf);
+	ninja_escape(wk, &esc_src_path, rel_src_path.buf);
+
+	// msvc also produces an object file along with the pch, which has to be
+	// linked into the target.
+	if (strcmp(toolchain_compiler_pch_type(wk, comp)->args[0], "msvc") == 0) {
+		SBUF(dest_path);
+		SBUF(esc_dest_path);
+		if (!tgt_src_to_object_path(wk, ctx->tgt, src, true, &dest_path)) {
+			return false;
+		}
+
+		obj_array_push(wk, ctx->object_names, sbuf_into_str(wk, &dest_path));
+		ninja_compdb_push(wk, ctx->compdb, comp_id, create_args, rel_src_path.buf, dest_path.buf);
+		ninja_escape(wk, &esc_dest_path, dest_path.buf);
+		fprintf(ctx->out,
+			"build %s | %s: %s %s",
+			esc_dest_path.buf,
+			esc_pch_path.buf,
+			get_cstr(wk, rule_name),
+			esc_src_path.buf);
+	} else {
+		ninja_compdb_push(wk, ctx->compdb, comp_id, create_args, rel_src_path.buf, pch_path.buf);
+		fprintf(ctx->out, "build %s: %s %s", esc_pch_path.buf, get_cstr(wk, rule_name), esc_src_path.buf);
+	}
+
+	if (ctx->implicit_deps) {
+		fprintf(ctx->out, " | %s", get_cstr(wk, ctx->implicit_deps));
+	}
+	if (ctx->have_order_deps) {
+		fprintf(ctx->out, " || %s", get_cstr(wk, ctx->order_deps));
+	}
+	fputc('\n', ctx->out);
+
+	obj_dict_seti(wk, ctx->pch_args, lang, use_args);
+	if (ctx->implicit_deps) {
+		obj_dict_seti(
+			wk, ctx->pch_deps, lang, make_strf(wk, "%s %s", esc_pch_path.buf, get_cstr(wk, ctx->implicit_deps)));
+	} else {
+		obj_dict_seti(wk, ctx->pch_deps, lang, make_str(wk, esc_pch_path.buf));
+	}
+	return true;
+}
+
 static enum iteration_result
 write_tgt_sources_iter(struct workspace *wk, void *_ctx, obj val)
 {
 	struct write_tgt_iter_ctx *ctx = _ctx;
 	const char *src = get_file_path(wk, val);
 
+	obj unity_srcs;
+	if (ctx->unity_sources && obj_dict_index(wk, ctx->unity_sources, *get_obj_file(wk, val), &unity_srcs)) {
+		if (!write_include_file(wk, src, unity_srcs)) {
+			return ir_err;
+		}
+	}
+
 	enum compiler_language lang;
 	if (!filename_to_compiler_language(src, &lang)) {
 		UNREACHABLE;
@@ -67,21 +225,42 @@ write_tgt_sources_iter(struct workspace *wk, void *_ctx, obj val)
 
 	/* build rules and args */
 
-	obj rule_name, specialized_rule;
-	{
-		obj rule_name_arr;
-		if (!obj_dict_geti(wk, ctx->tgt->required_compilers, lang, &rule_name_arr)) {
-			UNREACHABLE;
-		}
+	if (!ctx->joined_args && !build_target_args(wk, ctx->proj, ctx->tgt, &ctx->joined_args)) {
+		return ir_err;
+	}
 
-		obj_array_index(wk, rule_name_arr, 0, &rule_name);
-		obj_array_index(wk, rule_name_arr, 1, &specialized_rule);
+	obj args;
+	if (!obj_dict_geti(wk, ctx->joined_args, lang, &args)) {
+		UNREACHABLE;
+	}
 
-		if (!specialized_rule) {
-			if (!ctx->joined_args && !build_target_args(wk, ctx->proj, ctx->tgt, &ctx->joined_args)) {
+	obj implicit_deps = ctx->implicit_deps, header, pch_args;
+	if (ctx->pch && obj_dict_geti(wk, ctx->pch, lang, &header)) {
+		if (!obj_dict_geti(wk, ctx->pch_args, lang, &pch_args)) {
+			if (!write_tgt_pch(wk, ctx, lang, header, args)) {
 				return ir_err;
 			}
+
+			obj_dict_geti(wk, ctx->pch_args, lang, &pch_args);
 		}
+
+		args = pch_args;
+		obj_dict_geti(wk, ctx->pch_deps, lang, &implicit_deps);
+	}
+
+	obj rule_name;
+	if (!obj_dict_geti(wk, ctx->rule_names, lang, &rule_name)) {
+		rule_name = ninja_compiler_rule(wk, ctx->compiler_rules, ctx->rules_out, ctx->proj, lang, args);
+		obj_dict_seti(wk, ctx->rule_names, lang, rule_name);
+	}
+
+	{
+		obj comp_id;
+		if (!obj_dict_geti(wk, ctx->proj->compilers, lang, &comp_id)) {
+			UNREACHABLE;
+		}
+
+		ninja_compdb_push(wk, ctx->compdb, comp_id, args, src_path.buf, dest_path.buf);
 	}
 
 	SBUF(esc_dest_path);
@@ -91,24 +270,15 @@ write_tgt_sources_iter(struct workspace *wk, void *_ctx, obj val)
 	ninja_escape(wk, &esc_path, src_path.buf);
 
 	fprintf(ctx->out, "build %s: %s %s", esc_dest_path.buf, get_cstr(wk, rule_name), esc_path.buf);
-	if (ctx->implicit_deps) {
+	if (implicit_deps) {
 		fputs(" | ", ctx->out);
-		fputs(get_cstr(wk, ctx->implicit_deps), ctx->out);
+		fputs(get_cstr(wk, implicit_deps), ctx->out);
 	}
 	if (ctx->have_order_deps) {
 		fprintf(ctx->out, " || %s", get_cstr(wk, ctx->order_deps));
 	}
 	fputc('\n', ctx->out);
 
-	if (!specialized_rule) {
-		obj args;
-		if (!obj_dict_geti(wk, ctx->joined_args, lang, &args)) {
-			UNREACHABLE;
-		}
-
-		fprintf(ctx->out, " ARGS = %s\n", get_cstr(wk, args));
-	}
-
 	return ir_cont;
 }
 
@@ -129,6 +299,9 @@ ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *wc
 		.tgt = tgt,
 		.proj = wctx->proj,
 		.out = wctx->out,
+		.rules_out = wctx->rules_out,
+		.compdb = wctx->compdb,
+		.compiler_rules = wctx->compiler_rules,
 	};
 
 	struct obj_compiler *compiler;
@@ -144,8 +317,11 @@ ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *wc
 	}
 
 	make_obj(wk, &ctx.object_names, obj_array);
+	make_obj(wk, &ctx.rule_names, obj_dict);
 
 	ctx.args = tgt->dep_internal;
+	// Linker arguments are appended below, don't modify the target's own list.
+	obj_array_dup(wk, ctx.args.link_args, &ctx.args.link_args);
 
 	relativize_paths(wk, ctx.args.link_with, true, &ctx.args.link_with);
 	relativize_paths(wk, ctx.args.link_whole, true, &ctx.args.link_whole);
@@ -171,10 +347,36 @@ ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *wc
 		}
 	}
 
+	obj b_pch = 0;
+	if (tgt->pch) {
+		get_option_value_overridable(wk, ctx.proj, tgt->override_options, "b_pch", &b_pch);
+	}
+
+	if (b_pch && get_obj_bool(wk, b_pch)) { /* precompiled headers */
+		obj lang, header, comp_id;
+		obj_dict_for(wk, tgt->pch, lang, header) {
+			if (!obj_dict_geti(wk, ctx.proj->compilers, lang, &comp_id)
+				|| !toolchain_compiler_pch_type(wk, get_obj_compiler(wk, comp_id))->len) {
+				continue;
+			}
+
+			if (!ctx.pch) {
+				make_obj(wk, &ctx.pch, obj_dict);
+				make_obj(wk, &ctx.pch_args, obj_dict);
+				make_obj(wk, &ctx.pch_deps, obj_dict);
+			}
+
+			obj_dict_seti(wk, ctx.pch, lang, header);
+		}
+	}
+
 	{ /* sources */
 		obj_array_foreach(wk, tgt->objects, &ctx, add_tgt_objects_iter);
 
-		if (!obj_array_foreach(wk, tgt->src, &ctx, write_tgt_sources_iter)) {
+		obj units;
+		build_target_compile_units(wk, ctx.proj, tgt, &units, &ctx.unity_sources);
+
+		if (!obj_array_foreach(wk, units, &ctx, write_tgt_sources_iter)) {
 			return false;
 		}
 	}
@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+
+#include "backend/ninja/compdb.h"
+#include "backend/ninja/rules.h"
+#include "platform/filesystem.h"
+#include "platform/path.h"
+
+/*
+ * compile_commands.json is built up while build.ninja is written, one entry
+ * per compiled source, from the same compiler and argument data used for the
+ * compiler rules.  The output matches `samu -t compdb` for those rules.
+ */
+
+void
+ninja_compdb_init(struct workspace *wk, struct ninja_compdb *db)
+{
+	*db = (struct ninja_compdb){ 0 };
+	sbuf_init(&db->buf, 0, 0, sbuf_flag_overflow_alloc);
+	sbuf_push(wk, &db->buf, '[');
+}
+
+void
+ninja_compdb_destroy(struct ninja_compdb *db)
+{
+	sbuf_destroy(&db->buf);
+}
+
+static void
+compdb_push_json_str(struct workspace *wk, struct sbuf *buf, const char *s)
+{
+	const char *start = s;
+
+	for (; *s; ++s) {
+		if (*s == '"' || *s == '\\') {
+			sbuf_pushn(wk, buf, start, s - start);
+			sbuf_push(wk, buf, '\\');
+			start = s;
+		}
+	}
+
+	sbuf_pushn(wk, buf, start, s - start);
+}
+
+// Joined args are escaped for ninja, which is undone here the same way ninja
+// would when expanding them.
+static obj
+compdb_ninja_unescape(struct workspace *wk, obj ninja_args)
+{
+	const struct str *ss = get_str(wk, ninja_args);
+	if (!memchr(ss->s, '$', ss->len)) {
+		return ninja_args;
+	}
+
+	SBUF(buf);
+	uint32_t i;
+	for (i = 0; i < ss->len; ++i) {
+		if (ss->s[i] == '$' && i + 1 < ss->len) {
+			++i;
+		}
+
+		sbuf_push(wk, &buf, ss->s[i]);
+	}
+
+	return sbuf_into_str(wk, &buf);
+}
+
+void
+ninja_compdb_push(struct workspace *wk,
+	struct ninja_compdb *db,
+	obj comp_id,
+	obj ninja_args,
+	const char *src,
+	const char *out)
+{
+	SBUF(depfile);
+	sbuf_pushf(wk, &depfile, "%s.d", out);
+
+	SBUF(esc_src);
+	SBUF(esc_out);
+	SBUF(esc_depfile);
+	shell_escape(wk, &esc_src, src);
+	shell_escape(wk, &esc_out, out);
+	shell_escape(wk, &esc_depfile, depfile.buf);
+
+	obj command = ninja_compiler_command(wk,
+		get_obj_compiler(wk, comp_id),
+		compdb_ninja_unescape(wk, ninja_args),
+		esc_src.buf,
+		esc_out.buf,
+		esc_depfile.buf);
+
+	if (db->have_entries) {
+		sbuf_push(wk, &db->buf, ',');
+	}
+
+	sbuf_pushs(wk, &db->buf, "\n  {\n    \"directory\": \"");
+	compdb_push_json_str(wk, &db->buf, wk->build_root);
+	sbuf_pushs(wk, &db->buf, "\",\n    \"command\": \"");
+	compdb_push_json_str(wk, &db->buf, get_cstr(wk, command));
+	sbuf_pushs(wk, &db->buf, "\",\n    \"file\": \"");
+	compdb_push_json_str(wk, &db->buf, src);
+	sbuf_pushs(wk, &db->buf, "\",\n    \"output\": \"");
+	compdb_push_json_str(wk, &db->buf, out);
+	sbuf_pushs(wk, &db->buf, "\"\n  }");
+
+	db->have_entries = true;
+}
+
+bool
+ninja_compdb_write(struct workspace *wk, void *_ctx, FILE *out)
+{
+	struct ninja_compdb *db = _ctx;
+	sbuf_pushs(wk, &db->buf, "\n]\n");
+	return fs_fwrite(db->buf.buf, db->buf.len, out);
+}
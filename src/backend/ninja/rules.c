@@ -15,14 +15,13 @@
 #include "functions/machine.h"
 #include "lang/workspace.h"
 #include "log.h"
+#include "platform/mem.h"
 #include "platform/path.h"
 #include "tracy.h"
 
-struct write_compiler_rule_ctx {
+struct write_linker_rule_ctx {
 	FILE *out;
 	struct project *proj;
-	struct obj_build_target *tgt;
-	obj args, generic_rules;
 };
 
 static void
@@ -56,7 +55,7 @@ static enum iteration_result
 write_linker_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
 {
 	enum compiler_language l = k;
-	struct write_compiler_rule_ctx *ctx = _ctx;
+	struct write_linker_rule_ctx *ctx = _ctx;
 	struct obj_compiler *comp = get_obj_compiler(wk, comp_id);
 
 	obj args;
@@ -89,8 +88,39 @@ write_linker_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
 	return ir_cont;
 }
 
+/*
+ * Builds the command used to compile `in` to `out` with `rule_args`.  This is
+ * shared between the compiler rules, which pass ninja variables, and the
+ * compilation database, which passes the actual paths.
+ */
+obj
+ninja_compiler_command(struct workspace *wk,
+	struct obj_compiler *comp,
+	obj rule_args,
+	const char *in,
+	const char *out,
+	const char *depfile)
+{
+	obj args;
+	make_obj(wk, &args, obj_array);
+	obj_array_extend(wk, args, comp->cmd_arr);
+	obj_array_push(wk, args, rule_args);
+
+	if (toolchain_compiler_deps_type(wk, comp)->len) {
+		push_args(wk, args, toolchain_compiler_deps(wk, comp, out, depfile));
+	}
+
+	push_args(wk, args, toolchain_compiler_debugfile(wk, comp, out));
+
+	push_args(wk, args, toolchain_compiler_output(wk, comp, out));
+	push_args(wk, args, toolchain_compiler_compile_only(wk, comp));
+	obj_array_push(wk, args, make_str(wk, in));
+
+	return join_args_plain(wk, args);
+}
+
 static void
-write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, obj rule_name, enum compiler_language l, obj comp_id)
+write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, const char *rule_name, enum compiler_language l, obj comp_id)
 {
 	struct obj_compiler *comp = get_obj_compiler(wk, comp_id);
 
@@ -102,27 +132,12 @@ write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, obj rule_nam
 		}
 	}
 
-	obj args;
-	make_obj(wk, &args, obj_array);
-	obj_array_extend(wk, args, comp->cmd_arr);
-	obj_array_push(wk, args, rule_args);
-
-	if (deps) {
-		push_args(wk, args, toolchain_compiler_deps(wk, comp, "$out", "${out}.d"));
-	}
-
-	push_args(wk, args, toolchain_compiler_debugfile(wk, comp, "$out"));
-
-	push_args(wk, args, toolchain_compiler_output(wk, comp, "$out"));
-	push_args(wk, args, toolchain_compiler_compile_only(wk, comp));
-	obj_array_push(wk, args, make_str(wk, "$in"));
-
-	obj compile_command = join_args_plain(wk, args);
+	obj compile_command = ninja_compiler_command(wk, comp, rule_args, "$in", "$out", "${out}.d");
 
 	fprintf(out,
 		"rule %s\n"
 		" command = %s\n",
-		get_cstr(wk, rule_name),
+		rule_name,
 		get_cstr(wk, compile_command));
 	if (deps) {
 		fprintf(out,
@@ -133,153 +148,83 @@ write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, obj rule_nam
 	fprintf(out, " description = compiling %s $out\n\n", compiler_language_to_s(l));
 }
 
-static enum iteration_result
-write_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
+/*
+ * Compiler rules are interned by project, language, and joined arguments, so
+ * that each distinct set of arguments is written to build.ninja exactly once,
+ * as part of a rule's command, rather than once per source file or target.
+ * Rules are written lazily right before the first edge that uses them.
+ *
+ * A rule's name is derived from a hash of its key rather than from the order
+ * in which rules are first used, so that unrelated changes to the build
+ * don't rename rules and change build.ninja.  Colliding ids are resolved by
+ * probing for the next free one.
+ */
+void
+ninja_compiler_rules_init(struct ninja_compiler_rules *rules)
 {
-	enum compiler_language l = k;
-	struct write_compiler_rule_ctx *ctx = _ctx;
-
-	obj rule_name;
-	{
-		obj rule_name_arr;
-		if (!obj_dict_geti(wk, ctx->tgt->required_compilers, l, &rule_name_arr)) {
-			return ir_cont;
-		}
-
-		obj specialized_rule;
-		obj_array_index(wk, rule_name_arr, 0, &rule_name);
-		obj_array_index(wk, rule_name_arr, 1, &specialized_rule);
-
-		if (!specialized_rule) {
-			return ir_cont;
-		}
-	}
-
-	obj rule_args;
-	if (!obj_dict_geti(wk, ctx->args, l, &rule_args)) {
-		UNREACHABLE;
-	}
-
-	write_compiler_rule(wk, ctx->out, rule_args, rule_name, l, comp_id);
-	return ir_cont;
+	hash_init_str(&rules->h, 64);
+	hash_init(&rules->ids, 64, sizeof(uint32_t));
+	arr_init(&rules->keys, 64, sizeof(char *));
 }
 
-static enum iteration_result
-write_compiler_rule_tgt_iter(struct workspace *wk, void *_ctx, obj tgt_id)
+void
+ninja_compiler_rules_destroy(struct ninja_compiler_rules *rules)
 {
-	struct write_compiler_rule_ctx *ctx = _ctx;
-	enum iteration_result ret = ir_err;
-
-	if (get_obj_type(wk, tgt_id) != obj_build_target) {
-		return ir_cont;
-	}
-
-	struct obj_clear_mark mk;
-	obj_set_clear_mark(wk, &mk);
-
-	ctx->tgt = get_obj_build_target(wk, tgt_id);
-
-	if (!build_target_args(wk, ctx->proj, ctx->tgt, &ctx->args)) {
-		goto ret;
-	}
-
-	if (!obj_dict_foreach(wk, ctx->proj->compilers, ctx, write_compiler_rule_iter)) {
-		goto ret;
+	uint32_t i;
+	for (i = 0; i < rules->keys.len; ++i) {
+		z_free(*(char **)arr_get(&rules->keys, i));
 	}
 
-	ret = ir_cont;
-ret:
-	obj_clear(wk, &mk);
-	return ret;
+	arr_destroy(&rules->keys);
+	hash_destroy(&rules->h);
+	hash_destroy(&rules->ids);
 }
 
-static enum iteration_result
-write_generic_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
+obj
+ninja_compiler_rule(struct workspace *wk,
+	struct ninja_compiler_rules *rules,
+	FILE *out,
+	const struct project *proj,
+	enum compiler_language l,
+	obj args)
 {
-	enum compiler_language l = k;
-	struct write_compiler_rule_ctx *ctx = _ctx;
-	obj rule_name;
-
-	if (!obj_dict_geti(wk, ctx->generic_rules, l, &rule_name)) {
-		return ir_cont;
-	}
+	const struct str *args_str = get_str(wk, args);
+	const char *prefix = get_cstr(wk, proj->rule_prefix);
 
-	write_compiler_rule(wk, ctx->out, make_str(wk, "$ARGS"), rule_name, l, comp_id);
-	return ir_cont;
-}
+	// Arguments can't contain newlines, so they are used as separators here.
+	SBUF(key);
+	sbuf_pushf(wk, &key, "%s\n%d\n", prefix, l);
+	sbuf_pushn(wk, &key, args_str->s, args_str->len);
 
-struct name_compiler_rule_ctx {
-	struct project *proj;
-	struct obj_build_target *tgt;
-	obj rule_prefix_arr;
-	obj compiler_rule_arr;
-	obj generic_rules;
-};
-
-static enum iteration_result
-name_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, uint32_t count)
-{
-	enum compiler_language l = k;
-	struct name_compiler_rule_ctx *ctx = _ctx;
-	bool specialized_rule = count > 2;
-
-	obj rule_name;
-	SBUF(rule_name_buf);
-	if (specialized_rule) {
-		sbuf_pushf(wk,
-			&rule_name_buf,
-			"%s_%s_compiler_for_%s",
-			get_cstr(wk, ctx->proj->rule_prefix),
-			compiler_language_to_s(l),
-			get_cstr(wk, ctx->tgt->build_name));
-
-		escape_rule(&rule_name_buf);
-		obj name = sbuf_into_str(wk, &rule_name_buf);
-		uniqify_name(wk, ctx->compiler_rule_arr, name, &rule_name);
-	} else {
-		if (!obj_dict_geti(wk, ctx->generic_rules, l, &rule_name)) {
-			sbuf_pushf(wk,
-				&rule_name_buf,
-				"%s_%s_compiler",
-				get_cstr(wk, ctx->proj->rule_prefix),
-				compiler_language_to_s(l));
-
-			escape_rule(&rule_name_buf);
-			obj name = sbuf_into_str(wk, &rule_name_buf);
-			uniqify_name(wk, ctx->compiler_rule_arr, name, &rule_name);
-			obj_dict_seti(wk, ctx->generic_rules, l, rule_name);
-		}
+	const uint64_t *v;
+	if ((v = hash_get_strn(&rules->h, key.buf, key.len))) {
+		return make_strf(wk, "%s_%s_compiler_%08x", prefix, compiler_language_to_s(l), (uint32_t)*v);
 	}
 
-	obj arr;
-	make_obj(wk, &arr, obj_array);
-	obj_array_push(wk, arr, rule_name);
-	obj_array_push(wk, arr, specialized_rule);
-
-	obj_dict_seti(wk, ctx->tgt->required_compilers, l, arr);
-	return ir_cont;
-}
-
-static enum iteration_result
-name_compiler_rule_tgt_iter(struct workspace *wk, void *_ctx, obj tgt_id)
-{
-	struct name_compiler_rule_ctx *ctx = _ctx;
-
-	if (get_obj_type(wk, tgt_id) != obj_build_target) {
-		return ir_cont;
+	uint64_t hash = hash_bytes(key.buf, key.len);
+	uint32_t id = (uint32_t)(hash ^ (hash >> 32));
+	while (hash_get(&rules->ids, &id)) {
+		++id;
 	}
+	hash_set(&rules->ids, &id, 1);
 
-	ctx->tgt = get_obj_build_target(wk, tgt_id);
+	char *k = z_malloc(key.len + 1);
+	memcpy(k, key.buf, key.len + 1);
+	arr_push(&rules->keys, &k);
+	hash_set_strn(&rules->h, k, key.len, id);
 
-	if (!obj_dict_foreach(wk, ctx->tgt->required_compilers, ctx, name_compiler_rule_iter)) {
-		return ir_err;
+	obj comp_id;
+	if (!obj_dict_geti(wk, proj->compilers, l, &comp_id)) {
+		UNREACHABLE;
 	}
 
-	return ir_cont;
+	obj rule_name = make_strf(wk, "%s_%s_compiler_%08x", prefix, compiler_language_to_s(l), id);
+	write_compiler_rule(wk, out, args, get_cstr(wk, rule_name), l, comp_id);
+	return rule_name;
 }
 
 bool
-ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bool need_phony, obj compiler_rule_arr)
+ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bool need_phony)
 {
 	TracyCZoneAutoS;
 	obj_array_push(wk, wk->backend_output_stack, make_str(wk, "ninja_write_rules"));
@@ -303,6 +248,7 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 
 	fputs("\n description = Regenerating build files.\n"
 	      " generator = 1\n"
+	      " restat = 1\n"
 	      "\n",
 		out);
 
@@ -345,8 +291,6 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 			continue;
 		}
 
-		TracyCZoneN(tctx_name, "name rules", true);
-
 		{ // determine project rule prefix
 			SBUF(pre);
 			sbuf_pushs(wk, &pre, get_cstr(wk, proj->cfg.name));
@@ -354,44 +298,17 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 			uniqify_name(wk, rule_prefix_arr, sbuf_into_str(wk, &pre), &proj->rule_prefix);
 		}
 
-		obj generic_rules;
-		make_obj(wk, &generic_rules, obj_dict);
-
-		{
-			struct name_compiler_rule_ctx ctx = {
-				.proj = proj,
-				.rule_prefix_arr = rule_prefix_arr,
-				.compiler_rule_arr = compiler_rule_arr,
-				.generic_rules = generic_rules,
-			};
-
-			if (!obj_array_foreach(wk, proj->targets, &ctx, name_compiler_rule_tgt_iter)) {
-				goto ret;
-			}
-		}
-
-		TracyCZoneEnd(tctx_name);
-
 		{
 			TracyCZoneN(tctx_rules, "write rules", true);
 
-			struct write_compiler_rule_ctx ctx = {
+			struct write_linker_rule_ctx ctx = {
 				.out = out,
 				.proj = proj,
-				.generic_rules = generic_rules,
 			};
 
 			struct obj_clear_mark mk;
 			obj_set_clear_mark(wk, &mk);
 
-			if (!obj_array_foreach(wk, proj->targets, &ctx, write_compiler_rule_tgt_iter)) {
-				goto ret;
-			}
-
-			if (!obj_dict_foreach(wk, proj->compilers, &ctx, write_generic_compiler_rule_iter)) {
-				goto ret;
-			}
-
 			if (!obj_dict_foreach(wk, proj->compilers, &ctx, write_linker_rule_iter)) {
 				goto ret;
 			}
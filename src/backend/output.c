@@ -18,7 +18,12 @@ const struct output_path output_path = {
 	.tests = "tests.dat",
 	.install = "install.dat",
 	.compiler_check_cache = "compiler_check_cache.dat",
+	.pkgconf_cache = "pkgconf_cache.dat",
+	.program_version_cache = "program_version_cache.dat",
+	.python_cache = "python_cache.dat",
+	.bytecode_cache = "bytecode_cache.dat",
 	.option_info = "option_info.dat",
+	.configure_fingerprint = "configure_fingerprint.dat",
 };
 
 FILE *
@@ -32,8 +37,63 @@ output_open(const char *dir, const char *name)
 	return f;
 }
 
+/*
+ * Outputs are written to memory and only replace the previous output if the
+ * contents differ.  This keeps the mtimes of unchanged outputs, so that e.g.
+ * muon test doesn't see changed test data after every regeneration.
+ *
+ * Changed outputs are written to a temporary file next to the output which
+ * is then renamed over it, so that the output is never seen half written.
+ */
+static bool
+output_replace_if_changed(const char *path, const struct fs_memstream *ms, bool force, bool *changed)
+{
+	bool ret = false, same = false, wrote_tmp = false;
+	struct source old_src = { 0 };
+
+	SBUF_manual(tmp);
+	sbuf_pushs(NULL, &tmp, path);
+	sbuf_pushs(NULL, &tmp, ".tmp");
+
+	if (!force && fs_file_exists(path)) {
+		if (!fs_read_entire_file(path, &old_src)) {
+			goto ret;
+		}
+
+		same = old_src.len == ms->len && memcmp(old_src.src, ms->buf, ms->len) == 0;
+	}
+
+	if (!same) {
+		wrote_tmp = true;
+		if (!fs_write(tmp.buf, (const uint8_t *)ms->buf, ms->len)) {
+			goto ret;
+		} else if (!fs_rename(tmp.buf, path)) {
+			goto ret;
+		}
+	}
+
+	if (changed) {
+		*changed = !same;
+	}
+
+	ret = true;
+ret:
+	if (!ret && wrote_tmp && fs_file_exists(tmp.buf)) {
+		fs_remove(tmp.buf);
+	}
+
+	fs_source_destroy(&old_src);
+	sbuf_destroy(&tmp);
+	return ret;
+}
+
 bool
-with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, with_open_callback cb)
+with_open_changed(const char *dir,
+	const char *name,
+	struct workspace *wk,
+	void *ctx,
+	with_open_callback cb,
+	bool *changed)
 {
 	TracyCZone(tctx_func, true);
 #ifdef TRACY_ENABLE
@@ -44,20 +104,33 @@ with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, wi
 
 	obj_array_push(wk, wk->backend_output_stack, make_strf(wk, "writing %s", name));
 
+	SBUF_manual(path);
+	path_join(NULL, &path, dir, name);
+
 	bool ret = false;
-	FILE *out;
-	if (!(out = output_open(dir, name))) {
+	struct fs_memstream ms;
+	if (!fs_memstream_open(&ms)) {
 		goto ret;
-	} else if (!cb(wk, ctx, out)) {
+	} else if (!cb(wk, ctx, ms.f)) {
 		goto ret;
-	} else if (!fs_fclose(out)) {
+	} else if (!fs_memstream_close(&ms)) {
+		goto ret;
+	} else if (!output_replace_if_changed(path.buf, &ms, changed && *changed, changed)) {
 		goto ret;
 	}
 
 	ret = true;
 ret:
+	fs_memstream_destroy(&ms);
+	sbuf_destroy(&path);
 	obj_array_pop(wk, wk->backend_output_stack);
 
 	TracyCZoneEnd(tctx_func);
 	return ret;
 }
+
+bool
+with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, with_open_callback cb)
+{
+	return with_open_changed(dir, name, wk, ctx, cb, NULL);
+}
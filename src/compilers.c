@@ -467,6 +467,21 @@ static_linker_detect(struct workspace *wk, obj comp, enum compiler_language lang
 	return true;
 }
 
+/*
+ * Unless it was built to default to lld, clang links with the system linker
+ * and the LLVM plugin.  Ask the driver which linker it runs, as lld and
+ * plugin linkers take different arguments for e.g. the thin lto cache.
+ */
+static bool
+linker_clang_is_lld(struct workspace *wk, struct obj_compiler *compiler)
+{
+	struct run_cmd_ctx cmd_ctx = { 0 };
+	bool res = run_cmd_arr(wk, &cmd_ctx, compiler->cmd_arr, "-Wl,--version") && cmd_ctx.status == 0
+		   && strstr(cmd_ctx.out.buf, "LLD");
+	run_cmd_ctx_destroy(&cmd_ctx);
+	return res;
+}
+
 static bool
 linker_detect(struct workspace *wk, obj comp, enum compiler_language lang, obj cmd_arr)
 {
@@ -492,6 +507,10 @@ linker_detect(struct workspace *wk, obj comp, enum compiler_language lang, obj c
 
 	run_cmd_ctx_destroy(&cmd_ctx);
 
+	if (type == linker_clang && !linker_clang_is_lld(wk, get_obj_compiler(wk, comp))) {
+		type = linker_llvm_plugin;
+	}
+
 	get_obj_compiler(wk, comp)->linker_cmd_arr = cmd_arr;
 	get_obj_compiler(wk, comp)->type[toolchain_component_linker] = type;
 	return true;
@@ -1063,6 +1082,73 @@ TOOLCHAIN_PROTO_0(compiler_gcc_args_lto)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_0(compiler_clang_args_thinlto)
+{
+	TOOLCHAIN_ARGS({ "-flto=thin" });
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_0(compiler_gcc_args_pch_ext)
+{
+	TOOLCHAIN_ARGS({ ".gch" });
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_2s(compiler_gcc_args_pch_create)
+{
+	TOOLCHAIN_ARGS({ "-x", NULL });
+
+	switch (comp->lang) {
+	case compiler_language_cpp: argv[1] = "c++-header"; break;
+	case compiler_language_objc: argv[1] = "objective-c-header"; break;
+	default: argv[1] = "c-header"; break;
+	}
+
+	return &args;
+	(void)a;
+	(void)b;
+}
+
+/* gcc looks for <header>.gch when the header is included, even if the header
+ * itself doesn't exist, so the pch is force-included by its path minus the
+ * extension.
+ */
+TOOLCHAIN_PROTO_2s(compiler_gcc_args_pch_use)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ "-include", buf });
+
+	const char *ext = toolchain_compiler_pch_ext(wk, comp)->args[0];
+	uint32_t len = strlen(b), ext_len = strlen(ext);
+	if (len > ext_len && strcmp(&b[len - ext_len], ext) == 0) {
+		len -= ext_len;
+	}
+
+	snprintf(buf, BUF_SIZE_S, "%.*s", len, b);
+
+	return &args;
+	(void)a;
+}
+
+TOOLCHAIN_PROTO_0(compiler_clang_args_pch_ext)
+{
+	TOOLCHAIN_ARGS({ ".pch" });
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_2s(compiler_clang_args_pch_use)
+{
+	TOOLCHAIN_ARGS({ "-include-pch", NULL });
+
+	argv[1] = b;
+
+	return &args;
+	(void)a;
+}
+
 /* cl compilers
  * see mesonbuild/compilers/mixins/visualstudio.py for reference
  */
@@ -1248,6 +1334,36 @@ TOOLCHAIN_PROTO_0(compiler_cl_args_object_extension)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_0(compiler_cl_args_pch_ext)
+{
+	TOOLCHAIN_ARGS({ ".pch" });
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_2s(compiler_cl_args_pch_create)
+{
+	static char buf1[BUF_SIZE_S], buf2[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf1, buf2 });
+
+	snprintf(buf1, BUF_SIZE_S, "/Yc%s", a);
+	snprintf(buf2, BUF_SIZE_S, "/Fp%s", b);
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_2s(compiler_cl_args_pch_use)
+{
+	static char buf1[BUF_SIZE_S], buf2[BUF_SIZE_S], buf3[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf1, buf2, buf3 });
+
+	snprintf(buf1, BUF_SIZE_S, "/FI%s", a);
+	snprintf(buf2, BUF_SIZE_S, "/Yu%s", a);
+	snprintf(buf3, BUF_SIZE_S, "/Fp%s", b);
+
+	return &args;
+}
+
 TOOLCHAIN_PROTO_1s(compiler_clang_cl_args_color_output)
 {
 	TOOLCHAIN_ARGS({ "-fcolor-diagnostics" });
@@ -1277,6 +1393,20 @@ TOOLCHAIN_PROTO_0(compiler_deps_msvc)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_0(compiler_pch_gcc)
+{
+	TOOLCHAIN_ARGS({ "gcc" });
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_0(compiler_pch_msvc)
+{
+	TOOLCHAIN_ARGS({ "msvc" });
+
+	return &args;
+}
+
 TOOLCHAIN_PROTO_1s(linker_posix_args_lib)
 {
 	TOOLCHAIN_ARGS({ "-l", NULL });
@@ -1370,6 +1500,62 @@ TOOLCHAIN_PROTO_1s(linker_ld_args_whole_archive)
 	return &args;
 }
 
+/* gcc runs the lto partitions in parallel itself.  When no thread count is
+ * given, -flto=auto is used if the compiler is new enough to know it.
+ */
+TOOLCHAIN_PROTO_1i(linker_ld_args_lto_threads)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	args.len = 1;
+
+	if (a) {
+		snprintf(buf, BUF_SIZE_S, "-flto=%d", a);
+	} else if (comp->ver && strtol(get_cstr(wk, comp->ver), NULL, 10) >= 10) {
+		snprintf(buf, BUF_SIZE_S, "-flto=auto");
+	} else {
+		args.len = 0;
+	}
+
+	return &args;
+}
+
+/* lld */
+
+TOOLCHAIN_PROTO_1i(linker_lld_args_lto_threads)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_S, "-flto-jobs=%d", a);
+	args.len = a ? 1 : 0;
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_1s(linker_lld_args_thinlto_cache_dir)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_S, "--thinlto-cache-dir=%s", a);
+
+	return &args;
+}
+
+/* bfd and gold with the LLVM plugin */
+
+TOOLCHAIN_PROTO_1s(linker_llvm_plugin_args_thinlto_cache_dir)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ "-plugin-opt", buf });
+
+	snprintf(buf, BUF_SIZE_S, "cache-dir=%s", a);
+
+	return &args;
+}
+
 /* cl linkers */
 
 TOOLCHAIN_PROTO_1s(linker_link_args_lib)
@@ -1421,6 +1607,27 @@ TOOLCHAIN_PROTO_1s(linker_lld_link_args_whole_archive)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_1i(linker_lld_link_args_lto_threads)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_S, "/opt:lldltojobs=%d", a);
+	args.len = a ? 1 : 0;
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_1s(linker_lld_link_args_thinlto_cache_dir)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_S, "/lldltocache:%s", a);
+
+	return &args;
+}
+
 /* apple linker */
 
 TOOLCHAIN_PROTO_1s(linker_apple_args_whole_archive)
@@ -1442,6 +1649,13 @@ TOOLCHAIN_PROTO_0(linker_apple_args_shared_module)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_1s(linker_apple_args_thinlto_cache_dir)
+{
+	TOOLCHAIN_ARGS({ "-cache_path_lto", NULL });
+	argv[1] = a;
+	return &args;
+}
+
 /* static linkers */
 
 TOOLCHAIN_PROTO_0(static_linker_ar_posix_args_base)
@@ -1518,11 +1732,18 @@ build_compilers(void)
 	gcc.args.color_output = compiler_gcc_args_color_output;
 	gcc.args.enable_lto = compiler_gcc_args_lto;
 	gcc.args.deps_type = compiler_deps_gcc;
+	gcc.args.pch_type = compiler_pch_gcc;
+	gcc.args.pch_ext = compiler_gcc_args_pch_ext;
+	gcc.args.pch_create = compiler_gcc_args_pch_create;
+	gcc.args.pch_use = compiler_gcc_args_pch_use;
 	gcc.default_linker = linker_ld;
 	gcc.default_static_linker = static_linker_ar_gcc;
 
 	struct compiler clang = gcc;
 	clang.args.warn_everything = compiler_clang_args_warn_everything;
+	clang.args.enable_thinlto = compiler_clang_args_thinlto;
+	clang.args.pch_ext = compiler_clang_args_pch_ext;
+	clang.args.pch_use = compiler_clang_args_pch_use;
 	clang.default_linker = linker_clang;
 
 	struct compiler apple_clang = clang;
@@ -1550,10 +1771,15 @@ build_compilers(void)
 	msvc.default_static_linker = static_linker_msvc;
 	msvc.args.object_ext = compiler_cl_args_object_extension;
 	msvc.args.deps_type = compiler_deps_msvc;
+	msvc.args.pch_type = compiler_pch_msvc;
+	msvc.args.pch_ext = compiler_cl_args_pch_ext;
+	msvc.args.pch_create = compiler_cl_args_pch_create;
+	msvc.args.pch_use = compiler_cl_args_pch_use;
 
 	struct compiler clang_cl = msvc;
 	clang_cl.args.color_output = compiler_clang_cl_args_color_output;
 	clang_cl.args.enable_lto = compiler_clang_cl_args_lto;
+	clang_cl.args.enable_thinlto = compiler_clang_args_thinlto;
 	clang_cl.default_linker = linker_lld_link;
 
 	compilers[compiler_posix] = posix;
@@ -1604,13 +1830,23 @@ build_linkers(void)
 	ld.args.fatal_warnings = linker_ld_args_fatal_warnings;
 	ld.args.whole_archive = linker_ld_args_whole_archive;
 	ld.args.enable_lto = compiler_gcc_args_lto;
+	ld.args.lto_threads = linker_ld_args_lto_threads;
 
 	struct linker lld = ld;
+	lld.args.enable_thinlto = compiler_clang_args_thinlto;
+	lld.args.lto_threads = linker_lld_args_lto_threads;
+	lld.args.thinlto_cache_dir = linker_lld_args_thinlto_cache_dir;
+
+	struct linker llvm_plugin = lld;
+	llvm_plugin.args.thinlto_cache_dir = linker_llvm_plugin_args_thinlto_cache_dir;
 
 	struct linker apple = posix;
 	posix.args.shared = linker_posix_args_shared;
 	apple.args.sanitize = compiler_gcc_args_sanitize;
 	apple.args.enable_lto = compiler_gcc_args_lto;
+	apple.args.enable_thinlto = compiler_clang_args_thinlto;
+	apple.args.lto_threads = linker_lld_args_lto_threads;
+	apple.args.thinlto_cache_dir = linker_apple_args_thinlto_cache_dir;
 	apple.args.allow_shlib_undefined = linker_apple_args_allow_shlib_undefined;
 	apple.args.shared_module = linker_apple_args_shared_module;
 	apple.args.whole_archive = linker_apple_args_whole_archive;
@@ -1626,10 +1862,13 @@ build_linkers(void)
 	struct linker lld_link = link;
 	lld_link.args.whole_archive = linker_lld_link_args_whole_archive;
 	lld_link.args.always = toolchain_arg_empty_0;
+	lld_link.args.lto_threads = linker_lld_link_args_lto_threads;
+	lld_link.args.thinlto_cache_dir = linker_lld_link_args_thinlto_cache_dir;
 
 	linkers[linker_posix] = posix;
 	linkers[linker_ld] = ld;
 	linkers[linker_clang] = lld;
+	linkers[linker_llvm_plugin] = llvm_plugin;
 	linkers[linker_apple] = apple;
 	linkers[linker_lld_link] = lld_link;
 	linkers[linker_msvc] = link;
@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+#include "configure_cache.h"
+#include "lang/object_iterators.h"
+#include "lang/serial.h"
+#include "options.h"
+#include "platform/filesystem.h"
+#include "platform/path.h"
+
+/*
+ * Helpers for caching the results of probing the environment (pkgconf, PATH,
+ * external programs) across configures.  Cached results are stored alongside
+ * a dict[path -> stamp] of the files they were derived from, and are
+ * considered stale as soon as any of the stamps change.
+ */
+
+bool
+configure_cache_enabled(struct workspace *wk)
+{
+	if (!wk->muon_private) {
+		return false;
+	}
+
+	obj opt;
+	get_option_value(wk, current_project(wk), "muon.configure_cache", &opt);
+	return get_obj_bool(wk, opt);
+}
+
+bool
+configure_cache_load(struct workspace *wk, const char *name, obj *res)
+{
+	SBUF(path);
+	path_join(wk, &path, wk->muon_private, name);
+
+	if (!fs_file_exists(path.buf)) {
+		return false;
+	}
+
+	FILE *f;
+	if (!(f = fs_fopen(path.buf, "rb"))) {
+		return false;
+	}
+
+	bool ok = serial_load(wk, res, f);
+
+	if (!fs_fclose(f)) {
+		return false;
+	}
+
+	return ok && get_obj_type(wk, *res) == obj_dict;
+}
+
+/*
+ * Returns a string identifying the current contents of path.  Files that
+ * don't exist get a stamp too, so that their appearance can be detected.
+ */
+obj
+configure_cache_stamp(struct workspace *wk, const char *path)
+{
+	int64_t mtime;
+	switch (fs_mtime(path, &mtime)) {
+	case fs_mtime_result_ok: break;
+	case fs_mtime_result_not_found: return make_str(wk, "missing");
+	case fs_mtime_result_err: return make_str(wk, "racy");
+	}
+
+	// Don't trust mtimes that are too close to the present: the file could
+	// still be modified within the same timestamp granularity without us
+	// noticing.  A "racy" stamp is always considered changed.
+	if (mtime / 1000000000 >= (int64_t)time(NULL) - 1) {
+		return make_str(wk, "racy");
+	}
+
+	struct stat st;
+	if (!fs_stat(path, &st)) {
+		return make_str(wk, "racy");
+	}
+
+	return make_strf(wk,
+		"%" PRId64 ":%" PRId64 ":%" PRId64,
+		mtime,
+		(int64_t)st.st_size,
+		(int64_t)st.st_ino);
+}
+
+void
+configure_cache_record(struct workspace *wk, obj files, const char *path)
+{
+	if (!files) {
+		return;
+	}
+
+	obj_dict_set(wk, files, make_str(wk, path), configure_cache_stamp(wk, path));
+}
+
+bool
+configure_cache_files_changed(struct workspace *wk, obj files)
+{
+	obj path, stamp;
+	obj_dict_for(wk, files, path, stamp) {
+		if (str_eql(get_str(wk, stamp), &WKSTR("racy"))
+			|| !obj_equal(wk, stamp, configure_cache_stamp(wk, get_cstr(wk, path)))) {
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,472 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "args.h"
+#include "backend/common_args.h"
+#include "backend/output.h"
+#include "buf_size.h"
+#include "configure_cache.h"
+#include "configure_fingerprint.h"
+#include "datastructures/hash.h"
+#include "functions/environment.h"
+#include "lang/lexer.h"
+#include "lang/object_iterators.h"
+#include "lang/serial.h"
+#include "log.h"
+#include "platform/filesystem.h"
+#include "platform/path.h"
+#include "platform/run_cmd.h"
+
+/*
+ * The configure fingerprint records everything a configure read from outside
+ * of the build files: the contents of wk->regenerate_deps, the environment
+ * variables that were looked at, the result of every run_command(), the
+ * options given on the command line, the programs found in PATH, the
+ * compilers used, and muon itself.
+ *
+ * This is not everything a configure depends on: fs module probes of paths
+ * outside of the build files, pkg-config search directories, and the system
+ * headers and libraries behind compiler checks aren't tracked.  Because of
+ * that only the REGENERATE_BUILD rule, which passes -r to muon setup, may
+ * skip a configure.  There ninja already decided that one of the
+ * regenerate_deps changed, and the fingerprint is compared against the
+ * current state before anything is evaluated.  If nothing changed the
+ * previous build files are kept as they are, otherwise the inputs that
+ * changed are reported and a full configure is done.  Running muon setup by
+ * hand always reconfigures.
+ *
+ * meson.build and meson.options files are fingerprinted by their tokens so
+ * that editing comments or whitespace doesn't cause a reconfigure.  Other
+ * files are fingerprinted by their contents rather than their mtimes so that
+ * e.g. a git checkout that doesn't change anything is also not a reason to
+ * reconfigure.
+ */
+
+static obj
+fingerprint_hash_str(struct workspace *wk, uint64_t h)
+{
+	return make_strf(wk, "%016" PRIx64, h);
+}
+
+static bool
+fingerprint_is_meson_file(struct workspace *wk, const char *path)
+{
+	SBUF(base);
+	path_basename(wk, &base, path);
+	return strcmp(base.buf, "meson.build") == 0 || strcmp(base.buf, "meson.options") == 0
+	       || strcmp(base.buf, "meson_options.txt") == 0;
+}
+
+static bool
+fingerprint_hash_tokens(struct workspace *wk, struct source *src, uint64_t *res)
+{
+	struct obj_clear_mark mk;
+	obj_set_clear_mark(wk, &mk);
+
+	SBUF(buf);
+	struct lexer lexer;
+	struct token token;
+	enum token_type prev = token_type_eol;
+	bool ok = true;
+
+	lexer_init(&lexer, wk, src, 0);
+	do {
+		lexer_next(&lexer, &token);
+
+		if (token.type == token_type_error) {
+			ok = false;
+			break;
+		} else if (token.type == token_type_eol && prev == token_type_eol) {
+			continue;
+		}
+
+		prev = token.type;
+
+		int32_t type = token.type;
+		sbuf_pushn(wk, &buf, (const char *)&type, sizeof(type));
+
+		switch (token.type) {
+		case token_type_identifier:
+		case token_type_string:
+		case token_type_fstring: {
+			const struct str *s = get_str(wk, token.data.str);
+			sbuf_pushn(wk, &buf, (const char *)&s->len, sizeof(s->len));
+			sbuf_pushn(wk, &buf, s->s, s->len);
+			break;
+		}
+		case token_type_number: sbuf_pushn(wk, &buf, (const char *)&token.data.num, sizeof(token.data.num)); break;
+		default: break;
+		}
+	} while (token.type != token_type_eof);
+	lexer_destroy(&lexer);
+
+	*res = hash_bytes(buf.buf, buf.len);
+	obj_clear(wk, &mk);
+	return ok;
+}
+
+static obj
+fingerprint_file(struct workspace *wk, const char *path)
+{
+	struct source src = { 0 };
+	if (!fs_file_exists(path) || !fs_read_entire_file(path, &src)) {
+		return make_str(wk, "missing");
+	}
+
+	uint64_t h;
+	if (!fingerprint_is_meson_file(wk, path) || !fingerprint_hash_tokens(wk, &src, &h)) {
+		h = hash_bytes(src.src, src.len);
+	}
+
+	fs_source_destroy(&src);
+	return fingerprint_hash_str(wk, h);
+}
+
+static obj
+fingerprint_run_result(struct workspace *wk, const struct run_cmd_ctx *cmd_ctx)
+{
+	return make_strf(wk,
+		"%d:%016" PRIx64 ":%016" PRIx64,
+		cmd_ctx->status,
+		hash_bytes(cmd_ctx->out.buf, cmd_ctx->out.len),
+		hash_bytes(cmd_ctx->err.buf, cmd_ctx->err.len));
+}
+
+static obj
+fingerprint_find_cmd(struct workspace *wk, const char *cmd)
+{
+	SBUF(path);
+	if (!fs_find_cmd(wk, &path, cmd)) {
+		return obj_bool_false;
+	}
+
+	return sbuf_into_str(wk, &path);
+}
+
+// find_program_path_cache keys are PATH and the command separated by a newline
+static const char *
+fingerprint_program_name(struct workspace *wk, obj key)
+{
+	const char *s = get_cstr(wk, key), *sep;
+	return (sep = strrchr(s, '\n')) ? sep + 1 : s;
+}
+
+const char *
+configure_fingerprint_getenv(struct workspace *wk, const char *name)
+{
+	const char *v = getenv(name);
+
+	// Objects created during backend output don't outlive the target being
+	// written, so variables are only recorded while evaluating.
+	if (wk->fingerprint_env && !wk->backend_output_stack) {
+		obj_dict_set(wk, wk->fingerprint_env, make_str(wk, name), v ? make_str(wk, v) : obj_bool_false);
+	}
+
+	return v;
+}
+
+void
+configure_fingerprint_run_command(struct workspace *wk, obj args, obj env, const struct run_cmd_ctx *cmd_ctx)
+{
+	if (!wk->fingerprint_run_commands) {
+		return;
+	}
+
+	obj env_dict, entry;
+	if (!environment_to_dict(wk, env, &env_dict)) {
+		UNREACHABLE;
+	}
+
+	make_obj(wk, &entry, obj_array);
+	obj_array_push(wk, entry, args);
+	obj_array_push(wk, entry, env_dict);
+	obj_array_push(wk, entry, fingerprint_run_result(wk, cmd_ctx));
+	obj_array_push(wk, wk->fingerprint_run_commands, entry);
+}
+
+/*
+ * The options a configure was requested with, as a dict[name -> value].
+ * This is taken from the same arguments that the REGENERATE_BUILD rule passes
+ * along, so that the options set from the environment compare equal to the
+ * -D arguments they are turned into when regenerating.
+ */
+static obj
+fingerprint_options(struct workspace *wk)
+{
+	obj opts, args = regenerate_build_command(wk, true);
+	make_obj(wk, &opts, obj_dict);
+
+	uint32_t i, len = get_obj_array(wk, args)->len;
+	for (i = 0; i < len; ++i) {
+		obj v;
+		obj_array_index(wk, args, i, &v);
+		const char *s = get_cstr(wk, v);
+
+		if (strcmp(s, "-D") == 0 && i + 1 < len) {
+			obj_array_index(wk, args, ++i, &v);
+			s = get_cstr(wk, v);
+		} else if (strncmp(s, "-D", 2) == 0) {
+			s += 2;
+		} else {
+			if (strcmp(s, "-c") == 0 || strcmp(s, "-b") == 0 || strcmp(s, "-p") == 0) {
+				++i;
+			}
+			continue;
+		}
+
+		const char *sep;
+		if (!(sep = strchr(s, '='))) {
+			continue;
+		}
+
+		obj_dict_set(wk, opts, make_strn(wk, s, sep - s), make_str(wk, sep + 1));
+	}
+
+	return opts;
+}
+
+static obj
+fingerprint_muon(struct workspace *wk)
+{
+	obj path = fingerprint_find_cmd(wk, wk->argv0);
+	return path == obj_bool_false ? make_str(wk, "missing") : configure_cache_stamp(wk, get_cstr(wk, path));
+}
+
+static void
+fingerprint_push_compiler_cmd(struct workspace *wk, obj compilers, obj cmd_arr)
+{
+	obj cmd, path;
+	if (!cmd_arr || !get_obj_array(wk, cmd_arr)->len) {
+		return;
+	}
+
+	obj_array_index(wk, cmd_arr, 0, &cmd);
+	if ((path = fingerprint_find_cmd(wk, get_cstr(wk, cmd))) == obj_bool_false) {
+		return;
+	}
+
+	obj_dict_set(wk, compilers, path, configure_cache_stamp(wk, get_cstr(wk, path)));
+}
+
+static bool
+configure_fingerprint_write_cb(struct workspace *wk, void *_ctx, FILE *out)
+{
+	return serial_dump(wk, *(obj *)_ctx, out);
+}
+
+bool
+configure_fingerprint_write(struct workspace *wk, obj opts)
+{
+	obj fp, files, env, programs, compilers, deduped, k, v;
+	make_obj(wk, &fp, obj_dict);
+
+	make_obj(wk, &files, obj_dict);
+	obj_array_dedup(wk, wk->regenerate_deps, &deduped);
+	obj_array_for(wk, deduped, v) {
+		obj_dict_set(wk, files, v, fingerprint_file(wk, get_cstr(wk, v)));
+	}
+
+	// Variables that are read by the programs muon runs rather than muon
+	// itself, but which commonly affect the result of a configure.
+	const char *extra_env[] = { "PATH", "PKG_CONFIG_PATH", "PKG_CONFIG_LIBDIR", "PKG_CONFIG_SYSROOT_DIR" };
+	uint32_t i;
+	for (i = 0; i < ARRAY_LEN(extra_env); ++i) {
+		configure_fingerprint_getenv(wk, extra_env[i]);
+	}
+	env = wk->fingerprint_env;
+
+	make_obj(wk, &programs, obj_dict);
+	if (wk->find_program_path_cache) {
+		obj_dict_for(wk, wk->find_program_path_cache, k, v) {
+			obj_dict_set(wk, programs, make_str(wk, fingerprint_program_name(wk, k)), v);
+		}
+	}
+
+	make_obj(wk, &compilers, obj_dict);
+	for (i = 0; i < wk->projects.len; ++i) {
+		struct project *proj = arr_get(&wk->projects, i);
+		if (proj->not_ok) {
+			continue;
+		}
+
+		obj_dict_for(wk, proj->compilers, k, v) {
+			(void)k;
+			struct obj_compiler *comp = get_obj_compiler(wk, v);
+			fingerprint_push_compiler_cmd(wk, compilers, comp->cmd_arr);
+			fingerprint_push_compiler_cmd(wk, compilers, comp->linker_cmd_arr);
+			fingerprint_push_compiler_cmd(wk, compilers, comp->static_linker_cmd_arr);
+		}
+	}
+
+	obj_dict_set(wk, fp, make_str(wk, "muon"), fingerprint_muon(wk));
+	obj_dict_set(wk, fp, make_str(wk, "options"), opts);
+	obj_dict_set(wk, fp, make_str(wk, "files"), files);
+	obj_dict_set(wk, fp, make_str(wk, "env"), env);
+	obj_dict_set(wk, fp, make_str(wk, "programs"), programs);
+	obj_dict_set(wk, fp, make_str(wk, "compilers"), compilers);
+	obj_dict_set(wk, fp, make_str(wk, "run_commands"), wk->fingerprint_run_commands);
+
+	return with_open(wk->muon_private, output_path.configure_fingerprint, wk, &fp, configure_fingerprint_write_cb);
+}
+
+static void
+fingerprint_check_files(struct workspace *wk, obj files, obj changed)
+{
+	obj path, hash;
+	obj_dict_for(wk, files, path, hash) {
+		if (!obj_equal(wk, hash, fingerprint_file(wk, get_cstr(wk, path)))) {
+			SBUF(rel);
+			path_relative_to(wk, &rel, wk->source_root, get_cstr(wk, path));
+			obj_array_push(wk, changed, make_strf(wk, "file %s", rel.buf));
+		}
+	}
+}
+
+static void
+fingerprint_check_env(struct workspace *wk, obj env, obj changed)
+{
+	obj name, val;
+	obj_dict_for(wk, env, name, val) {
+		const char *cur = getenv(get_cstr(wk, name));
+		if (val == obj_bool_false ? !!cur : (!cur || strcmp(cur, get_cstr(wk, val)) != 0)) {
+			obj_array_push(wk, changed, make_strf(wk, "environment variable %s", get_cstr(wk, name)));
+		}
+	}
+}
+
+static void
+fingerprint_check_programs(struct workspace *wk, obj programs, obj changed)
+{
+	obj name, path;
+	obj_dict_for(wk, programs, name, path) {
+		if (!obj_equal(wk, path, fingerprint_find_cmd(wk, get_cstr(wk, name)))) {
+			obj_array_push(wk, changed, make_strf(wk, "program %s", get_cstr(wk, name)));
+		}
+	}
+}
+
+static void
+fingerprint_check_compilers(struct workspace *wk, obj compilers, obj changed)
+{
+	obj path, stamp;
+	obj_dict_for(wk, compilers, path, stamp) {
+		if (str_eql(get_str(wk, stamp), &WKSTR("racy"))
+			|| !obj_equal(wk, stamp, configure_cache_stamp(wk, get_cstr(wk, path)))) {
+			obj_array_push(wk, changed, make_strf(wk, "compiler %s", get_cstr(wk, path)));
+		}
+	}
+}
+
+static void
+fingerprint_check_run_commands(struct workspace *wk, obj run_commands, obj changed)
+{
+	obj entry;
+	obj_array_for(wk, run_commands, entry) {
+		obj args, env, result;
+		obj_array_index(wk, entry, 0, &args);
+		obj_array_index(wk, entry, 1, &env);
+		obj_array_index(wk, entry, 2, &result);
+
+		const char *argstr, *envstr;
+		uint32_t argc, envc;
+		join_args_argstr(wk, &argstr, &argc, args);
+		env_to_envstr(wk, &envstr, &envc, env);
+
+		struct run_cmd_ctx cmd_ctx = { 0 };
+		bool same = run_cmd(&cmd_ctx, argstr, argc, envstr, envc)
+			    && obj_equal(wk, result, fingerprint_run_result(wk, &cmd_ctx));
+		run_cmd_ctx_destroy(&cmd_ctx);
+
+		if (!same) {
+			obj_array_push(wk, changed, make_strf(wk, "output of run_command(%s)", get_cstr(wk, join_args_shell(wk, args))));
+			return;
+		}
+	}
+}
+
+static void
+fingerprint_remove(struct workspace *wk)
+{
+	SBUF(path);
+	path_join(wk, &path, wk->muon_private, output_path.configure_fingerprint);
+	if (fs_file_exists(path.buf)) {
+		fs_remove(path.buf);
+	}
+}
+
+/*
+ * Returns true if none of the inputs recorded by the last successful
+ * configure changed.  The options this configure was requested with are
+ * returned in opts to be recorded by configure_fingerprint_write.
+ *
+ * The build files are rewritten whenever false is returned, so the previous
+ * fingerprint is removed to not outlive a configure that fails halfway
+ * through.
+ */
+bool
+configure_fingerprint_check(struct workspace *wk, bool force, obj *opts)
+{
+	*opts = fingerprint_options(wk);
+
+	SBUF(path);
+	path_join(wk, &path, wk->build_root, "build.ninja");
+
+	obj fp;
+	if (force || !fs_file_exists(path.buf) || !configure_cache_load(wk, output_path.configure_fingerprint, &fp)) {
+		fingerprint_remove(wk);
+		return false;
+	}
+
+	obj changed, v;
+	make_obj(wk, &changed, obj_array);
+
+	if (!obj_dict_index_str(wk, fp, "muon", &v) || !obj_equal(wk, v, fingerprint_muon(wk))) {
+		obj_array_push(wk, changed, make_str(wk, "muon executable"));
+	}
+
+	if (!obj_dict_index_str(wk, fp, "options", &v) || !obj_equal(wk, v, *opts)) {
+		obj_array_push(wk, changed, make_str(wk, "command line options"));
+	}
+
+	if (obj_dict_index_str(wk, fp, "env", &v)) {
+		fingerprint_check_env(wk, v, changed);
+	}
+
+	if (obj_dict_index_str(wk, fp, "files", &v)) {
+		fingerprint_check_files(wk, v, changed);
+	}
+
+	if (obj_dict_index_str(wk, fp, "programs", &v)) {
+		fingerprint_check_programs(wk, v, changed);
+	}
+
+	if (obj_dict_index_str(wk, fp, "compilers", &v)) {
+		fingerprint_check_compilers(wk, v, changed);
+	}
+
+	// Commands are only rerun if nothing else changed, otherwise they
+	// would just be run again during the configure.
+	if (!get_obj_array(wk, changed)->len && obj_dict_index_str(wk, fp, "run_commands", &v)) {
+		fingerprint_check_run_commands(wk, v, changed);
+	}
+
+	if (!get_obj_array(wk, changed)->len) {
+		return true;
+	}
+
+	LOG_I("reconfiguring, changed inputs:");
+	obj_array_for(wk, changed, v) {
+		log_plain("  %s\n", get_cstr(wk, v));
+	}
+
+	fingerprint_remove(wk);
+	return false;
+}
@@ -24,63 +24,196 @@
 
 #define LOAD_FACTOR 0.5f
 
+#define hash_key_removed UINT32_MAX
+
+/*
+ * Control bytes are probed a group at a time.  A group is loaded from any
+ * offset into the control bytes, so the first group_width - 1 of them are
+ * mirrored after the end of the table.  Matches are returned as a mask with
+ * one bit set per matching byte, at bit (index << group_shift).
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+enum {
+	group_width = 16,
+	group_shift = 0,
+};
+
+typedef __m128i group;
+
+static inline group
+group_load(const uint8_t *ctrl)
+{
+	return _mm_loadu_si128((const __m128i *)ctrl);
+}
+
+static inline uint64_t
+group_match(group g, uint8_t h2)
+{
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)h2)));
+}
+
+static inline uint64_t
+group_match_empty(group g)
+{
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)k_empty)));
+}
+
+// empty or deleted
+static inline uint64_t
+group_match_available(group g)
+{
+	return (uint32_t)_mm_movemask_epi8(g);
+}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+enum {
+	group_width = 16,
+	group_shift = 2,
+};
+
+typedef uint8x16_t group;
+
+static inline group
+group_load(const uint8_t *ctrl)
+{
+	return vld1q_u8(ctrl);
+}
+
+// Narrow each byte of a comparison result to a nibble and keep one bit of it.
+static inline uint64_t
+group_mask(uint8x16_t cmp)
+{
+	uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888u;
+}
+
+static inline uint64_t
+group_match(group g, uint8_t h2)
+{
+	return group_mask(vceqq_u8(g, vdupq_n_u8(h2)));
+}
+
+static inline uint64_t
+group_match_empty(group g)
+{
+	return group_mask(vceqq_u8(g, vdupq_n_u8(k_empty)));
+}
+
+// empty or deleted
+static inline uint64_t
+group_match_available(group g)
+{
+	return group_mask(vtstq_u8(g, vdupq_n_u8(0x80)));
+}
+#else
+enum {
+	group_width = 8,
+	group_shift = 3,
+};
+
+typedef uint64_t group;
+
+#define group_lsbs 0x0101010101010101u
+#define group_msbs 0x8080808080808080u
+
+static inline group
+group_load(const uint8_t *ctrl)
+{
+	uint64_t g;
+	memcpy(&g, ctrl, sizeof(g));
+	return g;
+}
+
+// May report false positives, but only next to a real match.  Matches are
+// always confirmed by comparing keys.
+static inline uint64_t
+group_match(group g, uint8_t h2)
+{
+	uint64_t x = g ^ (group_lsbs * h2);
+	return (x - group_lsbs) & ~x & group_msbs;
+}
+
+static inline uint64_t
+group_match_empty(group g)
+{
+	// k_empty is the only control byte with the high bit set and bit 1 unset
+	return g & ~(g << 6) & group_msbs;
+}
+
+// empty or deleted
+static inline uint64_t
+group_match_available(group g)
+{
+	return g & group_msbs;
+}
+#endif
+
+static inline uint32_t
+group_mask_lowest(uint64_t m)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(m) >> group_shift;
+#else
+	uint32_t n = 0;
+	while (!(m & 1)) {
+		m >>= 1;
+		++n;
+	}
+	return n >> group_shift;
+#endif
+}
+
 struct strkey {
 	const char *str;
 	uint64_t len;
 };
 
 static uint64_t
-fnv_1a_64_str(const struct hash *hash, const void *_key)
+hash_func_str(const struct hash *hash, const void *_key)
 {
 	const struct strkey *key = _key;
-	uint64_t h = 14695981039346656037u;
-	uint16_t i;
-
-	for (i = 0; i < key->len; i++) {
-		h ^= key->str[i];
-		h *= 1099511628211u;
-	}
-
-	return h;
+	return hash_bytes(key->str, key->len);
 }
 
 static uint64_t
-fnv_1a_64(const struct hash *hash, const void *_key)
+hash_func_mem(const struct hash *hash, const void *key)
 {
-	const uint8_t *key = _key;
-	uint64_t h = 14695981039346656037u;
-	uint16_t i;
-
-	for (i = 0; i < hash->keys.item_size; i++) {
-		h ^= key[i];
-		h *= 1099511628211u;
-	}
-
-	return h;
+	return hash_bytes(key, hash->keys.item_size);
 }
 
 struct hash_elem {
 	uint64_t val, keyi;
 };
 
+static uint32_t
+hash_ctrl_len(uint32_t cap)
+{
+	return cap + group_width - 1;
+}
+
 static void
-fill_meta_with_empty(struct hash *h)
+set_ctrl(struct hash *h, uint32_t i, uint8_t v)
 {
-	const uint32_t len = h->cap >> 3;
-	uint64_t *e = (uint64_t *)h->meta.e;
+	uint8_t *ctrl = h->meta.e;
+	ctrl[i] = v;
+	// Write the mirrored byte as well, or ctrl[i] again when i has none.
+	ctrl[((i - (group_width - 1)) & h->capm) + (group_width - 1)] = v;
+}
 
-	uint32_t i;
-	for (i = 0; i < len; ++i) {
-		e[i] = 9259542123273814144u;
-		/* this number is just k_empty (128) 8 times:
-		 * ((128 << 56) | (128 << 48) | (128 << 40) | (128 << 32)
-		 * | (128 << 24) | (128 << 16) | (128 << 8) | (128)) */
-	}
+static void
+fill_meta_with_empty(struct hash *h)
+{
+	memset(h->meta.e, k_empty, hash_ctrl_len(h->cap));
 }
 
 static void
 prepare_table(struct hash *h)
 {
+	arr_init(&h->meta, hash_ctrl_len(h->cap), sizeof(uint8_t));
+	arr_init(&h->e, h->cap, sizeof(struct hash_elem));
 	fill_meta_with_empty(h);
 }
 
@@ -95,22 +228,26 @@ hash_init(struct hash *h, uint32_t cap, uint32_t keysize)
 {
 	ASSERT_VALID_CAP(cap);
 
+	// every table holds at least one full group
+	if (cap < group_width) {
+		cap = group_width;
+	}
+
 	*h = (struct hash){ .cap = cap, .capm = cap - 1, .max_load = (uint32_t)((float)cap * LOAD_FACTOR) };
-	arr_init(&h->meta, h->cap, sizeof(uint8_t));
-	arr_init(&h->e, h->cap, sizeof(struct hash_elem));
 	arr_init(&h->keys, h->cap, keysize);
+	arr_init(&h->key_slots, h->cap, sizeof(uint32_t));
 
 	prepare_table(h);
 
 	h->keycmp = hash_keycmp_memcmp;
-	h->hash_func = fnv_1a_64;
+	h->hash_func = hash_func_mem;
 }
 
 static bool
 hash_keycmp_strcmp(const struct hash *_h, const void *_a, const void *_b)
 {
 	const struct strkey *a = _a, *b = _b;
-	return a->len == b->len ? strncmp(a->str, b->str, a->len) == 0 : false;
+	return a->len == b->len ? memcmp(a->str, b->str, a->len) == 0 : false;
 }
 
 void
@@ -118,7 +255,7 @@ hash_init_str(struct hash *h, uint32_t cap)
 {
 	hash_init(h, cap, sizeof(struct strkey));
 	h->keycmp = hash_keycmp_strcmp;
-	h->hash_func = fnv_1a_64_str;
+	h->hash_func = hash_func_str;
 }
 
 void
@@ -127,6 +264,7 @@ hash_destroy(struct hash *h)
 	arr_destroy(&h->meta);
 	arr_destroy(&h->e);
 	arr_destroy(&h->keys);
+	arr_destroy(&h->key_slots);
 }
 
 void
@@ -172,33 +310,100 @@ void
 hash_clear(struct hash *h)
 {
 	h->len = h->load = 0;
+	arr_clear(&h->keys);
+	arr_clear(&h->key_slots);
 	fill_meta_with_empty(h);
 }
 
-static void
-probe(const struct hash *h, const void *key, struct hash_elem **ret_he, uint8_t **ret_meta, uint64_t *hv)
+/*
+ * Look up key, whose hash is hv.  If it is found, its slot is returned in
+ * *slot.  Otherwise *slot is set to the first empty or deleted slot in its
+ * probe sequence, which is where it would be inserted.
+ *
+ * Groups are visited with a triangular stride, which reaches every group
+ * because the number of groups is a power of two.  The table always has an
+ * empty slot, see LOAD_FACTOR, so probing terminates.
+ */
+static bool
+probe(const struct hash *h, const void *key, uint64_t hv, uint32_t *slot)
 {
-#define match ((meta & 0x7f) == h2 && h->keycmp(h, h->keys.e + (h->keys.item_size * he->keyi), key))
+	const uint8_t *ctrl = h->meta.e, h2 = hv & 0x7f;
+	const struct hash_elem *elems = (const struct hash_elem *)h->e.e;
+	uint32_t pos = (hv >> 7) & h->capm, stride = 0, avail = UINT32_MAX;
+	uint64_t m, empty;
+
+	while (true) {
+		group g = group_load(&ctrl[pos]);
+
+		// A key is never stored past the first empty slot of its probe
+		// sequence, so candidates after it can be skipped.
+		m = group_match(g, h2);
+		if ((empty = group_match_empty(g))) {
+			m &= (empty & -empty) - 1;
+		}
 
-	struct hash_elem *he;
-	*hv = h->hash_func(h, key);
-	const uint64_t h1 = *hv >> 7, h2 = *hv & 0x7f;
-	uint8_t meta;
-	uint64_t hvi = h1 & h->capm;
-
-	meta = ((uint8_t *)h->meta.e)[hvi];
-	he = &((struct hash_elem *)h->e.e)[hvi];
-
-	while (meta == k_deleted || (k_full(meta) && !match)) {
-		hvi = (hvi + 1) & h->capm;
-		meta = ((uint8_t *)h->meta.e)[hvi];
-		he = &((struct hash_elem *)h->e.e)[hvi];
+		for (; m; m &= m - 1) {
+			uint32_t i = (pos + group_mask_lowest(m)) & h->capm;
+			if (h->keycmp(h, h->keys.e + (h->keys.item_size * elems[i].keyi), key)) {
+				*slot = i;
+				return true;
+			}
+		}
+
+		if (avail == UINT32_MAX && (m = group_match_available(g))) {
+			avail = (pos + group_mask_lowest(m)) & h->capm;
+		}
+
+		if (empty) {
+			*slot = avail;
+			return false;
+		}
+
+		stride += group_width;
+		pos = (pos + stride) & h->capm;
 	}
+}
+
+// Find a slot for a key known not to be in the table.
+static uint32_t
+probe_available(const struct hash *h, uint64_t hv)
+{
+	const uint8_t *ctrl = h->meta.e;
+	uint32_t pos = (hv >> 7) & h->capm, stride = 0;
+	uint64_t m;
 
-	*ret_meta = &((uint8_t *)h->meta.e)[hvi];
-	*ret_he = he;
+	while (!(m = group_match_available(group_load(&ctrl[pos])))) {
+		stride += group_width;
+		pos = (pos + stride) & h->capm;
+	}
 
-#undef match
+	return (pos + group_mask_lowest(m)) & h->capm;
+}
+
+/*
+ * Drop removed keys from the key storage, keeping the rest in insertion
+ * order.
+ */
+static void
+compact_keys(struct hash *h)
+{
+	uint32_t i, j, slot, *key_slots = (uint32_t *)h->key_slots.e;
+	const uint32_t item_size = h->keys.item_size;
+
+	for (i = j = 0; i < h->keys.len; ++i) {
+		if ((slot = key_slots[i]) == hash_key_removed) {
+			continue;
+		}
+
+		if (i != j) {
+			memcpy(h->keys.e + (item_size * j), h->keys.e + (item_size * i), item_size);
+			key_slots[j] = slot;
+			((struct hash_elem *)h->e.e)[slot].keyi = j;
+		}
+		++j;
+	}
+
+	h->keys.len = h->key_slots.len = j;
 }
 
 static void
@@ -207,27 +412,27 @@ resize(struct hash *h, uint32_t newcap)
 	ASSERT_VALID_CAP(newcap);
 	assert(h->len <= newcap);
 
-	uint32_t i;
-	struct hash_elem *ohe, *he;
+	uint32_t i, slot;
+	struct hash_elem *ohe;
 	uint64_t hv;
-	uint8_t *meta;
-	void *key;
+
+	if (h->keys.len > h->len) {
+		compact_keys(h);
+	}
 
 	struct hash newh = (struct hash){
 		.cap = newcap,
 		.capm = newcap - 1,
 		.keys = h->keys,
+		.key_slots = h->key_slots,
 		.len = h->len,
-		.load = h->load,
+		.load = h->len,
 		.max_load = (uint32_t)((float)newcap * LOAD_FACTOR),
 
 		.hash_func = h->hash_func,
 		.keycmp = h->keycmp,
 	};
 
-	arr_init(&newh.meta, newh.cap, sizeof(uint8_t));
-	arr_init(&newh.e, newh.cap, sizeof(struct hash_elem));
-
 	prepare_table(&newh);
 
 	for (i = 0; i < h->cap; ++i) {
@@ -236,14 +441,13 @@ resize(struct hash *h, uint32_t newcap)
 		}
 
 		ohe = &((struct hash_elem *)h->e.e)[i];
-		key = h->keys.e + (h->keys.item_size * ohe->keyi);
-
-		probe(&newh, key, &he, &meta, &hv);
+		hv = h->hash_func(h, h->keys.e + (h->keys.item_size * ohe->keyi));
 
-		assert(!k_full(*meta));
+		slot = probe_available(&newh, hv);
 
-		*he = *ohe;
-		*meta = hv & 0x7f;
+		((struct hash_elem *)newh.e.e)[slot] = *ohe;
+		((uint32_t *)newh.key_slots.e)[ohe->keyi] = slot;
+		set_ctrl(&newh, slot, hv & 0x7f);
 	}
 
 	arr_destroy(&h->meta);
@@ -254,13 +458,13 @@ resize(struct hash *h, uint32_t newcap)
 uint64_t *
 hash_get(const struct hash *h, const void *key)
 {
-	struct hash_elem *he;
-	uint64_t hv;
-	uint8_t *meta;
+	uint32_t slot;
 
-	probe(h, key, &he, &meta, &hv);
+	if (probe(h, key, h->hash_func(h, key), &slot)) {
+		return &((struct hash_elem *)h->e.e)[slot].val;
+	}
 
-	return k_full(*meta) ? &he->val : NULL;
+	return NULL;
 }
 
 uint64_t *
@@ -270,21 +474,38 @@ hash_get_strn(const struct hash *h, const char *str, uint64_t len)
 	return hash_get(h, &key);
 }
 
+uint64_t *
+hash_next_at(const struct hash *h, uint32_t *i)
+{
+	const uint32_t *key_slots = (const uint32_t *)h->key_slots.e;
+
+	for (; *i < h->key_slots.len; ++*i) {
+		if (key_slots[*i] != hash_key_removed) {
+			return &((struct hash_elem *)h->e.e)[key_slots[*i]].val;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Removed keys are left in the key storage, marked as removed, so that the
+ * remaining keys keep their insertion order and indices.  They are dropped
+ * the next time the table is rehashed.
+ */
 void
 hash_unset(struct hash *h, const void *key)
 {
-	struct hash_elem *he;
-	uint64_t hv;
-	uint8_t *meta;
-
-	probe(h, key, &he, &meta, &hv);
+	uint32_t slot;
 
-	if (k_full(*meta)) {
-		*meta = k_deleted;
-		--h->len;
+	if (!probe(h, key, h->hash_func(h, key), &slot)) {
+		return;
 	}
 
-	assert(hash_get(h, key) == NULL);
+	set_ctrl(h, slot, k_deleted);
+	--h->len;
+
+	((uint32_t *)h->key_slots.e)[((struct hash_elem *)h->e.e)[slot].keyi] = hash_key_removed;
 }
 
 void
@@ -298,24 +519,33 @@ void
 hash_set(struct hash *h, const void *key, uint64_t val)
 {
 	if (h->load > h->max_load) {
-		resize(h, h->cap << 1);
+		// Rehash in place when most of the load is deleted slots.
+		resize(h, h->len > h->max_load / 2 ? h->cap << 1 : h->cap);
+	} else if (h->keys.len - h->len > h->max_load) {
+		// Deleted slots are reused by later inserts, so removed keys may
+		// pile up without the table ever being rehashed.
+		compact_keys(h);
 	}
 
+	uint32_t slot;
+	const uint64_t hv = h->hash_func(h, key);
 	struct hash_elem *he;
-	uint64_t hv;
-	uint8_t *meta;
 
-	probe(h, key, &he, &meta, &hv);
+	if (probe(h, key, hv, &slot)) {
+		((struct hash_elem *)h->e.e)[slot].val = val;
+		return;
+	}
 
-	if (k_full(*meta)) {
-		he->val = val;
-	} else {
-		he->keyi = arr_push(&h->keys, key);
-		he->val = val;
-		*meta = hv & 0x7f;
-		++h->len;
+	if (((uint8_t *)h->meta.e)[slot] == k_empty) {
 		++h->load;
 	}
+
+	he = &((struct hash_elem *)h->e.e)[slot];
+	he->keyi = arr_push(&h->keys, key);
+	arr_push(&h->key_slots, &slot);
+	he->val = val;
+	set_ctrl(h, slot, hv & 0x7f);
+	++h->len;
 }
 
 void
@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include "datastructures/hash.h"
+
+/*
+ * wyhash, https://github.com/wangyi-fudan/wyhash, released into the public
+ * domain.  Input is always read as little endian, so the result is the same
+ * on every machine.  tools/embedder.c relies on this since it picks the seed
+ * for embedded_hash on the build machine.
+ *
+ * Kept out of hash.c so that tools/embedder.c can link against it on its
+ * own.
+ */
+static inline void
+wymum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = *a;
+	r *= *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t
+wymix(uint64_t a, uint64_t b)
+{
+	wymum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t
+wyr4(const uint8_t *p)
+{
+	return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24);
+}
+
+static inline uint64_t
+wyr8(const uint8_t *p)
+{
+	return wyr4(p) | (wyr4(p + 4) << 32);
+}
+
+static inline uint64_t
+wyr3(const uint8_t *p, uint64_t k)
+{
+	return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint64_t
+hash_bytes_seeded(const void *key, uint64_t len, uint64_t seed)
+{
+	static const uint64_t secret[4]
+		= { 0x2d358dccaa6c78a5u, 0x8bb84b93962eacc9u, 0x4b33a62ed433d4a3u, 0x4d5a2da51de1aa47u };
+	const uint8_t *p = key;
+	uint64_t a, b;
+
+	seed ^= wymix(seed ^ secret[0], secret[1]);
+
+	if (len <= 16) {
+		if (len >= 4) {
+			a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+			b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = wyr3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		uint64_t i = len;
+		if (i >= 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = wymix(wyr8(p) ^ secret[1], wyr8(p + 8) ^ seed);
+				see1 = wymix(wyr8(p + 16) ^ secret[2], wyr8(p + 24) ^ see1);
+				see2 = wymix(wyr8(p + 32) ^ secret[3], wyr8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i >= 48);
+			seed ^= see1 ^ see2;
+		}
+
+		while (i > 16) {
+			seed = wymix(wyr8(p) ^ secret[1], wyr8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+
+		a = wyr8(p + i - 16);
+		b = wyr8(p + i - 8);
+	}
+
+	a ^= secret[1];
+	b ^= seed;
+	wymum(&a, &b);
+	return wymix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+uint64_t
+hash_bytes(const void *buf, uint64_t len)
+{
+	return hash_bytes_seeded(buf, len, 0);
+}
@@ -14,22 +14,31 @@ struct embedded_file {
 	const char *name, *src;
 };
 
+/*
+ * embedded_files.h is generated by tools/embedder.c, which also picks a seed
+ * for embedded_hash under which every file name maps to its own slot in
+ * embedded_slots.  Slots hold the index + 1 of the file, or 0 if empty.
+ */
 #ifdef MUON_BOOTSTRAPPED
 #include "embedded_files.h"
 #else
 static struct embedded_file embedded[] = { 0 };
 static uint32_t embedded_len = 0;
+static const uint32_t embedded_seed = 0;
+static const uint8_t embedded_slots[1] = { 0 };
 #endif
 
 const char *
 embedded_get(const char *name)
 {
-	uint32_t i;
-	for (i = 0; i < embedded_len; ++i) {
-		if (strcmp(embedded[i].name, name) == 0) {
-			return embedded[i].src;
-		}
+	if (!embedded_len) {
+		return NULL;
+	}
+
+	uint8_t slot = embedded_slots[embedded_hash(name, embedded_seed) & (sizeof(embedded_slots) - 1)];
+	if (!slot || strcmp(embedded[slot - 1].name, name) != 0) {
+		return NULL;
 	}
 
-	return NULL;
+	return embedded[slot - 1].src;
 }
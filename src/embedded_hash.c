@@ -0,0 +1,21 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+
+#include "datastructures/hash.h"
+#include "embedded.h"
+
+/*
+ * Kept separate from embedded.c so that tools/embedder.c can link against it
+ * without the generated embedded_files.h.
+ */
+uint32_t
+embedded_hash(const char *name, uint32_t seed)
+{
+	return (uint32_t)hash_bytes_seeded(name, strlen(name), seed);
+}
@@ -43,102 +43,154 @@ muon_curl_deinit(void)
 	fetch_ctx.init = false;
 }
 
-struct write_data_ctx {
-	uint8_t *buf;
-	uint64_t len, cap;
-};
-
 static size_t
 write_data(void *src, size_t size, size_t nmemb, void *_ctx)
 {
-	struct write_data_ctx *ctx = _ctx;
-	uint64_t want_to_write = size * nmemb;
+	struct muon_curl_fetch_req *req = _ctx;
 
-	if (want_to_write + ctx->len > ctx->cap) {
-		ctx->cap = want_to_write + ctx->len;
-		ctx->buf = z_realloc(ctx->buf, ctx->cap);
+	if (!req->write(req->ctx, src, size * nmemb)) {
+		// returning anything other than the number of bytes given
+		// aborts the transfer
+		return 0;
 	}
 
-	memcpy(&ctx->buf[ctx->len], src, want_to_write);
-	ctx->len += want_to_write;
-
-	return nmemb;
+	return nmemb * size;
 }
 
-bool
-muon_curl_fetch(const char *url, uint8_t **buf, uint64_t *len)
+static CURL *
+fetch_handle_init(struct muon_curl_fetch_req *req)
 {
 	CURL *curl_handle;
 	CURLcode err;
-	char errbuf[CURL_ERROR_SIZE] = { 0 };
 
-	LOG_I("fetching '%s'", url);
-
-	if (!fetch_ctx.init) {
-		LOG_E("curl is not initialized");
-		goto err0;
-	}
+	LOG_I("fetching '%s'", req->url);
 
 	if (!(curl_handle = curl_easy_init())) {
 		LOG_E("failed to get curl handle");
-		goto err0;
-	}
-
-	if ((err = curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, errbuf)) != CURLE_OK) {
-		goto err1;
+		return NULL;
 	}
 
-	if ((err = curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1) != CURLE_OK)) {
-		goto err1;
+	if ((err = curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1L)) != CURLE_OK
+		|| (err = curl_easy_setopt(curl_handle, CURLOPT_URL, req->url)) != CURLE_OK
+		|| (err = curl_easy_setopt(curl_handle, CURLOPT_VERBOSE, 0L)) != CURLE_OK
+		|| (err = curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L)) != CURLE_OK
+		|| (err = curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_data)) != CURLE_OK
+		|| (err = curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, req)) != CURLE_OK
+		|| (err = curl_easy_setopt(curl_handle, CURLOPT_PRIVATE, req)) != CURLE_OK) {
+		LOG_E("curl failed to setup fetch of '%s': %s", req->url, curl_easy_strerror(err));
+		curl_easy_cleanup(curl_handle);
+		return NULL;
 	}
 
-	/* set URL to get here */
-	if ((err = curl_easy_setopt(curl_handle, CURLOPT_URL, url)) != CURLE_OK) {
-		goto err1;
-	}
+	return curl_handle;
+}
 
-	/* Switch on full protocol/debug output while testing */
-	if ((err = curl_easy_setopt(curl_handle, CURLOPT_VERBOSE, 0L)) != CURLE_OK) {
-		goto err1;
-	}
+/*
+ * Fetches all reqs, running up to jobs transfers at the same time.  Each
+ * request's done callback is called as soon as its transfer completes, while
+ * the remaining transfers are still in progress.  If the multi handle fails,
+ * the transfers in progress are aborted, and they and the requests that were
+ * never started are failed.
+ */
+bool
+muon_curl_fetch_all(struct muon_curl_fetch_req *reqs, uint32_t len, uint32_t jobs)
+{
+	CURLM *multi;
+	CURLMcode merr;
+	uint32_t i, next = 0, running = 0;
+	bool ok = true;
 
-	/* disable progress meter, set to 0L to enable it */
-	if ((err = curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L)) != CURLE_OK) {
-		goto err1;
+	if (!fetch_ctx.init) {
+		LOG_E("curl is not initialized");
+		return false;
 	}
 
-	/* send all data to this function  */
-	if ((err = curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_data)) != CURLE_OK) {
-		goto err1;
+	if (!(multi = curl_multi_init())) {
+		LOG_E("failed to get curl multi handle");
+		for (i = 0; i < len; ++i) {
+			reqs[i].done(reqs[i].ctx, false);
+		}
+		return false;
 	}
 
-	struct write_data_ctx ctx = { 0 };
-	/* write the page body to this file handle */
-	if ((err = curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &ctx)) != CURLE_OK) {
-		goto err1;
+	// the easy handle of each request while its transfer is in progress
+	CURL **handles = z_calloc(len, sizeof(CURL *));
+
+	while (next < len || running) {
+		while (next < len && running < jobs) {
+			struct muon_curl_fetch_req *req = &reqs[next];
+			++next;
+
+			CURL *curl_handle;
+			if (!(curl_handle = fetch_handle_init(req))) {
+				req->done(req->ctx, false);
+				ok = false;
+				continue;
+			}
+
+			if ((merr = curl_multi_add_handle(multi, curl_handle)) != CURLM_OK) {
+				LOG_E("curl failed to fetch '%s': %s", req->url, curl_multi_strerror(merr));
+				curl_easy_cleanup(curl_handle);
+				req->done(req->ctx, false);
+				ok = false;
+				continue;
+			}
+
+			handles[next - 1] = curl_handle;
+			++running;
+		}
+
+		int still_running;
+		if ((merr = curl_multi_perform(multi, &still_running)) != CURLM_OK) {
+			LOG_E("curl failed: %s", curl_multi_strerror(merr));
+			ok = false;
+			break;
+		}
+
+		CURLMsg *msg;
+		int msgs_left;
+		while ((msg = curl_multi_info_read(multi, &msgs_left))) {
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+
+			struct muon_curl_fetch_req *req;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+
+			bool req_ok = msg->data.result == CURLE_OK;
+			if (!req_ok) {
+				LOG_E("curl failed to fetch '%s': %s", req->url, curl_easy_strerror(msg->data.result));
+				ok = false;
+			}
+
+			curl_multi_remove_handle(multi, msg->easy_handle);
+			curl_easy_cleanup(msg->easy_handle);
+			handles[req - reqs] = NULL;
+			--running;
+
+			req->done(req->ctx, req_ok);
+		}
+
+		if (running && (merr = curl_multi_wait(multi, NULL, 0, 100, NULL)) != CURLM_OK) {
+			LOG_E("curl failed: %s", curl_multi_strerror(merr));
+			ok = false;
+			break;
+		}
 	}
 
-	/* get it! */
-	if ((err = curl_easy_perform(curl_handle)) != CURLE_OK) {
-		goto err1;
+	if (!ok) {
+		for (i = 0; i < len; ++i) {
+			if (handles[i]) {
+				curl_multi_remove_handle(multi, handles[i]);
+				curl_easy_cleanup(handles[i]);
+				reqs[i].done(reqs[i].ctx, false);
+			} else if (i >= next) {
+				reqs[i].done(reqs[i].ctx, false);
+			}
+		}
 	}
 
-	*buf = ctx.buf;
-	*len = ctx.len;
-
-	/* cleanup curl stuff */
-	curl_easy_cleanup(curl_handle);
-	return true;
-
-err1:
-	if (*errbuf) {
-		LOG_E("curl failed to fetch '%s': %s", url, errbuf);
-	} else if (err != CURLE_OK) {
-		LOG_E("curl failed to fetch '%s': %s", url, curl_easy_strerror(err));
-	} else {
-		LOG_E("curl failed to fetch '%s'", url);
-	}
-	curl_easy_cleanup(curl_handle);
-err0:
-	return false;
+	z_free(handles);
+	curl_multi_cleanup(multi);
+	return ok;
 }
@@ -21,7 +21,7 @@ muon_curl_deinit(void)
 }
 
 bool
-muon_curl_fetch(const char *url, uint8_t **buf, uint64_t *len)
+muon_curl_fetch_all(struct muon_curl_fetch_req *reqs, uint32_t len, uint32_t jobs)
 {
 	LOG_W("libcurl not enabled");
 	return false;
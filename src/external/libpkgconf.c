@@ -11,9 +11,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "backend/output.h"
 #include "buf_size.h"
+#include "configure_cache.h"
 #include "external/libpkgconf.h"
 #include "lang/object.h"
+#include "lang/object_iterators.h"
 #include "lang/workspace.h"
 #include "log.h"
 #include "options.h"
@@ -27,6 +30,14 @@ static struct {
 	pkgconf_cross_personality_t *personality;
 	const int maxdepth;
 	bool init;
+	// set once define_variable has added global tuples to the client.
+	// Lookup results are not cached after this point since they may
+	// depend on the defined variables.
+	bool have_defines;
+	struct workspace *cache_wk; // the workspace the objects below belong to
+	obj cache; // dict, see pkgconf_cache_init
+	obj available; // dict[str -> bool], .pc files found on the search path
+	obj lib_exists; // dict[str -> bool], memoized checks for find_lib_path
 } pkgconf_ctx = {
 	.maxdepth = 200,
 };
@@ -44,6 +55,263 @@ error_handler(const char *msg, const pkgconf_client_t *client, const void *data)
 	return true;
 }
 
+/*
+ * The pkgconf cache lives for the duration of a configure and, if
+ * muon.configure_cache is enabled, is persisted to the private dir so that
+ * later configures can skip re-reading .pc files that haven't changed.  It is
+ * a dict with the following keys:
+ *
+ * - search_path: the search path the cache was built for.  If it changes, the
+ *   whole cache is discarded.
+ * - dirs: dict[dir -> [files, [name]]], the .pc files present in each search
+ *   directory.  A directory is only rescanned when it changes.  This
+ *   lets lookups for packages that aren't installed fail without asking
+ *   libpkgconf to probe every directory.
+ * - pkgs: dict[key -> [result, files]], the result of each lookup.  files
+ *   records every .pc file, library, and library directory that went into
+ *   the result.  An entry is dropped when any of them change.
+ *
+ * files are tracked with configure_cache_record.
+ *
+ * Parsed packages themselves are kept in the libpkgconf client's own package
+ * cache, which lives as long as the client does.
+ */
+
+enum pkgconf_cache_result {
+	pkgconf_cache_result_version,
+	pkgconf_cache_result_compile_args,
+	pkgconf_cache_result_link_args,
+	pkgconf_cache_result_includes,
+	pkgconf_cache_result_libs,
+	pkgconf_cache_result_not_found_libs,
+};
+
+static obj
+pkgconf_cache_search_path(struct workspace *wk)
+{
+	SBUF(buf);
+	pkgconf_node_t *n;
+
+	PKGCONF_FOREACH_LIST_ENTRY(pkgconf_ctx.client.dir_list.head, n)
+	{
+		const pkgconf_path_t *p = n->data;
+		sbuf_pushs(wk, &buf, p->path);
+		sbuf_push(wk, &buf, '\n');
+	}
+
+	return sbuf_into_str(wk, &buf);
+}
+
+struct pkgconf_cache_scan_dir_ctx {
+	struct workspace *wk;
+	obj names;
+};
+
+static enum iteration_result
+pkgconf_cache_scan_dir_iter(void *_ctx, const char *path)
+{
+	struct pkgconf_cache_scan_dir_ctx *ctx = _ctx;
+	const struct str name = WKSTR(path);
+
+	if (str_endswith(&name, &WKSTR(".pc"))) {
+		obj_array_push(ctx->wk, ctx->names, make_strn(ctx->wk, name.s, name.len - 3));
+	}
+
+	return ir_cont;
+}
+
+static void
+pkgconf_cache_scan_dirs(struct workspace *wk)
+{
+	obj dirs, new_dirs;
+	obj_dict_index_str(wk, pkgconf_ctx.cache, "dirs", &dirs);
+	make_obj(wk, &new_dirs, obj_dict);
+	make_obj(wk, &pkgconf_ctx.available, obj_dict);
+
+	pkgconf_node_t *n;
+	PKGCONF_FOREACH_LIST_ENTRY(pkgconf_ctx.client.dir_list.head, n)
+	{
+		const pkgconf_path_t *p = n->data;
+		if (!fs_dir_exists(p->path)) {
+			continue;
+		}
+
+		obj dir = make_str(wk, p->path), entry, files, names = 0;
+
+		if (obj_dict_index(wk, dirs, dir, &entry)) {
+			obj_array_index(wk, entry, 0, &files);
+			if (!configure_cache_files_changed(wk, files)) {
+				obj_array_index(wk, entry, 1, &names);
+			}
+		}
+
+		if (!names) {
+			make_obj(wk, &files, obj_dict);
+			configure_cache_record(wk, files, p->path);
+
+			make_obj(wk, &names, obj_array);
+			struct pkgconf_cache_scan_dir_ctx ctx = { .wk = wk, .names = names };
+			if (!fs_dir_foreach(p->path, &ctx, pkgconf_cache_scan_dir_iter)) {
+				continue;
+			}
+
+			make_obj(wk, &entry, obj_array);
+			obj_array_push(wk, entry, files);
+			obj_array_push(wk, entry, names);
+		}
+
+		obj_dict_set(wk, new_dirs, dir, entry);
+
+		obj name;
+		obj_array_for(wk, names, name) {
+			obj_dict_set(wk, pkgconf_ctx.available, name, obj_bool_true);
+		}
+	}
+
+	obj_dict_set(wk, pkgconf_ctx.cache, make_str(wk, "dirs"), new_dirs);
+}
+
+static obj
+pkgconf_cache_load(struct workspace *wk, obj search_path)
+{
+	obj cache, cached_search_path, pkgs, fresh_pkgs;
+	if (!configure_cache_load(wk, output_path.pkgconf_cache, &cache)
+		|| !obj_dict_index_str(wk, cache, "search_path", &cached_search_path)
+		|| !obj_equal(wk, cached_search_path, search_path)
+		|| !obj_dict_index_str(wk, cache, "pkgs", &pkgs)) {
+		return 0;
+	}
+
+	make_obj(wk, &fresh_pkgs, obj_dict);
+
+	obj key, entry;
+	obj_dict_for(wk, pkgs, key, entry) {
+		obj files;
+		obj_array_index(wk, entry, 1, &files);
+		if (!configure_cache_files_changed(wk, files)) {
+			obj_dict_set(wk, fresh_pkgs, key, entry);
+		}
+	}
+
+	obj_dict_set(wk, cache, make_str(wk, "pkgs"), fresh_pkgs);
+	return cache;
+}
+
+static void
+pkgconf_cache_init(struct workspace *wk)
+{
+	obj search_path = pkgconf_cache_search_path(wk);
+	bool persist = configure_cache_enabled(wk);
+
+	if (!persist || !(pkgconf_ctx.cache = pkgconf_cache_load(wk, search_path))) {
+		obj dirs, pkgs;
+		make_obj(wk, &dirs, obj_dict);
+		make_obj(wk, &pkgs, obj_dict);
+
+		make_obj(wk, &pkgconf_ctx.cache, obj_dict);
+		obj_dict_set(wk, pkgconf_ctx.cache, make_str(wk, "search_path"), search_path);
+		obj_dict_set(wk, pkgconf_ctx.cache, make_str(wk, "dirs"), dirs);
+		obj_dict_set(wk, pkgconf_ctx.cache, make_str(wk, "pkgs"), pkgs);
+	}
+
+	make_obj(wk, &pkgconf_ctx.lib_exists, obj_dict);
+	pkgconf_cache_scan_dirs(wk);
+	pkgconf_ctx.cache_wk = wk;
+
+	if (persist) {
+		wk->pkgconf_cache = pkgconf_ctx.cache;
+	}
+}
+
+static bool
+pkgconf_cache_maybe_available(struct workspace *wk, obj name)
+{
+	const struct str *s = get_str(wk, name);
+
+	// Let libpkgconf handle paths and its builtin virtual packages
+	if (str_endswith(s, &WKSTR(".pc")) || memchr(s->s, '/', s->len) || str_eql(s, &WKSTR("pkg-config"))
+		|| str_eql(s, &WKSTR("pkgconf"))) {
+		return true;
+	}
+
+	return obj_dict_in(wk, pkgconf_ctx.available, name)
+	       || obj_dict_in(wk, pkgconf_ctx.available, make_strf(wk, "%s-uninstalled", s->s));
+}
+
+static void
+pkgconf_cache_get(struct workspace *wk, obj entry, struct pkgconf_info *info)
+{
+	obj result, v, path;
+	obj_array_index(wk, entry, 0, &result);
+
+	obj_array_index(wk, result, pkgconf_cache_result_version, &v);
+	strncpy(info->version, get_cstr(wk, v), MAX_VERSION_LEN);
+
+	obj_array_index(wk, result, pkgconf_cache_result_compile_args, &v);
+	obj_array_dup(wk, v, &info->compile_args);
+	obj_array_index(wk, result, pkgconf_cache_result_link_args, &v);
+	obj_array_dup(wk, v, &info->link_args);
+	obj_array_index(wk, result, pkgconf_cache_result_libs, &v);
+	obj_array_dup(wk, v, &info->libs);
+	obj_array_index(wk, result, pkgconf_cache_result_not_found_libs, &v);
+	obj_array_dup(wk, v, &info->not_found_libs);
+
+	make_obj(wk, &info->includes, obj_array);
+	obj_array_index(wk, result, pkgconf_cache_result_includes, &v);
+	obj_array_for(wk, v, path) {
+		obj inc;
+		make_obj(wk, &inc, obj_include_directory);
+		struct obj_include_directory *o = get_obj_include_directory(wk, inc);
+		o->path = path;
+		o->is_system = false;
+		obj_array_push(wk, info->includes, inc);
+	}
+}
+
+static void
+pkgconf_cache_set(struct workspace *wk, obj key, const struct pkgconf_info *info, obj files)
+{
+	obj result, v, inc, pkgs, entry;
+	make_obj(wk, &result, obj_array);
+
+	obj_array_push(wk, result, make_str(wk, info->version));
+	obj_array_dup(wk, info->compile_args, &v);
+	obj_array_push(wk, result, v);
+	obj_array_dup(wk, info->link_args, &v);
+	obj_array_push(wk, result, v);
+
+	make_obj(wk, &v, obj_array);
+	obj_array_for(wk, info->includes, inc) {
+		obj_array_push(wk, v, get_obj_include_directory(wk, inc)->path);
+	}
+	obj_array_push(wk, result, v);
+
+	obj_array_dup(wk, info->libs, &v);
+	obj_array_push(wk, result, v);
+	obj_array_dup(wk, info->not_found_libs, &v);
+	obj_array_push(wk, result, v);
+
+	make_obj(wk, &entry, obj_array);
+	obj_array_push(wk, entry, result);
+	obj_array_push(wk, entry, files);
+
+	obj_dict_index_str(wk, pkgconf_ctx.cache, "pkgs", &pkgs);
+	obj_dict_set(wk, pkgs, key, entry);
+}
+
+static bool
+pkgconf_cache_lib_exists(struct workspace *wk, const char *path)
+{
+	obj res;
+	if (obj_dict_index_str(wk, pkgconf_ctx.lib_exists, path, &res)) {
+		return get_obj_bool(wk, res);
+	}
+
+	bool exists = fs_file_exists(path);
+	obj_dict_set(wk, pkgconf_ctx.lib_exists, make_str(wk, path), exists ? obj_bool_true : obj_bool_false);
+	return exists;
+}
+
 static bool
 muon_pkgconf_init(struct workspace *wk)
 {
@@ -118,6 +386,7 @@ struct pkgconf_lookup_ctx {
 	struct pkgconf_info *info;
 	obj libdirs;
 	obj name;
+	obj files; // dict, inputs to the result, see pkgconf_cache_init
 	bool is_static;
 };
 
@@ -158,7 +427,7 @@ check_lib_path(struct workspace *wk, struct find_lib_path_ctx *ctx, const char *
 
 		path_join(wk, ctx->buf, lib_path, ctx->name_buf->buf);
 
-		if (fs_file_exists(ctx->buf->buf)) {
+		if (pkgconf_cache_lib_exists(wk, ctx->buf->buf)) {
 			ctx->found = true;
 			return true;
 		}
@@ -233,6 +502,7 @@ apply_and_collect(pkgconf_client_t *client, pkgconf_pkg_t *world, void *_ctx, in
 		case 'L':
 			str = make_str(ctx->wk, frag->data);
 			obj_array_push(ctx->wk, ctx->libdirs, str);
+			configure_cache_record(ctx->wk, ctx->files, frag->data);
 			break;
 		case 'l': {
 			obj path;
@@ -244,11 +514,15 @@ apply_and_collect(pkgconf_client_t *client, pkgconf_pkg_t *world, void *_ctx, in
 
 					obj_array_push(ctx->wk, ctx->info->libs, path);
 				}
+				configure_cache_record(ctx->wk, ctx->files, get_cstr(ctx->wk, path));
 			} else {
 				LOG_W("library '%s' not found for dependency '%s'",
 					frag->data,
 					get_cstr(ctx->wk, ctx->name));
 				obj_array_push(ctx->wk, ctx->info->not_found_libs, make_str(ctx->wk, frag->data));
+				// The library may show up later in any of the
+				// library directories, so don't cache this result.
+				ctx->files = 0;
 			}
 			break;
 		}
@@ -269,6 +543,37 @@ ret:
 	return ret;
 }
 
+static bool
+collect_pkg_files(struct pkgconf_lookup_ctx *ctx, const pkgconf_pkg_t *pkg, int depth)
+{
+	if (!pkg || depth > pkgconf_ctx.maxdepth) {
+		return false;
+	}
+
+	if (pkg->filename) {
+		if (obj_dict_in(ctx->wk, ctx->files, make_str(ctx->wk, pkg->filename))) {
+			return true;
+		}
+
+		configure_cache_record(ctx->wk, ctx->files, pkg->filename);
+	}
+
+	const pkgconf_list_t *lists[] = { &pkg->required, &pkg->requires_private };
+	pkgconf_node_t *node;
+	uint32_t i;
+	for (i = 0; i < ARRAY_LEN(lists); ++i) {
+		PKGCONF_FOREACH_LIST_ENTRY(lists[i]->head, node)
+		{
+			const pkgconf_dependency_t *dep = node->data;
+			if (!collect_pkg_files(ctx, dep->match, depth + 1)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 static bool
 apply_modversion(pkgconf_client_t *client, pkgconf_pkg_t *world, void *_ctx, int maxdepth)
 {
@@ -280,6 +585,12 @@ apply_modversion(pkgconf_client_t *client, pkgconf_pkg_t *world, void *_ctx, int
 		strncpy(ctx->info->version, pkg->version, MAX_VERSION_LEN);
 	}
 
+	// If any package in the graph was left unresolved we can't know which
+	// files the result depends on, so skip caching it.
+	if (ctx->files && !collect_pkg_files(ctx, pkg, 0)) {
+		ctx->files = 0;
+	}
+
 	return true;
 }
 
@@ -293,6 +604,7 @@ muon_pkgconf_define(struct workspace *wk, const char *key, const char *value)
 	}
 
 	pkgconf_tuple_add_global(&pkgconf_ctx.client, key, value);
+	pkgconf_ctx.have_defines = true;
 
 	return true;
 }
@@ -306,6 +618,26 @@ muon_pkgconf_lookup(struct workspace *wk, obj name, bool is_static, struct pkgco
 		}
 	}
 
+	if (pkgconf_ctx.cache_wk != wk) {
+		pkgconf_cache_init(wk);
+	}
+
+	obj cache_key = 0;
+	if (!pkgconf_ctx.have_defines) {
+		obj pkgs, entry;
+		cache_key = make_strf(wk, "%s%s", get_cstr(wk, name), is_static ? ":static" : "");
+		obj_dict_index_str(wk, pkgconf_ctx.cache, "pkgs", &pkgs);
+
+		if (obj_dict_index(wk, pkgs, cache_key, &entry)) {
+			L("pkgconf: using cached result for '%s'", get_cstr(wk, cache_key));
+			pkgconf_cache_get(wk, entry, info);
+			return true;
+		} else if (!pkgconf_cache_maybe_available(wk, name)) {
+			L("pkgconf: no .pc file for '%s' on the search path", get_cstr(wk, name));
+			return false;
+		}
+	}
+
 	int flags = 0;
 
 #ifdef _WIN32
@@ -323,6 +655,9 @@ muon_pkgconf_lookup(struct workspace *wk, obj name, bool is_static, struct pkgco
 	pkgconf_queue_push(&pkgq, get_cstr(wk, name));
 
 	struct pkgconf_lookup_ctx ctx = { .wk = wk, .info = info, .name = name, .is_static = is_static };
+	if (cache_key) {
+		make_obj(wk, &ctx.files, obj_dict);
+	}
 
 	if (!pkgconf_queue_apply(&pkgconf_ctx.client, &pkgq, apply_modversion, pkgconf_ctx.maxdepth, &ctx)) {
 		ret = false;
@@ -354,6 +689,10 @@ muon_pkgconf_lookup(struct workspace *wk, obj name, bool is_static, struct pkgco
 
 	pkgconf_client_set_flags(&pkgconf_ctx.client, flags);
 
+	if (ctx.files) {
+		pkgconf_cache_set(wk, cache_key, info, ctx.files);
+	}
+
 ret:
 	pkgconf_queue_free(&pkgq);
 	return ret;
@@ -17,8 +17,7 @@ func_array_length(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_number);
-	set_obj_number(wk, *res, get_obj_array(wk, self)->len);
+	*res = make_number(wk, get_obj_array(wk, self)->len);
 	return true;
 }
 
@@ -82,8 +81,7 @@ func_array_contains(struct workspace *wk, obj self, obj *res)
 	struct array_contains_ctx ctx = { .item = an[0].val };
 	obj_array_foreach(wk, self, &ctx, array_contains_iter);
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ctx.found);
+	*res = make_obj_bool(wk, ctx.found);
 	return true;
 }
 
@@ -37,8 +37,7 @@ func_boolean_to_int(struct workspace *wk, obj self, obj *res)
 	}
 
 	int32_t val = get_obj_bool(wk, self) ? 1 : 0;
-	make_obj(wk, res, obj_number);
-	set_obj_number(wk, *res, val);
+	*res = make_number(wk, val);
 	return true;
 }
 
@@ -14,8 +14,10 @@
 #include "functions/build_target.h"
 #include "functions/generator.h"
 #include "lang/func_lookup.h"
+#include "lang/object_iterators.h"
 #include "lang/typecheck.h"
 #include "log.h"
+#include "options.h"
 #include "platform/path.h"
 
 bool
@@ -83,6 +85,75 @@ tgt_src_to_object_path(struct workspace *wk,
 	return true;
 }
 
+/*
+ * Returns the files that are compiled for tgt.  These are normally just the
+ * target's sources, but in unity builds C and C++ sources are compiled in
+ * batches of unity_size through <name>-unity<N>.c/.cpp files in the target's
+ * private dir, which include the sources of their batch and take the place of
+ * the first of them.  Generated sources are always compiled on their own.
+ *
+ * unity_sources is set to a dict[unity file path -> list of sources], or 0 if
+ * tgt isn't a unity build.
+ */
+void
+build_target_compile_units(struct workspace *wk,
+	const struct project *proj,
+	const struct obj_build_target *tgt,
+	obj *units,
+	obj *unity_sources)
+{
+	uint32_t unity_size;
+	if (!get_option_unity(wk, proj, tgt->override_options, &unity_size)) {
+		*units = tgt->src;
+		*unity_sources = 0;
+		return;
+	}
+
+	make_obj(wk, units, obj_array);
+	make_obj(wk, unity_sources, obj_dict);
+
+	struct {
+		obj srcs;
+		uint32_t n;
+	} batches[compiler_language_count] = { 0 };
+
+	obj src;
+	obj_array_for(wk, tgt->src, src) {
+		const char *src_path = get_file_path(wk, src);
+		enum compiler_language lang;
+		if (!filename_to_compiler_language(src_path, &lang)
+			|| !(lang == compiler_language_c || lang == compiler_language_cpp)
+			|| path_is_subpath(wk->build_root, src_path)) {
+			obj_array_push(wk, *units, src);
+			continue;
+		}
+
+		if (!batches[lang].srcs || get_obj_array(wk, batches[lang].srcs)->len >= unity_size) {
+			SBUF(name);
+			sbuf_pushf(wk,
+				&name,
+				"%s-unity%d.%s",
+				get_cstr(wk, tgt->name),
+				batches[lang].n,
+				lang == compiler_language_cpp ? "cpp" : "c");
+			++batches[lang].n;
+
+			SBUF(path);
+			path_join(wk, &path, get_cstr(wk, tgt->private_path), name.buf);
+
+			obj unity_file;
+			make_obj(wk, &unity_file, obj_file);
+			*get_obj_file(wk, unity_file) = sbuf_into_str(wk, &path);
+			obj_array_push(wk, *units, unity_file);
+
+			make_obj(wk, &batches[lang].srcs, obj_array);
+			obj_dict_set(wk, *unity_sources, *get_obj_file(wk, unity_file), batches[lang].srcs);
+		}
+
+		obj_array_push(wk, batches[lang].srcs, src);
+	}
+}
+
 static bool
 func_build_target_name(struct workspace *wk, obj self, obj *res)
 {
@@ -111,6 +182,7 @@ struct build_target_extract_objects_ctx {
 	uint32_t err_node;
 	struct obj_build_target *tgt;
 	obj tgt_id;
+	obj units;
 	obj *res;
 };
 
@@ -176,7 +248,7 @@ build_target_extract_objects_iter(struct workspace *wk, void *_ctx, obj val)
 	case compiler_language_count: UNREACHABLE;
 	}
 
-	if (!obj_array_in(wk, ctx->tgt->src, file)) {
+	if (!obj_array_in(wk, ctx->units, file)) {
 		vm_error_at(wk, ctx->err_node, "%o is not in target sources (%o)", file, ctx->tgt->src);
 		return ir_err;
 	}
@@ -205,6 +277,16 @@ build_target_extract_objects(struct workspace *wk, obj self, uint32_t err_node,
 		.tgt_id = self,
 	};
 
+	uint32_t unity_size;
+	if (get_option_unity(wk, current_project(wk), ctx.tgt->override_options, &unity_size)) {
+		vm_error_at(wk,
+			err_node,
+			"single object files cannot be extracted in unity builds, use extract_all_objects() instead");
+		return false;
+	}
+
+	ctx.units = ctx.tgt->src;
+
 	return obj_array_foreach_flat(wk, arr, &ctx, build_target_extract_objects_iter);
 }
 
@@ -239,7 +321,10 @@ build_target_extract_all_objects(struct workspace *wk, uint32_t ip, obj self, ob
 		.tgt_id = self,
 	};
 
-	if (!obj_array_foreach_flat(wk, ctx.tgt->src, &ctx, build_target_extract_all_objects_iter)) {
+	obj unity_sources;
+	build_target_compile_units(wk, current_project(wk), ctx.tgt, &ctx.units, &unity_sources);
+
+	if (!obj_array_foreach_flat(wk, ctx.units, &ctx, build_target_extract_all_objects_iter)) {
 		return false;
 	}
 
@@ -287,8 +372,7 @@ func_build_target_found(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, true);
+	*res = make_obj_bool(wk, true);
 	return true;
 }
 
@@ -27,6 +27,7 @@
 #include "platform/filesystem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "profile.h"
 #include "sha_256.h"
 
 enum compile_mode {
@@ -202,14 +203,12 @@ set_compiler_cache(struct workspace *wk, obj key, bool res, obj val)
 
 	obj arr, cache_res;
 	if (obj_dict_index(wk, wk->compiler_check_cache, key, &arr)) {
-		obj_array_index(wk, arr, 0, &cache_res);
-		set_obj_bool(wk, cache_res, res);
+		obj_array_set(wk, arr, 0, make_obj_bool(wk, res));
 		obj_array_set(wk, arr, 1, val);
 	} else {
 		make_obj(wk, &arr, obj_array);
 
-		make_obj(wk, &cache_res, obj_bool);
-		set_obj_bool(wk, cache_res, res);
+		cache_res = make_obj_bool(wk, res);
 
 		obj_array_push(wk, arr, cache_res);
 		obj_array_push(wk, arr, val);
@@ -236,6 +235,11 @@ compiler_check(struct workspace *wk, struct compiler_check_opts *opts, const cha
 	struct obj_compiler *comp = get_obj_compiler(wk, opts->comp_id);
 	/* enum compiler_type t = comp->type; */
 
+	// Everything up to the cache lookup and the compiler invocation is
+	// scratch.  Only the cache key and result need to outlive this check.
+	struct obj_clear_mark mk;
+	obj_set_clear_mark(wk, &mk);
+
 	obj compiler_args;
 	make_obj(wk, &compiler_args, obj_array);
 
@@ -266,6 +270,7 @@ compiler_check(struct workspace *wk, struct compiler_check_opts *opts, const cha
 	}
 
 	if (!add_include_directory_args(wk, opts->inc, have_dep ? &dep : NULL, opts->comp_id, compiler_args)) {
+		obj_clear(wk, &mk);
 		return false;
 	}
 
@@ -323,7 +328,7 @@ compiler_check(struct workspace *wk, struct compiler_check_opts *opts, const cha
 		obj_array_extend(wk, compiler_args, opts->args);
 	}
 
-	bool ret = false;
+	bool ret = false, store_res = false;
 	struct run_cmd_ctx cmd_ctx = { 0 };
 
 	const char *argstr;
@@ -333,16 +338,22 @@ compiler_check(struct workspace *wk, struct compiler_check_opts *opts, const cha
 	uint8_t sha[32];
 	if (compiler_check_cache(wk, comp, argstr, argc, src, sha, res, &opts->cache_val)) {
 		opts->from_cache = true;
+		if (wk->profile) {
+			profile_compiler_check(wk, true);
+		}
+		obj_clear(wk, &mk);
 		return true;
 	}
 
-	opts->cache_key = make_strn(wk, (const char *)sha, 32);
+	if (wk->profile) {
+		profile_compiler_check(wk, false);
+	}
 
 	if (!opts->src_is_path) {
 		L("compiling: '%s'", src);
 
 		if (!fs_write(get_cstr(wk, source_path), (const uint8_t *)src, strlen(src))) {
-			return false;
+			goto ret;
 		}
 	} else {
 		L("compiling: '%s'", get_cstr(wk, source_path));
@@ -385,11 +396,18 @@ compiler_check(struct workspace *wk, struct compiler_check_opts *opts, const cha
 
 	// store wether or not the check suceeded in the cache, the caller is
 	// responsible for storing the actual value
-	set_compiler_cache(wk, opts->cache_key, *res, 0);
+	store_res = true;
 
 	ret = true;
 ret:
 	run_cmd_ctx_destroy(&cmd_ctx);
+	obj_clear(wk, &mk);
+
+	opts->cache_key = make_strn(wk, (const char *)sha, 32);
+	if (store_res) {
+		set_compiler_cache(wk, opts->cache_key, *res, 0);
+	}
+
 	if (!*res && req == requirement_required) {
 		assert(opts->required);
 		vm_error_at(wk, opts->required->node, "a required compiler check failed");
@@ -556,13 +574,11 @@ func_compiler_sizeof(struct workspace *wk, obj self, obj *res)
 	bool ok;
 	if (compiler_check(wk, &opts, src, an[0].node, &ok) && ok) {
 		if (!opts.from_cache) {
-			make_obj(wk, res, obj_number);
-			set_obj_number(wk, *res, compiler_check_parse_output_int(&opts));
+			*res = make_number(wk, compiler_check_parse_output_int(&opts));
 		}
 	} else {
 		if (!opts.from_cache) {
-			make_obj(wk, res, obj_number);
-			set_obj_number(wk, *res, -1);
+			*res = make_number(wk, -1);
 		}
 	}
 
@@ -611,8 +627,7 @@ func_compiler_alignment(struct workspace *wk, obj self, obj *res)
 	if (opts.from_cache) {
 		*res = opts.cache_val;
 	} else {
-		make_obj(wk, res, obj_number);
-		set_obj_number(wk, *res, compiler_check_parse_output_int(&opts));
+		*res = make_number(wk, compiler_check_parse_output_int(&opts));
 		run_cmd_ctx_destroy(&opts.cmd_ctx);
 		set_compiler_cache(wk, opts.cache_key, true, *res);
 	}
@@ -660,8 +675,7 @@ func_compiler_compute_int(struct workspace *wk, obj self, obj *res)
 	if (opts.from_cache) {
 		*res = opts.cache_val;
 	} else {
-		make_obj(wk, res, obj_number);
-		set_obj_number(wk, *res, compiler_check_parse_output_int(&opts));
+		*res = make_number(wk, compiler_check_parse_output_int(&opts));
 		run_cmd_ctx_destroy(&opts.cmd_ctx);
 		set_compiler_cache(wk, opts.cache_key, true, *res);
 	}
@@ -811,8 +825,7 @@ func_compiler_has_function_attribute(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, has_fattr);
+	*res = make_obj_bool(wk, has_fattr);
 	return true;
 }
 
@@ -975,8 +988,7 @@ func_compiler_has_function(struct workspace *wk, obj self, obj *res)
 		}
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ok);
+	*res = make_obj_bool(wk, ok);
 
 	compiler_check_log(wk, &opts, "has function %s: %s", get_cstr(wk, an[0].val), bool_to_yn(ok));
 
@@ -1087,8 +1099,7 @@ func_compiler_has_header_symbol(struct workspace *wk, obj self, obj *res)
 	default: UNREACHABLE;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ok);
+	*res = make_obj_bool(wk, ok);
 
 	compiler_check_log(wk,
 		&opts,
@@ -1253,8 +1264,7 @@ func_compiler_symbols_have_underscore_prefix(struct workspace *wk, obj self, obj
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, str_eql(get_str(wk, pre), &WKSTR("_")));
+	*res = make_obj_bool(wk, str_eql(get_str(wk, pre), &WKSTR("_")));
 	return true;
 }
 
@@ -1294,8 +1304,7 @@ func_compiler_check_common(struct workspace *wk, obj self, obj *res, enum compil
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ok);
+	*res = make_obj_bool(wk, ok);
 
 	if (akw[cc_kw_name].set) {
 		const char *mode_s = NULL;
@@ -1353,8 +1362,7 @@ compiler_check_header(struct workspace *wk,
 	default: abort();
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ok);
+	*res = make_obj_bool(wk, ok);
 
 	compiler_check_log(wk, opts, "header %s %s: %s", hdr, mode_s, bool_to_yn(ok));
 
@@ -1426,8 +1434,7 @@ func_compiler_has_type(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ok);
+	*res = make_obj_bool(wk, ok);
 
 	compiler_check_log(wk, &opts, "has type %s: %s", get_cstr(wk, an[0].val), bool_to_yn(ok));
 
@@ -1488,8 +1495,7 @@ func_compiler_has_member(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ok);
+	*res = make_obj_bool(wk, ok);
 	return true;
 }
 
@@ -1556,8 +1562,7 @@ func_compiler_has_members(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ctx.ok);
+	*res = make_obj_bool(wk, ctx.ok);
 	return true;
 }
 
@@ -1699,8 +1704,7 @@ compiler_has_argument_common(struct workspace *wk, obj self, type_tag glob, obj
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, has_argument);
+	*res = make_obj_bool(wk, has_argument);
 	return true;
 }
 
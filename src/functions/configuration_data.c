@@ -88,8 +88,7 @@ func_configuration_data_set10(struct workspace *wk, obj self, obj *res)
 	obj dict = get_obj_configuration_data(wk, self)->dict;
 
 	obj n;
-	make_obj(wk, &n, obj_number);
-	set_obj_number(wk, n, get_obj_bool(wk, an[1].val) ? 1 : 0);
+	n = make_number(wk, get_obj_bool(wk, an[1].val) ? 1 : 0);
 	obj_dict_set(wk, dict, an[0].val, n);
 
 	return true;
@@ -184,8 +183,7 @@ func_configuration_data_has(struct workspace *wk, obj self, obj *res)
 	}
 
 	obj _, dict = get_obj_configuration_data(wk, self)->dict;
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, obj_dict_index(wk, dict, an[0].val, &_));
+	*res = make_obj_bool(wk, obj_dict_index(wk, dict, an[0].val, &_));
 	return true;
 }
 
@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 
+#include "configure_fingerprint.h"
 #include "error.h"
 #include "lang/func_lookup.h"
 #include "functions/environment.h"
@@ -36,7 +37,7 @@ evironment_to_dict_iter(struct workspace *wk, void *_ctx, obj action)
 	if (obj_dict_index(wk, env, key, &v)) {
 		oval = get_cstr(wk, v);
 	} else {
-		if (!(oval = getenv(get_cstr(wk, key)))) {
+		if (!(oval = configure_fingerprint_getenv(wk, get_cstr(wk, key)))) {
 			obj_dict_set(wk, env, key, val);
 			return ir_cont;
 		}
@@ -121,8 +122,7 @@ environment_set(struct workspace *wk, obj env, enum environment_set_mode mode, o
 	}
 
 	obj elem, mode_num;
-	make_obj(wk, &mode_num, obj_number);
-	set_obj_number(wk, mode_num, mode);
+	mode_num = make_number(wk, mode);
 	make_obj(wk, &elem, obj_array);
 	obj_array_push(wk, elem, mode_num);
 	obj_array_push(wk, elem, key);
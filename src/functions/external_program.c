@@ -5,18 +5,114 @@
 
 #include "compat.h"
 
+#include <stdlib.h>
+
 #include "args.h"
+#include "backend/output.h"
+#include "configure_cache.h"
 #include "lang/func_lookup.h"
 #include "functions/external_program.h"
 #include "guess.h"
+#include "lang/object_iterators.h"
 #include "lang/typecheck.h"
 #include "log.h"
+#include "platform/filesystem.h"
+#include "platform/path.h"
 #include "platform/run_cmd.h"
 
+/*
+ * Same as fs_find_cmd, but remembers results for the duration of the
+ * configure.  Results are keyed on the value of PATH, so they are invalidated
+ * if it changes.
+ */
+bool
+find_program_in_path(struct workspace *wk, struct sbuf *buf, const char *cmd)
+{
+	const char *env_path;
+	if (!path_is_basename(cmd) || !(env_path = getenv("PATH"))) {
+		return fs_find_cmd(wk, buf, cmd);
+	}
+
+	if (!wk->find_program_path_cache) {
+		make_obj(wk, &wk->find_program_path_cache, obj_dict);
+	}
+
+	obj key = make_strf(wk, "%s\n%s", env_path, cmd), cached;
+	if (obj_dict_index(wk, wk->find_program_path_cache, key, &cached)) {
+		if (cached == obj_bool_false) {
+			return false;
+		}
+
+		// guard against the program having been removed in the meantime
+		if (fs_exe_exists(get_cstr(wk, cached))) {
+			sbuf_clear(buf);
+			sbuf_pushs(wk, buf, get_cstr(wk, cached));
+			return true;
+		}
+	}
+
+	bool found = fs_find_cmd(wk, buf, cmd);
+	obj_dict_set(wk, wk->find_program_path_cache, key, found ? make_str(wk, buf->buf) : obj_bool_false);
+	return found;
+}
+
+/*
+ * The version cache maps a command line to the version it reported and the
+ * stamps of the executables involved, so that a version is only guessed again
+ * once one of them has been replaced.  It is persisted if
+ * muon.configure_cache is set.
+ */
+static obj
+find_program_version_cache(struct workspace *wk)
+{
+	if (wk->program_version_cache) {
+		return wk->program_version_cache;
+	}
+
+	obj cache, fresh, key, entry, files;
+	make_obj(wk, &fresh, obj_dict);
+
+	if (configure_cache_enabled(wk) && configure_cache_load(wk, output_path.program_version_cache, &cache)) {
+		obj_dict_for(wk, cache, key, entry) {
+			obj_array_index(wk, entry, 1, &files);
+			if (!configure_cache_files_changed(wk, files)) {
+				obj_dict_set(wk, fresh, key, entry);
+			}
+		}
+	}
+
+	return wk->program_version_cache = fresh;
+}
+
 void
 find_program_guess_version(struct workspace *wk, obj cmd_array, obj *ver)
 {
 	*ver = 0;
+
+	obj key = 0, files = 0, entry, arg;
+	obj_array_index(wk, cmd_array, 0, &arg);
+	if (path_is_absolute(get_cstr(wk, arg))) {
+		SBUF(buf);
+		make_obj(wk, &files, obj_dict);
+		obj_array_for(wk, cmd_array, arg) {
+			const char *s = get_cstr(wk, arg);
+			sbuf_pushs(wk, &buf, s);
+			sbuf_push(wk, &buf, '\n');
+
+			if (path_is_absolute(s)) {
+				configure_cache_record(wk, files, s);
+			}
+		}
+		key = sbuf_into_str(wk, &buf);
+
+		if (obj_dict_index(wk, find_program_version_cache(wk), key, &entry)) {
+			obj cached;
+			obj_array_index(wk, entry, 0, &cached);
+			*ver = cached == obj_bool_false ? 0 : cached;
+			return;
+		}
+	}
+
 	struct run_cmd_ctx cmd_ctx = { 0 };
 	obj args;
 	obj_array_dup(wk, cmd_array, &args);
@@ -33,6 +129,13 @@ find_program_guess_version(struct workspace *wk, obj cmd_array, obj *ver)
 	}
 
 	run_cmd_ctx_destroy(&cmd_ctx);
+
+	if (key) {
+		make_obj(wk, &entry, obj_array);
+		obj_array_push(wk, entry, *ver ? *ver : obj_bool_false);
+		obj_array_push(wk, entry, files);
+		obj_dict_set(wk, wk->program_version_cache, key, entry);
+	}
 }
 
 static bool
@@ -42,8 +145,7 @@ func_external_program_found(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, get_obj_external_program(wk, self)->found);
+	*res = make_obj_bool(wk, get_obj_external_program(wk, self)->found);
 	return true;
 }
 
@@ -12,6 +12,7 @@
 #include "args.h"
 #include "buf_size.h"
 #include "coerce.h"
+#include "configure_fingerprint.h"
 #include "error.h"
 #include "external/samurai.h"
 #include "functions/environment.h"
@@ -460,8 +461,7 @@ func_add_languages(struct workspace *wk, obj _, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, !ctx.missing);
+	*res = make_obj_bool(wk, !ctx.missing);
 	return true;
 }
 
@@ -674,7 +674,7 @@ find_program_step_4:
 	}
 
 	/* 6. PATH environment variable */
-	if (fs_find_cmd(wk, &buf, str)) {
+	if (find_program_in_path(wk, &buf, str)) {
 		path = buf.buf;
 		goto found;
 	}
@@ -1020,6 +1020,7 @@ func_run_command(struct workspace *wk, obj _, obj *res)
 
 	const char *argstr, *envstr;
 	uint32_t argc, envc;
+	obj args, env;
 
 	{
 		obj arg0;
@@ -1054,7 +1055,6 @@ func_run_command(struct workspace *wk, obj _, obj *res)
 			obj_array_set(wk, an[0].val, 0, cmd_file);
 		}
 
-		obj args;
 		if (!arr_to_args(wk, arr_to_args_external_program, an[0].val, &args)) {
 			return false;
 		}
@@ -1066,13 +1066,10 @@ func_run_command(struct workspace *wk, obj _, obj *res)
 		join_args_argstr(wk, &argstr, &argc, args);
 	}
 
-	{
-		obj env;
-		if (!coerce_environment_from_kwarg(wk, &akw[kw_env], true, &env)) {
-			return false;
-		}
-		env_to_envstr(wk, &envstr, &envc, env);
+	if (!coerce_environment_from_kwarg(wk, &akw[kw_env], true, &env)) {
+		return false;
 	}
+	env_to_envstr(wk, &envstr, &envc, env);
 
 	bool ret = false;
 	struct run_cmd_ctx cmd_ctx = { 0 };
@@ -1094,6 +1091,8 @@ func_run_command(struct workspace *wk, obj _, obj *res)
 		return false;
 	}
 
+	configure_fingerprint_run_command(wk, args, env, &cmd_ctx);
+
 	make_obj(wk, res, obj_run_result);
 	struct obj_run_result *run_result = get_obj_run_result(wk, *res);
 	run_result->status = cmd_ctx.status;
@@ -1701,8 +1700,7 @@ func_is_variable(struct workspace *wk, obj _, obj *res)
 
 	obj dont_care;
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, wk->vm.behavior.get_variable(wk, get_cstr(wk, an[0].val), &dont_care));
+	*res = make_obj_bool(wk, wk->vm.behavior.get_variable(wk, get_cstr(wk, an[0].val), &dont_care));
 	return true;
 }
 
@@ -62,8 +62,8 @@ enum build_target_kwargs {
 	bt_kw_override_options,
 
 	/* lang args */
-	bt_kw_c_pch, // TODO
-	bt_kw_cpp_pch, // TODO
+	bt_kw_c_pch,
+	bt_kw_cpp_pch,
 	bt_kw_c_args,
 	bt_kw_cpp_args,
 	bt_kw_objc_args,
@@ -747,6 +747,52 @@ create_target(struct workspace *wk,
 		}
 	}
 
+	{ // precompiled headers
+		static struct {
+			enum build_target_kwargs kw;
+			enum compiler_language l;
+		} lang_pch[] = {
+			{ bt_kw_c_pch, compiler_language_c },
+			{ bt_kw_cpp_pch, compiler_language_cpp },
+		};
+
+		uint32_t i;
+		for (i = 0; i < ARRAY_LEN(lang_pch); ++i) {
+			if (!akw[lang_pch[i].kw].set) {
+				continue;
+			}
+
+			uint32_t node = akw[lang_pch[i].kw].node;
+			obj files;
+			if (!coerce_files(wk, node, akw[lang_pch[i].kw].val, &files)) {
+				return false;
+			}
+
+			// An optional source file may follow the header.  It is only
+			// needed by msvc, and one is generated for it instead.
+			uint32_t len = get_obj_array(wk, files)->len;
+			if (len < 1 || len > 2) {
+				vm_error_at(wk, node, "expected a header and an optional source file, got %d files", len);
+				return false;
+			}
+
+			obj header;
+			obj_array_index(wk, files, 0, &header);
+			enum compiler_language l;
+			if (!filename_to_compiler_language(get_file_path(wk, header), &l)
+				|| !(l == compiler_language_c_hdr || l == compiler_language_cpp_hdr)) {
+				vm_error_at(wk, node, "the first precompiled header file must be a header");
+				return false;
+			}
+
+			if (!tgt->pch) {
+				make_obj(wk, &tgt->pch, obj_dict);
+			}
+
+			obj_dict_seti(wk, tgt->pch, lang_pch[i].l, header);
+		}
+	}
+
 	obj soname_install = 0, plain_name_install = 0;
 
 	// soname handling
@@ -925,8 +971,8 @@ tgt_common(struct workspace *wk, obj *res, enum tgt_type type, enum tgt_type arg
 		[bt_kw_win_subsystem] = { "win_subsystem", obj_string },
 		[bt_kw_override_options] = { "override_options", TYPE_TAG_LISTIFY | obj_string },
 		/* lang args */
-		[bt_kw_c_pch] = { "c_pch", tc_string | tc_file, },
-		[bt_kw_cpp_pch] = { "cpp_pch", tc_string | tc_file, },
+		[bt_kw_c_pch] = { "c_pch", TYPE_TAG_LISTIFY | tc_string | tc_file },
+		[bt_kw_cpp_pch] = { "cpp_pch", TYPE_TAG_LISTIFY | tc_string | tc_file },
 		[bt_kw_c_args] = { "c_args", TYPE_TAG_LISTIFY | obj_string },
 		[bt_kw_cpp_args] = { "cpp_args", TYPE_TAG_LISTIFY | obj_string },
 		[bt_kw_objc_args] = { "objc_args", TYPE_TAG_LISTIFY | obj_string },
@@ -977,8 +1023,7 @@ tgt_common(struct workspace *wk, obj *res, enum tgt_type type, enum tgt_type arg
 	}
 
 	if (type == (tgt_static_library | tgt_dynamic_library) && !akw[bt_kw_pic].set) {
-		make_obj(wk, &akw[bt_kw_pic].val, obj_bool);
-		set_obj_bool(wk, akw[bt_kw_pic].val, true);
+		akw[bt_kw_pic].val = make_obj_bool(wk, true);
 		akw[bt_kw_pic].set = true;
 	}
 
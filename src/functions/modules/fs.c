@@ -92,8 +92,7 @@ func_module_fs_lookup_common(struct workspace *wk, obj *res, fs_lookup_func look
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, lookup(path.buf));
+	*res = make_obj_bool(wk, lookup(path.buf));
 	return true;
 }
 
@@ -190,8 +189,7 @@ func_module_fs_is_absolute(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, path_is_absolute(get_cstr(wk, an[0].val)));
+	*res = make_obj_bool(wk, path_is_absolute(get_cstr(wk, an[0].val)));
 	return true;
 }
 
@@ -370,8 +368,7 @@ func_module_fs_size(struct workspace *wk, obj self, obj *res)
 	}
 
 	assert(size < INT64_MAX);
-	make_obj(wk, res, obj_number);
-	set_obj_number(wk, *res, size);
+	*res = make_number(wk, size);
 	return true;
 }
 
@@ -395,8 +392,7 @@ func_module_fs_is_samepath(struct workspace *wk, obj self, obj *res)
 
 	// TODO: handle symlinks
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, strcmp(path1.buf, path2.buf) == 0);
+	*res = make_obj_bool(wk, strcmp(path1.buf, path2.buf) == 0);
 	return true;
 }
 
@@ -640,8 +636,7 @@ func_module_fs_is_basename(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, path_is_basename(get_cstr(wk, an[0].val)));
+	*res = make_obj_bool(wk, path_is_basename(get_cstr(wk, an[0].val)));
 	return true;
 }
 
@@ -667,8 +662,7 @@ func_module_fs_is_subpath(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, path_is_subpath(get_cstr(wk, an[0].val), get_cstr(wk, an[1].val)));
+	*res = make_obj_bool(wk, path_is_subpath(get_cstr(wk, an[0].val), get_cstr(wk, an[1].val)));
 	return true;
 }
 
@@ -5,106 +5,228 @@
 
 #include "compat.h"
 
+#include <stdlib.h>
+
+#include "backend/output.h"
 #include "coerce.h"
+#include "configure_cache.h"
+#include "configure_fingerprint.h"
 #include "embedded.h"
 #include "external/tinyjson.h"
 #include "functions/external_program.h"
 #include "functions/modules/python.h"
 #include "install.h"
 #include "lang/object.h"
+#include "lang/object_iterators.h"
 #include "lang/typecheck.h"
 #include "options.h"
 #include "platform/filesystem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "platform/timer.h"
 
-static bool
-introspect_python_interpreter(struct workspace *wk, const char *path, struct obj_python_installation *python)
+/*
+ * Interpreter introspection results and module presence checks are cached in
+ * wk->python_cache, keyed by interpreter path and the environment variables
+ * that influence sys.path.  Each entry is a dict with the following keys:
+ *
+ * - introspect: the dict printed by python_info.py
+ * - modules: dict[str -> bool], module presence
+ * - files: stamps of the interpreter and every sys.path entry, see
+ *   configure_cache_record
+ *
+ * The cache is persisted if muon.configure_cache is set.  Installing a module
+ * modifies a sys.path directory, invalidating the entry.
+ */
+static obj
+python_cache(struct workspace *wk)
 {
-	const char *pyinfo = embedded_get("python_info.py");
-	if (!pyinfo) {
-		return false;
+	if (wk->python_cache) {
+		return wk->python_cache;
 	}
 
-	struct run_cmd_ctx cmd_ctx = { 0 };
-	char *const var_args[] = { (char *)path, "-c", (char *)pyinfo, 0 };
-	if (!run_cmd_argv(&cmd_ctx, var_args, NULL, 0) || cmd_ctx.status != 0) {
-		return false;
+	obj cache, fresh, key, entry, files;
+	make_obj(wk, &fresh, obj_dict);
+
+	if (configure_cache_enabled(wk) && configure_cache_load(wk, output_path.python_cache, &cache)) {
+		obj_dict_for(wk, cache, key, entry) {
+			if (obj_dict_index_str(wk, entry, "files", &files) && !configure_cache_files_changed(wk, files)) {
+				obj_dict_set(wk, fresh, key, entry);
+			}
+		}
 	}
 
-	obj res_introspect;
-	bool success = muon_json_to_dict(wk, cmd_ctx.out.buf, &res_introspect);
+	return wk->python_cache = fresh;
+}
 
-	if (!success) {
-		goto end;
-	}
+static obj
+python_cache_key(struct workspace *wk, const char *path)
+{
+	const char *pythonpath = configure_fingerprint_getenv(wk, "PYTHONPATH");
+	const char *pythonhome = configure_fingerprint_getenv(wk, "PYTHONHOME");
+	return make_strf(wk, "%s\n%s\n%s", path, pythonpath ? pythonpath : "", pythonhome ? pythonhome : "");
+}
 
-	if (!obj_dict_index_str(wk, res_introspect, "version", &python->language_version)) {
-		success = false;
-		goto end;
+static bool
+python_cache_new_entry(struct workspace *wk, const char *path, char *introspect_json, obj *res)
+{
+	obj introspect, sys_path, files, modules, dir;
+	if (!muon_json_to_dict(wk, introspect_json, &introspect)) {
+		return false;
 	}
 
-	if (!obj_dict_index_str(wk, res_introspect, "sysconfig_paths", &python->sysconfig_paths)) {
-		success = false;
-		goto end;
+	make_obj(wk, &files, obj_dict);
+	configure_cache_record(wk, files, path);
+	if (obj_dict_index_str(wk, introspect, "sys_path", &sys_path) && get_obj_type(wk, sys_path) == obj_array) {
+		obj_array_for(wk, sys_path, dir) {
+			if (get_obj_type(wk, dir) == obj_string && get_str(wk, dir)->len) {
+				configure_cache_record(wk, files, get_cstr(wk, dir));
+			}
+		}
 	}
 
-	if (!obj_dict_index_str(wk, res_introspect, "variables", &python->sysconfig_vars)) {
-		success = false;
-		goto end;
-	}
+	make_obj(wk, &modules, obj_dict);
 
-	if (!obj_dict_index_str(wk, res_introspect, "install_paths", &python->install_paths)) {
-		success = false;
-		goto end;
-	}
-end:
-	run_cmd_ctx_destroy(&cmd_ctx);
-	return success;
+	make_obj(wk, res, obj_dict);
+	obj_dict_set(wk, *res, make_str(wk, "introspect"), introspect);
+	obj_dict_set(wk, *res, make_str(wk, "modules"), modules);
+	obj_dict_set(wk, *res, make_str(wk, "files"), files);
+	return true;
 }
 
 static bool
-python_module_present(struct workspace *wk, const char *pythonpath, const char *mod)
+python_apply_introspection(struct workspace *wk, obj introspect, struct obj_python_installation *python)
 {
-	struct run_cmd_ctx cmd_ctx = { 0 };
+	return obj_dict_index_str(wk, introspect, "version", &python->language_version)
+	       && obj_dict_index_str(wk, introspect, "sysconfig_paths", &python->sysconfig_paths)
+	       && obj_dict_index_str(wk, introspect, "variables", &python->sysconfig_vars)
+	       && obj_dict_index_str(wk, introspect, "install_paths", &python->install_paths);
+}
 
-	SBUF(importstr);
-	sbuf_pushf(wk, &importstr, "import %s", mod);
+/*
+ * Probes (the introspection script and module imports) are independent of
+ * each other and dominated by interpreter startup time, so they are all
+ * started at once and then collected together.
+ */
+struct python_probe {
+	struct run_cmd_ctx cmd_ctx;
+	bool running, ok;
+};
 
-	char *const *args = (char *const[]){ (char *)pythonpath, "-c", importstr.buf, 0 };
+static void
+python_probe_start(struct workspace *wk, struct python_probe *probe, const char *path, const char *src)
+{
+	*probe = (struct python_probe){ .cmd_ctx = { .flags = run_cmd_ctx_flag_async } };
+	char *const argv[] = { (char *)path, "-c", (char *)src, 0 };
+	probe->running = run_cmd_argv(&probe->cmd_ctx, argv, NULL, 0);
+}
 
-	bool present = run_cmd_argv(&cmd_ctx, args, NULL, 0) && cmd_ctx.status == 0;
+/*
+ * Waits for each probe in turn.  Clearing the async flag makes
+ * run_cmd_collect block until the child exits, and since every probe was
+ * started up front the total wait is that of the slowest one.
+ */
+static void
+python_probes_collect(struct python_probe *probes, uint32_t len)
+{
+	uint32_t i;
+	struct timer t;
+	timer_start(&t);
 
-	run_cmd_ctx_destroy(&cmd_ctx);
+	for (i = 0; i < len; ++i) {
+		if (!probes[i].running) {
+			continue;
+		}
 
-	return present;
-}
+		probes[i].cmd_ctx.flags &= ~run_cmd_ctx_flag_async;
+		probes[i].ok = run_cmd_collect(&probes[i].cmd_ctx) == run_cmd_finished && probes[i].cmd_ctx.status == 0;
+		probes[i].running = false;
+	}
 
-struct iter_mod_ctx {
-	const char *pythonpath;
-	uint32_t node;
-	enum requirement_type requirement;
-};
+	run_cmd_wait_time += timer_read(&t);
+}
 
-static enum iteration_result
-iterate_required_module_list(struct workspace *wk, void *ctx, obj val)
+/*
+ * Looks up or creates the cache entry for the interpreter at path, checking
+ * for the presence of mods along the way.  If the interpreter could not be
+ * introspected, the returned entry only holds the module results, has no
+ * introspect key, and is not cached.
+ */
+static obj
+python_probe_interpreter(struct workspace *wk, const char *path, obj mods)
 {
-	struct iter_mod_ctx *_ctx = ctx;
-	const char *mod = get_cstr(wk, val);
+	obj key = python_cache_key(wk, path), entry = 0, modules = 0, mod;
+	const char *pyinfo = NULL;
+	if (obj_dict_index(wk, python_cache(wk), key, &entry)) {
+		obj_dict_index_str(wk, entry, "modules", &modules);
+	} else {
+		pyinfo = embedded_get("python_info.py");
+	}
+
+	struct arr probes;
+	arr_init(&probes, 8, sizeof(struct python_probe));
+
+	obj probed_mods;
+	make_obj(wk, &probed_mods, obj_array);
+
+	if (mods) {
+		obj_array_for(wk, mods, mod) {
+			if (modules && obj_dict_in(wk, modules, mod)) {
+				continue;
+			}
+
+			obj import = make_strf(wk, "import %s", get_cstr(wk, mod));
+			arr_push(&probes, &(struct python_probe){ 0 });
+			python_probe_start(wk, arr_peek(&probes, 1), path, get_cstr(wk, import));
+			obj_array_push(wk, probed_mods, mod);
+		}
+	}
+
+	if (pyinfo) {
+		arr_push(&probes, &(struct python_probe){ 0 });
+		python_probe_start(wk, arr_peek(&probes, 1), path, pyinfo);
+	}
+
+	python_probes_collect((struct python_probe *)probes.e, probes.len);
+
+	if (pyinfo) {
+		struct python_probe *introspection = arr_peek(&probes, 1);
+		if (introspection->ok && python_cache_new_entry(wk, path, introspection->cmd_ctx.out.buf, &entry)) {
+			obj_dict_set(wk, wk->python_cache, key, entry);
+		}
+	}
+
+	if (!entry) {
+		make_obj(wk, &entry, obj_dict);
+		make_obj(wk, &modules, obj_dict);
+		obj_dict_set(wk, entry, make_str(wk, "modules"), modules);
+	}
 
-	if (python_module_present(wk, _ctx->pythonpath, mod)) {
-		return ir_cont;
+	obj_dict_index_str(wk, entry, "modules", &modules);
+
+	uint32_t i = 0;
+	obj_array_for(wk, probed_mods, mod) {
+		struct python_probe *probe = arr_get(&probes, i);
+		obj_dict_set(wk, modules, mod, probe->ok ? obj_bool_true : obj_bool_false);
+		++i;
 	}
 
-	if (_ctx->requirement == requirement_required) {
-		vm_error_at(wk, _ctx->node, "python: required module '%s' not found", mod);
+	for (i = 0; i < probes.len; ++i) {
+		run_cmd_ctx_destroy(&((struct python_probe *)arr_get(&probes, i))->cmd_ctx);
 	}
+	arr_destroy(&probes);
 
-	return ir_err;
+	return entry;
 }
 
 static bool
-build_python_installation(struct workspace *wk, obj self, obj *res, struct sbuf cmd_path, bool found, bool pure)
+build_python_installation(struct workspace *wk,
+	obj self,
+	obj *res,
+	struct sbuf cmd_path,
+	obj entry,
+	bool found,
+	bool pure)
 {
 	make_obj(wk, res, obj_python_installation);
 	struct obj_python_installation *python = get_obj_python_installation(wk, *res);
@@ -115,7 +237,10 @@ build_python_installation(struct workspace *wk, obj self, obj *res, struct sbuf
 	make_obj(wk, &ep->cmd_array, obj_array);
 	obj_array_push(wk, ep->cmd_array, sbuf_into_str(wk, &cmd_path));
 
-	if (found && !introspect_python_interpreter(wk, cmd_path.buf, python)) {
+	obj introspect;
+	if (found
+		&& !(entry && obj_dict_index_str(wk, entry, "introspect", &introspect)
+			&& python_apply_introspection(wk, introspect, python))) {
 		vm_error(wk, "failed to introspect python");
 		return false;
 	}
@@ -163,7 +288,7 @@ func_module_python_find_installation(struct workspace *wk, obj self, obj *res)
 	}
 
 	SBUF(cmd_path);
-	bool found = fs_find_cmd(wk, &cmd_path, cmd);
+	bool found = find_program_in_path(wk, &cmd_path, cmd);
 	if (!found && (requirement == requirement_required)) {
 		vm_error(wk, "%s not found", cmd);
 		return false;
@@ -175,21 +300,22 @@ func_module_python_find_installation(struct workspace *wk, obj self, obj *res)
 	}
 
 	if (!found) {
-		return build_python_installation(wk, self, res, cmd_path, found, pure);
+		return build_python_installation(wk, self, res, cmd_path, 0, found, pure);
 	}
 
-	if (akw[kw_modules].set && found) {
-		bool all_present = obj_array_foreach(wk,
-			akw[kw_modules].val,
-			&(struct iter_mod_ctx){
-				.pythonpath = cmd_path.buf,
-				.node = akw[kw_modules].node,
-				.requirement = requirement,
-			},
-			iterate_required_module_list);
+	obj entry = python_probe_interpreter(wk, cmd_path.buf, akw[kw_modules].set ? akw[kw_modules].val : 0);
+
+	if (akw[kw_modules].set) {
+		obj modules, mod, present;
+		obj_dict_index_str(wk, entry, "modules", &modules);
+
+		obj_array_for(wk, akw[kw_modules].val, mod) {
+			if (obj_dict_index(wk, modules, mod, &present) && get_obj_bool(wk, present)) {
+				continue;
+			}
 
-		if (!all_present) {
 			if (requirement == requirement_required) {
+				vm_error_at(wk, akw[kw_modules].node, "python: required module '%s' not found", get_cstr(wk, mod));
 				return false;
 			}
 			if (disabler) {
@@ -198,10 +324,11 @@ func_module_python_find_installation(struct workspace *wk, obj self, obj *res)
 			}
 			/* Return a not-found object. */
 			found = false;
+			break;
 		}
 	}
 
-	return build_python_installation(wk, self, res, cmd_path, found, pure);
+	return build_python_installation(wk, self, res, cmd_path, entry, found, pure);
 }
 
 static bool
@@ -229,7 +356,7 @@ func_module_python3_find_python(struct workspace *wk, obj self, obj *res)
 	}
 
 	SBUF(cmd_path);
-	if (!fs_find_cmd(wk, &cmd_path, cmd)) {
+	if (!find_program_in_path(wk, &cmd_path, cmd)) {
 		vm_error(wk, "python3 not found");
 		return false;
 	}
@@ -299,8 +426,7 @@ func_python_installation_has_path(struct workspace *wk, obj self, obj *res)
 
 	obj sysconfig_paths = get_obj_python_installation(wk, self)->sysconfig_paths;
 	bool found = obj_dict_in(wk, sysconfig_paths, an[0].val);
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, found);
+	*res = make_obj_bool(wk, found);
 
 	return true;
 }
@@ -315,8 +441,7 @@ func_python_installation_has_var(struct workspace *wk, obj self, obj *res)
 
 	obj sysconfig_vars = get_obj_python_installation(wk, self)->sysconfig_vars;
 	bool found = obj_dict_in(wk, sysconfig_vars, an[0].val);
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, found);
+	*res = make_obj_bool(wk, found);
 
 	return true;
 }
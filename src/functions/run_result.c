@@ -34,8 +34,7 @@ func_run_result_returncode(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_number);
-	set_obj_number(wk, *res, get_obj_run_result(wk, self)->status);
+	*res = make_number(wk, get_obj_run_result(wk, self)->status);
 	return true;
 }
 
@@ -83,8 +82,7 @@ func_run_result_compiled(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, rr->flags & run_result_flag_compile_ok);
+	*res = make_obj_bool(wk, rr->flags & run_result_flag_compile_ok);
 	return true;
 }
 
@@ -357,8 +357,7 @@ func_version_compare(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, ctx.res);
+	*res = make_obj_bool(wk, ctx.res);
 	return true;
 }
 
@@ -377,8 +376,7 @@ func_string_to_int(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_number);
-	set_obj_number(wk, *res, n);
+	*res = make_number(wk, n);
 	return true;
 }
 
@@ -390,8 +388,7 @@ func_string_startswith(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, str_startswith(get_str(wk, self), get_str(wk, an[0].val)));
+	*res = make_obj_bool(wk, str_startswith(get_str(wk, self), get_str(wk, an[0].val)));
 	return true;
 }
 
@@ -403,8 +400,7 @@ func_string_endswith(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, str_endswith(get_str(wk, self), get_str(wk, an[0].val)));
+	*res = make_obj_bool(wk, str_endswith(get_str(wk, self), get_str(wk, an[0].val)));
 	return true;
 }
 
@@ -512,8 +508,7 @@ func_string_contains(struct workspace *wk, obj self, obj *res)
 		}
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, found);
+	*res = make_obj_bool(wk, found);
 	return true;
 }
 
@@ -58,8 +58,7 @@ func_subproject_found(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, get_obj_subproject(wk, self)->found);
+	*res = make_obj_bool(wk, get_obj_subproject(wk, self)->found);
 	return true;
 }
 
@@ -0,0 +1,276 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+
+#include "backend/output.h"
+#include "configure_cache.h"
+#include "lang/bytecode_cache.h"
+#include "lang/workspace.h"
+#include "platform/mem.h"
+#include "sha_256.h"
+#include "tracy.h"
+#include "version.h"
+
+/*
+ * Compiled bytecode is cached across configures, keyed by the sha_256 of the
+ * source text, the compile flags, and the muon version.  Each entry is a
+ * list of [code, constants, locations] where code has been made position
+ * independent:
+ *
+ * - object operands refer to an index into constants, offset by
+ *   vm_reserved_objects_end so that the reserved objects can be stored
+ *   directly,
+ * - jump targets are relative to the start of the code,
+ * - method cache slots are allocated afresh on load,
+ *
+ * and locations is a flat list of (ip, off, len) triples.  Code containing
+ * function definitions or analyzer ops is never cached.
+ */
+
+enum bytecode_cache_operand {
+	bytecode_cache_operand_int,
+	bytecode_cache_operand_obj,
+	bytecode_cache_operand_jmp,
+	bytecode_cache_operand_method_cache,
+};
+
+static const uint8_t bytecode_cache_operands[op_count][4] = {
+	[op_iterator_next] = { bytecode_cache_operand_jmp },
+	[op_add_store] = { bytecode_cache_operand_obj },
+	[op_load_local] = { bytecode_cache_operand_int, bytecode_cache_operand_obj },
+	[op_store_local] = { bytecode_cache_operand_int, bytecode_cache_operand_obj },
+	[op_add_store_local] = { bytecode_cache_operand_int, bytecode_cache_operand_obj },
+	[op_constant] = { bytecode_cache_operand_obj },
+	[op_call_method] = { bytecode_cache_operand_method_cache, bytecode_cache_operand_obj },
+	[op_jmp_if_true] = { bytecode_cache_operand_jmp },
+	[op_jmp_if_false] = { bytecode_cache_operand_jmp },
+	[op_jmp_if_disabler] = { bytecode_cache_operand_jmp },
+	[op_jmp_if_disabler_keep] = { bytecode_cache_operand_jmp },
+	[op_jmp] = { bytecode_cache_operand_jmp },
+};
+
+// Bump this whenever the layout of cache entries changes.
+static const uint32_t bytecode_cache_version = 3;
+
+static bool
+bytecode_cache_op_is_cacheable(uint8_t op)
+{
+	return op && op < op_count && op != op_constant_func && op != op_az_branch && op != op_az_merge;
+}
+
+static void
+bytecode_cache_put_operand(uint8_t *code, uint32_t v)
+{
+	v = vm_constant_host_to_bc(v);
+	code[0] = (v >> 16) & 0xff;
+	code[1] = (v >> 8) & 0xff;
+	code[2] = v & 0xff;
+}
+
+/*
+ * wk->bytecode_cache only holds the entries used by this configure, so that
+ * stale entries don't accumulate.  Entries from the previous configure are
+ * moved over from wk->bytecode_cache_prev as they are hit.
+ */
+static void
+bytecode_cache_init(struct workspace *wk)
+{
+	if (wk->bytecode_cache) {
+		return;
+	}
+
+	make_obj(wk, &wk->bytecode_cache, obj_dict);
+	if (!configure_cache_load(wk, output_path.bytecode_cache, &wk->bytecode_cache_prev)) {
+		wk->bytecode_cache_prev = 0;
+	}
+}
+
+bool
+bytecode_cache_key(struct workspace *wk, const struct source *src, uint32_t flags, uint8_t key[32])
+{
+	if (wk->vm.in_analyzer || wk->vm.dbg_state.dbg || !configure_cache_enabled(wk)) {
+		return false;
+	}
+
+	const uint32_t op_n = op_count;
+
+	struct sha_256 sha;
+	sha_256_init(&sha);
+	sha_256_write(&sha, muon_version.version, strlen(muon_version.version) + 1);
+	sha_256_write(&sha, muon_version.vcs_tag, strlen(muon_version.vcs_tag) + 1);
+	sha_256_write(&sha, &bytecode_cache_version, sizeof(bytecode_cache_version));
+	sha_256_write(&sha, &op_n, sizeof(op_n));
+	sha_256_write(&sha, &flags, sizeof(flags));
+	sha_256_write(&sha, src->src, src->len);
+	sha_256_close(&sha, key);
+	return true;
+}
+
+bool
+bytecode_cache_load(struct workspace *wk, const uint8_t key[32], uint32_t *entry)
+{
+	TracyCZoneAutoS;
+	bool ret = false;
+
+	bytecode_cache_init(wk);
+
+	obj cached;
+	if (!obj_dict_index_strn(wk, wk->bytecode_cache, (const char *)key, 32, &cached)) {
+		if (!wk->bytecode_cache_prev
+			|| !obj_dict_index_strn(wk, wk->bytecode_cache_prev, (const char *)key, 32, &cached)) {
+			goto ret;
+		}
+
+		obj_dict_set(wk, wk->bytecode_cache, make_strn(wk, (const char *)key, 32), cached);
+	}
+
+	obj code_str, constants, locations;
+	obj_array_index(wk, cached, 0, &code_str);
+	obj_array_index(wk, cached, 1, &constants);
+	obj_array_index(wk, cached, 2, &locations);
+
+	const struct str *code_src = get_str(wk, code_str);
+	const uint32_t base = wk->vm.code.len, method_cache_base = wk->vm.method_cache.len,
+		       nconstants = get_obj_array(wk, constants)->len;
+
+	arr_grow_by(&wk->vm.code, code_src->len);
+	uint8_t *code = arr_get(&wk->vm.code, base);
+	memcpy(code, code_src->s, code_src->len);
+
+	uint32_t ip, j, v, operand_ip;
+	for (ip = 0; ip < code_src->len;) {
+		uint8_t op = code[ip];
+		if (!bytecode_cache_op_is_cacheable(op) || ip + OP_WIDTH(op) > code_src->len) {
+			goto corrupt;
+		}
+
+		++ip;
+		for (j = 0; j < op_operands[op]; ++j) {
+			operand_ip = ip;
+			v = vm_get_constant(code, &ip);
+
+			switch ((enum bytecode_cache_operand)bytecode_cache_operands[op][j]) {
+			case bytecode_cache_operand_int: continue;
+			case bytecode_cache_operand_obj:
+				if (v >= vm_reserved_objects_end) {
+					if (v - vm_reserved_objects_end >= nconstants) {
+						goto corrupt;
+					}
+
+					obj_array_index(wk, constants, v - vm_reserved_objects_end, &v);
+
+					// Deserialized numbers may come back immediate, but
+					// constant operands need a boxed one.
+					if (v & OBJ_IMMEDIATE_NUMBER_BIT) {
+						int64_t n = get_obj_number(wk, v);
+						make_obj(wk, &v, obj_number);
+						set_obj_number(wk, v, n);
+					}
+				}
+				break;
+			case bytecode_cache_operand_jmp: v += base; break;
+			case bytecode_cache_operand_method_cache:
+				v = wk->vm.method_cache.len;
+				arr_push(&wk->vm.method_cache, &(struct vm_method_cache_entry){ 0 });
+				break;
+			}
+
+			bytecode_cache_put_operand(&code[operand_ip], v);
+		}
+	}
+
+	const struct obj_array *locs = get_obj_array(wk, locations);
+	for (j = 0; j + 2 < locs->len; j += 3) {
+		arr_push(&wk->vm.locations,
+			&(struct source_location_mapping){
+				.ip = base + get_obj_number(wk, obj_array_elem(wk, locs, j)),
+				.loc = {
+					.off = get_obj_number(wk, obj_array_elem(wk, locs, j + 1)),
+					.len = get_obj_number(wk, obj_array_elem(wk, locs, j + 2)),
+				},
+				.src_idx = wk->vm.src.len - 1,
+			});
+	}
+
+	*entry = base;
+	ret = true;
+	goto ret;
+corrupt:
+	wk->vm.code.len = base;
+	wk->vm.method_cache.len = method_cache_base;
+ret:
+	TracyCZoneAutoE;
+	return ret;
+}
+
+void
+bytecode_cache_store(struct workspace *wk, const uint8_t key[32], uint32_t entry, uint32_t locations_start)
+{
+	TracyCZoneAutoS;
+
+	bytecode_cache_init(wk);
+
+	const uint32_t len = wk->vm.code.len - entry;
+	uint8_t *code = z_malloc(len);
+	memcpy(code, arr_get(&wk->vm.code, entry), len);
+
+	obj constants, locations;
+	make_obj(wk, &constants, obj_array);
+	make_obj(wk, &locations, obj_array);
+
+	uint32_t ip, j, v, operand_ip;
+	for (ip = 0; ip < len;) {
+		uint8_t op = code[ip];
+		if (!bytecode_cache_op_is_cacheable(op)) {
+			goto ret;
+		}
+
+		++ip;
+		for (j = 0; j < op_operands[op]; ++j) {
+			operand_ip = ip;
+			v = vm_get_constant(code, &ip);
+
+			switch ((enum bytecode_cache_operand)bytecode_cache_operands[op][j]) {
+			case bytecode_cache_operand_int: continue;
+			case bytecode_cache_operand_obj:
+				if (v >= vm_reserved_objects_end) {
+					obj_array_push(wk, constants, v);
+					v = vm_reserved_objects_end + get_obj_array(wk, constants)->len - 1;
+				}
+				break;
+			case bytecode_cache_operand_jmp: v -= entry; break;
+			case bytecode_cache_operand_method_cache: v = 0; break;
+			}
+
+			bytecode_cache_put_operand(&code[operand_ip], v);
+		}
+	}
+
+	uint32_t i;
+	for (i = locations_start; i < wk->vm.locations.len; ++i) {
+		const struct source_location_mapping *m = arr_get(&wk->vm.locations, i);
+		if (m->src_idx != wk->vm.src.len - 1) {
+			goto ret;
+		}
+
+		obj_array_push(wk, locations, make_number(wk, m->ip - entry));
+		obj_array_push(wk, locations, make_number(wk, m->loc.off));
+		obj_array_push(wk, locations, make_number(wk, m->loc.len));
+	}
+
+	obj cached;
+	make_obj(wk, &cached, obj_array);
+	obj_array_push(wk, cached, make_strn(wk, (const char *)code, len));
+	obj_array_push(wk, cached, constants);
+	obj_array_push(wk, cached, locations);
+	obj_dict_set(wk, wk->bytecode_cache, make_strn(wk, (const char *)key, 32), cached);
+
+ret:
+	z_free(code);
+	TracyCZoneAutoE;
+}
@@ -99,6 +99,388 @@ enum vm_compile_block_flags {
 static void vm_compile_block(struct workspace *wk, struct node *n, enum vm_compile_block_flags flags);
 static void vm_compile_expr(struct workspace *wk, struct node *n);
 
+/* Local variable slots.
+ *
+ * Variables of a function body are resolved to numbered slots in the call
+ * frame when every variable the body assigns is known at compile time.  A body
+ * that accesses variables by name (get_variable() and friends) or defines a
+ * nested function that would capture its scope keeps using named lookup.
+ * Project scopes are always named since they are shared between subdir()
+ * files and read by subproject.get_variable().
+ *
+ * Slot loads of a variable that has not been assigned yet in the current
+ * frame fall back to named lookup, so reading a variable from an enclosing
+ * scope before shadowing it behaves the same as with scope dicts.
+ */
+
+static bool
+vm_comp_find_local(struct workspace *wk, obj name, uint32_t *slot)
+{
+	uint32_t i;
+	const struct str *s = get_str(wk, name);
+	for (i = 0; i < wk->vm.compiler_state.locals.len; ++i) {
+		if (str_eql(s, get_str(wk, *(obj *)arr_get(&wk->vm.compiler_state.locals, i)))) {
+			*slot = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+vm_comp_local_slot(struct workspace *wk, obj name, uint32_t *slot)
+{
+	return wk->vm.compiler_state.resolve_locals && vm_comp_find_local(wk, name, slot);
+}
+
+static void
+vm_comp_add_local(struct workspace *wk, obj name)
+{
+	uint32_t slot;
+	if (!vm_comp_find_local(wk, name, &slot)) {
+		arr_push(&wk->vm.compiler_state.locals, &name);
+	}
+}
+
+static bool
+vm_comp_scan_locals(struct workspace *wk, struct node *n)
+{
+	for (; n; n = n->r) {
+		switch (n->type) {
+		case node_type_func_def: return false;
+		case node_type_call:
+			if (n->r && n->r->type == node_type_id_lit) {
+				const struct str *name = get_str(wk, n->r->data.str);
+				if (str_eql(name, &WKSTR("get_variable")) || str_eql(name, &WKSTR("set_variable"))
+					|| str_eql(name, &WKSTR("is_variable"))
+					|| str_eql(name, &WKSTR("unset_variable"))) {
+					return false;
+				}
+			}
+			break;
+		case node_type_assign: vm_comp_add_local(wk, n->l->data.str); break;
+		case node_type_foreach:
+			vm_comp_add_local(wk, n->l->l->l->data.str);
+			if (n->l->l->r) {
+				vm_comp_add_local(wk, n->l->l->r->data.str);
+			}
+			break;
+		default: break;
+		}
+
+		if (!vm_comp_scan_locals(wk, n->l)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool
+vm_comp_func_locals(struct workspace *wk, struct node *n, struct obj_func *func)
+{
+	struct node *arg;
+
+	wk->vm.compiler_state.locals.len = 0;
+	wk->vm.compiler_state.resolve_locals = false;
+
+	// The analyzer and debugger inspect variables through scope dicts.
+	if (wk->vm.in_analyzer || wk->vm.dbg_state.dbg) {
+		return false;
+	}
+
+	// Slots of arguments must match the order vm_execute_capture fills them in.
+	for (arg = n->l->r; arg && arg->l; arg = arg->r) {
+		if (arg->l->type != node_type_kw) {
+			vm_comp_add_local(wk, arg->l->data.str);
+		}
+	}
+
+	for (arg = n->l->r; arg && arg->l; arg = arg->r) {
+		if (arg->l->type == node_type_kw) {
+			vm_comp_add_local(wk, arg->l->r->data.str);
+		}
+	}
+
+	if (!vm_comp_scan_locals(wk, n->r)) {
+		wk->vm.compiler_state.locals.len = 0;
+		wk->vm.compiler_state.resolve_locals = false;
+		return false;
+	}
+
+	wk->vm.compiler_state.resolve_locals = true;
+	func->nlocals = wk->vm.compiler_state.locals.len;
+	func->local_slots = true;
+	return true;
+}
+
+static void
+vm_comp_store(struct workspace *wk, obj name)
+{
+	uint32_t slot;
+	if (vm_comp_local_slot(wk, name, &slot)) {
+		push_code(wk, op_store_local);
+		push_constant(wk, slot);
+		push_constant(wk, name);
+	} else {
+		push_code(wk, op_constant);
+		push_constant(wk, name);
+		push_code(wk, op_store);
+	}
+}
+
+/* Constant folding.
+ *
+ * Before compiling, operators whose operands are all literals are replaced by
+ * their result, and the arms of if statements, ternaries, and/or that can't
+ * be taken are dropped along with statements following a return, break or
+ * continue.  Folded nodes keep the location of the expression they replace.
+ * Only operations that can't fail are folded, so errors are still reported
+ * at runtime.  The analyzer compiles the ast as is since it checks every
+ * branch.
+ */
+
+static void
+vm_comp_fold_to_bool(struct node *n, bool v)
+{
+	n->type = node_type_bool;
+	n->data.num = v;
+	n->l = n->r = 0;
+}
+
+static void
+vm_comp_fold_to_number(struct node *n, int64_t v)
+{
+	n->type = node_type_number;
+	n->data.num = v;
+	n->l = n->r = 0;
+}
+
+static void
+vm_comp_fold_to_string(struct node *n, obj v)
+{
+	n->type = node_type_string;
+	n->data.str = v;
+	n->l = n->r = 0;
+}
+
+static void
+vm_comp_fold_replace(struct node *n, const struct node *with)
+{
+	struct source_location loc = n->location;
+	*n = *with;
+	n->location = loc;
+}
+
+static void
+vm_comp_fold_array_concat(struct node *n, struct node *a, struct node *b)
+{
+	struct node *last = a;
+	while (last->r) {
+		last = last->r;
+	}
+
+	if (!last->l) {
+		// a is empty or ends with a trailing comma
+		last->l = b->l;
+		last->r = b->r;
+	} else {
+		b->type = node_type_list;
+		last->r = b;
+	}
+
+	a->data.len.args += b->data.len.args;
+	vm_comp_fold_replace(n, a);
+}
+
+static void
+vm_comp_fold_node(struct workspace *wk, struct node *n)
+{
+	struct node *l = n->l, *r = n->r;
+	enum node_type lt = l ? l->type : node_type_stmt, rt = r ? r->type : node_type_stmt;
+
+	switch (n->type) {
+	case node_type_stmt:
+		if (l && (lt == node_type_return || lt == node_type_break || lt == node_type_continue)) {
+			n->r = 0;
+		}
+		break;
+	case node_type_if: {
+		if (!l->l || l->l->type != node_type_bool) {
+			break;
+		}
+
+		if (l->l->data.num) {
+			// Always taken, so this becomes the else branch.
+			l->l = 0;
+			n->r = 0;
+		} else if (r) {
+			// Never taken, the rest of the chain has already been folded.
+			*n = *r;
+		} else {
+			l->l = 0;
+			l->r = 0;
+		}
+		break;
+	}
+	case node_type_ternary:
+		if (lt == node_type_bool) {
+			// Keep the location of the branch, errors in it should
+			// point there rather than at the condition.
+			*n = *(l->data.num ? r->l : r->r);
+		}
+		break;
+	case node_type_and:
+	case node_type_or:
+		if (lt != node_type_bool) {
+			break;
+		} else if (!!l->data.num == (n->type == node_type_or)) {
+			vm_comp_fold_to_bool(n, l->data.num);
+		} else if (rt == node_type_bool) {
+			vm_comp_fold_to_bool(n, r->data.num);
+		}
+		break;
+	case node_type_not:
+		if (lt == node_type_bool) {
+			vm_comp_fold_to_bool(n, !l->data.num);
+		}
+		break;
+	case node_type_negate:
+		if (lt == node_type_number) {
+			vm_comp_fold_to_number(n, l->data.num * -1);
+		}
+		break;
+	case node_type_add:
+		if (lt == node_type_number && rt == node_type_number) {
+			vm_comp_fold_to_number(n, l->data.num + r->data.num);
+		} else if (lt == node_type_string && rt == node_type_string) {
+			vm_comp_fold_to_string(n, str_join(wk, l->data.str, r->data.str));
+		} else if (lt == node_type_array && rt == node_type_array) {
+			vm_comp_fold_array_concat(n, l, r);
+		}
+		break;
+	case node_type_sub:
+		if (lt == node_type_number && rt == node_type_number) {
+			vm_comp_fold_to_number(n, l->data.num - r->data.num);
+		}
+		break;
+	case node_type_mul:
+		if (lt == node_type_number && rt == node_type_number) {
+			vm_comp_fold_to_number(n, l->data.num * r->data.num);
+		}
+		break;
+	case node_type_div:
+		if (lt == node_type_number && rt == node_type_number && r->data.num) {
+			vm_comp_fold_to_number(n, l->data.num / r->data.num);
+		} else if (lt == node_type_string && rt == node_type_string && !str_has_null(get_str(wk, l->data.str))
+			   && !str_has_null(get_str(wk, r->data.str))) {
+			SBUF(buf);
+			path_join(wk, &buf, get_cstr(wk, l->data.str), get_cstr(wk, r->data.str));
+			vm_comp_fold_to_string(n, sbuf_into_str(wk, &buf));
+		}
+		break;
+	case node_type_mod:
+		if (lt == node_type_number && rt == node_type_number && r->data.num) {
+			vm_comp_fold_to_number(n, l->data.num % r->data.num);
+		}
+		break;
+	case node_type_eq:
+	case node_type_neq: {
+		bool eq;
+		if (lt != rt) {
+			break;
+		} else if (lt == node_type_number || lt == node_type_bool) {
+			eq = l->data.num == r->data.num;
+		} else if (lt == node_type_string) {
+			eq = str_eql(get_str(wk, l->data.str), get_str(wk, r->data.str));
+		} else {
+			break;
+		}
+
+		vm_comp_fold_to_bool(n, eq == (n->type == node_type_eq));
+		break;
+	}
+	case node_type_lt:
+	case node_type_gt:
+	case node_type_leq:
+	case node_type_geq: {
+		if (lt != node_type_number || rt != node_type_number) {
+			break;
+		}
+
+		int64_t a = l->data.num, b = r->data.num;
+		vm_comp_fold_to_bool(n,
+			n->type == node_type_lt ? a < b :
+			n->type == node_type_gt ? a > b :
+			n->type == node_type_leq ? a <= b :
+						  a >= b);
+		break;
+	}
+	default: break;
+	}
+}
+
+static void
+vm_comp_fold(struct workspace *wk, struct node *n)
+{
+	struct node *peek, *prev = 0;
+	struct arr *stack = &wk->vm.compiler_state.node_stack;
+
+	uint32_t stack_base = stack->len;
+
+	while (stack->len > stack_base || n) {
+		if (n) {
+			arr_push(stack, &n);
+			n = n->l;
+		} else {
+			peek = *(struct node **)arr_peek(stack, 1);
+			if (peek->r && prev != peek->r) {
+				n = peek->r;
+			} else {
+				vm_comp_fold_node(wk, peek);
+				prev = *(struct node **)arr_pop(stack);
+			}
+		}
+	}
+}
+
+/* Jump threading.
+ *
+ * Jumps that land on an unconditional jmp, e.g. the end of an if statement
+ * nested at the end of another block, are redirected to its target.
+ */
+
+static void
+vm_comp_thread_jumps(struct workspace *wk, uint32_t entry)
+{
+	uint8_t *code = wk->vm.code.e;
+	uint32_t ip, tgt, tgt_ip, hops;
+
+	for (ip = entry; ip < wk->vm.code.len; ip += OP_WIDTH(code[ip])) {
+		switch (code[ip]) {
+		case op_jmp:
+		case op_jmp_if_true:
+		case op_jmp_if_false:
+		case op_jmp_if_disabler:
+		case op_jmp_if_disabler_keep:
+		case op_iterator_next: break;
+		default: continue;
+		}
+
+		tgt_ip = ip + 1;
+		tgt = vm_get_constant(code, &tgt_ip);
+
+		// Bounded, in case of a jmp to itself.
+		for (hops = 0; hops < 8 && tgt < wk->vm.code.len && code[tgt] == op_jmp; ++hops) {
+			tgt_ip = tgt + 1;
+			tgt = vm_get_constant(code, &tgt_ip);
+		}
+
+		push_constant_at(tgt, &code[ip + 1]);
+	}
+}
+
 static void
 vm_comp_node(struct workspace *wk, struct node *n)
 {
@@ -148,14 +530,23 @@ vm_comp_node(struct workspace *wk, struct node *n)
 		push_code(wk, op_lt);
 		push_code(wk, op_not);
 		break;
-	case node_type_id:
-		push_code(wk, op_constant);
-		push_constant(wk, n->data.str);
-		push_code(wk, op_load);
+	case node_type_id: {
+		uint32_t slot;
+		if (vm_comp_local_slot(wk, n->data.str, &slot)) {
+			push_code(wk, op_load_local);
+			push_constant(wk, slot);
+			push_constant(wk, n->data.str);
+		} else {
+			push_code(wk, op_constant);
+			push_constant(wk, n->data.str);
+			push_code(wk, op_load);
+		}
 		break;
+	}
 	case node_type_number:
 		push_code(wk, op_constant);
 		obj o;
+		// Boxed, since immediate numbers don't fit in a constant operand
 		make_obj(wk, &o, obj_number);
 		set_obj_number(wk, o, n->data.num);
 		push_constant(wk, o);
@@ -176,17 +567,22 @@ vm_comp_node(struct workspace *wk, struct node *n)
 		push_code(wk, op_constant_dict);
 		push_constant(wk, n->data.len.kwargs);
 		break;
-	case node_type_assign:
-		push_code(wk, op_constant);
-		push_constant(wk, n->l->data.str);
-		push_code(wk, op_store);
-		break;
-	case node_type_plusassign:
-		push_code(wk, op_add_store);
+	case node_type_assign: vm_comp_store(wk, n->l->data.str); break;
+	case node_type_plusassign: {
+		uint32_t slot;
+		if (vm_comp_local_slot(wk, n->l->data.str, &slot)) {
+			push_code(wk, op_add_store_local);
+			push_constant(wk, slot);
+		} else {
+			push_code(wk, op_add_store);
+		}
 		push_constant(wk, n->l->data.str);
 		break;
+	}
 	case node_type_method: {
 		push_code(wk, op_call_method);
+		push_constant(wk, wk->vm.method_cache.len);
+		arr_push(&wk->vm.method_cache, &(struct vm_method_cache_entry){ 0 });
 		push_constant(wk, n->r->data.str);
 		push_constant(wk, n->l->data.len.args);
 		push_constant(wk, n->l->data.len.kwargs);
@@ -347,15 +743,11 @@ vm_comp_node(struct workspace *wk, struct node *n)
 		break_jmp_patch_tgt = wk->vm.code.len;
 		push_constant(wk, 0);
 
-		push_code(wk, op_constant);
-		push_constant(wk, ida->data.str);
-		push_code(wk, op_store);
+		vm_comp_store(wk, ida->data.str);
 		push_code(wk, op_pop);
 
 		if (idb) {
-			push_code(wk, op_constant);
-			push_constant(wk, idb->data.str);
-			push_code(wk, op_store);
+			vm_comp_store(wk, idb->data.str);
 			push_code(wk, op_pop);
 		}
 
@@ -457,6 +849,11 @@ vm_comp_node(struct workspace *wk, struct node *n)
 
 			vm_compile_block(wk, n->l->r, 0);
 
+			if (!n->l->l && !wk->vm.in_analyzer) {
+				// The else branch falls through to the end.
+				break;
+			}
+
 			push_code(wk, op_jmp);
 			arr_push(&wk->vm.compiler_state.if_jmp_stack, &wk->vm.code.len);
 			++patch_tgts;
@@ -623,7 +1020,10 @@ vm_comp_node(struct workspace *wk, struct node *n)
 
 		func->entry = wk->vm.code.len;
 
+		vm_comp_func_locals(wk, n, func);
 		vm_compile_block(wk, n->r, vm_compile_block_final_return);
+		wk->vm.compiler_state.locals.len = 0;
+		wk->vm.compiler_state.resolve_locals = false;
 
 		/* function body end */
 
@@ -784,8 +1184,16 @@ vm_compile_ast(struct workspace *wk, struct node *n, enum vm_compile_mode mode,
 		flags |= vm_compile_block_expr;
 	}
 
+	if (!wk->vm.in_analyzer) {
+		vm_comp_fold(wk, n);
+	}
+
 	vm_compile_block(wk, n, flags);
 
+	if (!wk->vm.in_analyzer) {
+		vm_comp_thread_jumps(wk, *entry);
+	}
+
 	assert(wk->vm.compiler_state.node_stack.len == 0);
 	assert(wk->vm.compiler_state.loop_jmp_stack.len == 0);
 	assert(wk->vm.compiler_state.if_jmp_stack.len == 0);
@@ -11,6 +11,7 @@
 #include "error.h"
 #include "external/readline.h"
 #include "lang/analyze.h"
+#include "lang/bytecode_cache.h"
 #include "lang/compiler.h"
 #include "lang/eval.h"
 #include "lang/parser.h"
@@ -19,6 +20,7 @@
 #include "platform/filesystem.h"
 #include "platform/mem.h"
 #include "platform/path.h"
+#include "profile.h"
 #include "tracy.h"
 #include "wrap.h"
 
@@ -111,9 +113,14 @@ eval(struct workspace *wk, struct source *src, enum eval_mode mode, obj *res)
 		compile_mode |= vm_compile_mode_expr;
 	}
 
+	uint8_t cache_key[32];
+	bool cache = (mode & eval_mode_cache)
+		     && bytecode_cache_key(wk, src, compile_mode | ((mode & eval_mode_first) << 8), cache_key);
+
 	uint32_t entry;
-	{
+	if (!(cache && bytecode_cache_load(wk, cache_key, &entry))) {
 		struct node *n;
+		uint32_t locations_start = wk->vm.locations.len;
 
 		vm_compile_state_reset(wk);
 
@@ -130,6 +137,12 @@ eval(struct workspace *wk, struct source *src, enum eval_mode mode, obj *res)
 		if (!vm_compile_ast(wk, n, compile_mode, &entry)) {
 			return false;
 		}
+
+		if (cache) {
+			bytecode_cache_store(wk, cache_key, entry, locations_start);
+		}
+	} else {
+		L("using cached bytecode for %s", src->label);
 	}
 
 	if (wk->vm.dbg_state.eval_trace) {
@@ -197,13 +210,20 @@ eval_project_file(struct workspace *wk, const char *path, bool first)
 		return false;
 	}
 
+	if (wk->profile) {
+		profile_push(wk, src.label);
+	}
+
 	obj res;
-	if (!eval(wk, &src, first ? eval_mode_first : eval_mode_default, &res)) {
+	if (!eval(wk, &src, (first ? eval_mode_first : eval_mode_default) | eval_mode_cache, &res)) {
 		goto ret;
 	}
 
 	ret = true;
 ret:
+	if (wk->profile) {
+		profile_pop(wk);
+	}
 	return ret;
 }
 
@@ -7,6 +7,7 @@
 
 #include <string.h>
 
+#include "datastructures/hash.h"
 #include "functions/array.h"
 #include "functions/boolean.h"
 #include "functions/both_libs.h"
@@ -76,8 +77,151 @@ struct func_impl_group func_impl_groups[obj_type_count][language_mode_count] = {
 
 struct func_impl native_funcs[512];
 
+/*
+ * Each group gets a perfect hash table mapping a function name to its index
+ * in the group.  Tables are stored in func_impl_slots, each slot holding the
+ * index + 1 of the function that hashes to it, or 0 if it is empty.
+ *
+ * Tables are built by hash and displace: names are first hashed into a
+ * small number of buckets, and each bucket gets a displacement, stored in
+ * func_impl_disp, that is mixed into the hash of its names to pick their
+ * slots.  Displacements are searched for one bucket at a time, largest
+ * bucket first, so building a table takes roughly linear time.
+ *
+ * A group of n functions uses at most max(4, 4n) slots and max(1, n)
+ * buckets, which bounds the size of both tables by the size of native_funcs
+ * and the number of groups.
+ */
+#define FUNC_IMPL_GROUP_COUNT ((obj_type_count + module_count) * language_mode_count + 1)
+static uint16_t func_impl_slots[4 * (ARRAY_LEN(native_funcs) + FUNC_IMPL_GROUP_COUNT)];
+static uint16_t func_impl_disp[ARRAY_LEN(native_funcs) + FUNC_IMPL_GROUP_COUNT];
+
+// Slots hold the index + 1 of a function within its group.
+STATIC_ASSERT(ARRAY_LEN(native_funcs) < UINT16_MAX);
+
+static uint32_t
+func_impl_hash(const char *name)
+{
+	return (uint32_t)hash_bytes(name, strlen(name));
+}
+
+static uint32_t
+func_impl_mix(uint32_t h, uint32_t disp)
+{
+	h ^= disp * 0x9e3779b9u;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint32_t
+func_impl_bucket(const struct func_impl_group *group, uint32_t h)
+{
+	return (h >> 16) & group->disp_mask;
+}
+
+static bool
+build_func_impl_bucket_try(struct func_impl_group *group,
+	const uint32_t *hashes,
+	const uint16_t *members,
+	uint32_t n,
+	uint32_t disp)
+{
+	uint16_t *slots = &func_impl_slots[group->slots];
+	uint32_t i, j, slot[ARRAY_LEN(native_funcs)];
+
+	for (i = 0; i < n; ++i) {
+		slot[i] = func_impl_mix(hashes[members[i]], disp) & group->mask;
+		if (slots[slot[i]]) {
+			return false;
+		}
+
+		for (j = 0; j < i; ++j) {
+			if (slot[j] == slot[i]) {
+				return false;
+			}
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		slots[slot[i]] = members[i] + 1;
+	}
+
+	return true;
+}
+
+static void
+build_func_impl_group_hash(struct func_impl_group *group, uint32_t *slots_off, uint32_t *disp_off)
+{
+	uint32_t size = 4, nbuckets = 1;
+	while (size < group->len * 2) {
+		size *= 2;
+	}
+	while (nbuckets * 2 < group->len) {
+		nbuckets *= 2;
+	}
+
+	assert(*slots_off + size <= ARRAY_LEN(func_impl_slots));
+	assert(*disp_off + nbuckets <= ARRAY_LEN(func_impl_disp));
+
+	group->slots = *slots_off;
+	group->mask = size - 1;
+	group->disp = *disp_off;
+	group->disp_mask = nbuckets - 1;
+	*slots_off += size;
+	*disp_off += nbuckets;
+
+	uint32_t hashes[ARRAY_LEN(native_funcs)];
+	uint16_t bucket_len[ARRAY_LEN(func_impl_disp)] = { 0 }, members[ARRAY_LEN(native_funcs)];
+	uint32_t i, j, b, n, max_len = 0;
+
+	for (i = 0; i < group->len; ++i) {
+		hashes[i] = func_impl_hash(group->impls[i].name);
+		b = func_impl_bucket(group, hashes[i]);
+		if (++bucket_len[b] > max_len) {
+			max_len = bucket_len[b];
+		}
+	}
+
+	for (; max_len; --max_len) {
+		for (b = 0; b < nbuckets; ++b) {
+			if (bucket_len[b] != max_len) {
+				continue;
+			}
+
+			for (i = 0, n = 0; i < group->len; ++i) {
+				if (func_impl_bucket(group, hashes[i]) != b) {
+					continue;
+				}
+
+				// the first of two functions with the same name wins
+				for (j = 0; j < n; ++j) {
+					if (strcmp(group->impls[members[j]].name, group->impls[i].name) == 0) {
+						break;
+					}
+				}
+
+				if (j == n) {
+					members[n] = i;
+					++n;
+				}
+			}
+
+			uint32_t disp;
+			for (disp = 0; !build_func_impl_bucket_try(group, hashes, members, n, disp); ++disp) {
+				assert(disp < UINT16_MAX && "unable to find a displacement");
+			}
+
+			func_impl_disp[group->disp + b] = disp;
+		}
+	}
+}
+
 static void
-copy_func_impl_group(struct func_impl_group *group, uint32_t *off)
+copy_func_impl_group(struct func_impl_group *group, uint32_t *off, uint32_t *slots_off, uint32_t *disp_off)
 {
 	if (!group->impls) {
 		return;
@@ -89,32 +233,42 @@ copy_func_impl_group(struct func_impl_group *group, uint32_t *off)
 		native_funcs[group->off + group->len] = group->impls[group->len];
 	}
 	*off += group->len;
+
+	build_func_impl_group_hash(group, slots_off, disp_off);
 }
 
 void
 build_func_impl_tables(void)
 {
-	uint32_t off = 0;
+	uint32_t off = 0, slots_off = 0, disp_off = 0;
 	enum module m;
 	enum obj_type t;
 	enum language_mode lang_mode;
 
+	// The tables only depend on the static function tables, so they are
+	// shared by every workspace and only built by the first one.
+	static bool built = false;
+	if (built) {
+		return;
+	}
+	built = true;
+
 	both_libs_build_impl_tbl();
 	python_build_impl_tbl();
 
 	for (t = 0; t < obj_type_count; ++t) {
 		for (lang_mode = 0; lang_mode < language_mode_count; ++lang_mode) {
-			copy_func_impl_group(&func_impl_groups[t][lang_mode], &off);
+			copy_func_impl_group(&func_impl_groups[t][lang_mode], &off, &slots_off, &disp_off);
 		}
 	}
 
 	for (m = 0; m < module_count; ++m) {
 		for (lang_mode = 0; lang_mode < language_mode_count; ++lang_mode) {
-			copy_func_impl_group(&module_func_impl_groups[m][lang_mode], &off);
+			copy_func_impl_group(&module_func_impl_groups[m][lang_mode], &off, &slots_off, &disp_off);
 		}
 	}
 
-	copy_func_impl_group(&az_func_impl_group, &off);
+	copy_func_impl_group(&az_func_impl_group, &off, &slots_off, &disp_off);
 }
 
 /******************************************************************************
@@ -128,15 +282,16 @@ func_lookup_for_mode(const struct func_impl_group *impl_group, const char *name,
 		return false;
 	}
 
-	uint32_t i;
-	for (i = 0; impl_group->impls[i].name; ++i) {
-		if (strcmp(impl_group->impls[i].name, name) == 0) {
-			*idx = impl_group->off + i;
-			return true;
-		}
+	uint32_t h = func_impl_hash(name);
+	uint16_t disp = func_impl_disp[impl_group->disp + func_impl_bucket(impl_group, h)];
+	uint16_t slot = func_impl_slots[impl_group->slots + (func_impl_mix(h, disp) & impl_group->mask)];
+
+	if (!slot || strcmp(impl_group->impls[slot - 1].name, name) != 0) {
+		return false;
 	}
 
-	return false;
+	*idx = impl_group->off + slot - 1;
+	return true;
 }
 
 bool
@@ -26,6 +26,12 @@
 static void *
 get_obj_internal(struct workspace *wk, obj id, enum obj_type type)
 {
+	if (id & OBJ_IMMEDIATE_NUMBER_BIT) {
+		LOG_E("internal type error, expected %s but got an immediate number", obj_type_to_s(type));
+		abort();
+		return NULL;
+	}
+
 	struct obj_internal *o = bucket_arr_get(&wk->vm.objects.objs, id);
 	if (o->t != type) {
 		LOG_E("internal type error, expected %s but got %s", obj_type_to_s(type), obj_type_to_s(o->t));
@@ -83,19 +89,34 @@ get_obj_internal(struct workspace *wk, obj id, enum obj_type type)
 enum obj_type
 get_obj_type(struct workspace *wk, obj id)
 {
+	if (id & OBJ_IMMEDIATE_NUMBER_BIT) {
+		return obj_number;
+	}
+
 	struct obj_internal *o = bucket_arr_get(&wk->vm.objects.objs, id);
 	return o->t;
 }
 
+obj
+make_obj_bool(struct workspace *wk, bool v)
+{
+	return v ? obj_bool_true : obj_bool_false;
+}
+
 bool
 get_obj_bool(struct workspace *wk, obj o)
 {
-	return *(bool *)get_obj_internal(wk, o, obj_bool);
+	get_obj_internal(wk, o, obj_bool);
+	return o == obj_bool_true;
 }
 
 obj
 make_number(struct workspace *wk, int64_t n)
 {
+	if (n >= OBJ_IMMEDIATE_NUMBER_MIN && n <= OBJ_IMMEDIATE_NUMBER_MAX) {
+		return OBJ_IMMEDIATE_NUMBER_BIT | ((uint32_t)n & ~OBJ_IMMEDIATE_NUMBER_BIT);
+	}
+
 	obj o;
 	make_obj(wk, &o, obj_number);
 	set_obj_number(wk, o, n);
@@ -105,18 +126,18 @@ make_number(struct workspace *wk, int64_t n)
 int64_t
 get_obj_number(struct workspace *wk, obj o)
 {
-	return *(int64_t *)get_obj_internal(wk, o, obj_number);
-}
+	if (o & OBJ_IMMEDIATE_NUMBER_BIT) {
+		int64_t n = o & ~OBJ_IMMEDIATE_NUMBER_BIT;
+		return n > OBJ_IMMEDIATE_NUMBER_MAX ? n - (INT64_C(1) << 31) : n;
+	}
 
-void
-set_obj_bool(struct workspace *wk, obj o, bool v)
-{
-	*(bool *)get_obj_internal(wk, o, obj_bool) = v;
+	return *(int64_t *)get_obj_internal(wk, o, obj_number);
 }
 
 void
 set_obj_number(struct workspace *wk, obj o, int64_t v)
 {
+	assert(!(o & OBJ_IMMEDIATE_NUMBER_BIT) && "immediate numbers can't be modified");
 	*(int64_t *)get_obj_internal(wk, o, obj_number) = v;
 }
 
@@ -288,29 +309,126 @@ obj_set_clear_mark(struct workspace *wk, struct obj_clear_mark *mk)
 {
 	wk->vm.objects.obj_clear_mark_set = true;
 	mk->obji = wk->vm.objects.objs.len;
+	mk->array_elems_len = wk->vm.objects.array_elems.len;
+	mk->dict_elems_len = wk->vm.objects.dict_elems.len;
+	mk->dict_hashes_len = wk->vm.objects.dict_hashes.len;
+	mk->prev_clear_mark_obji = wk->vm.objects.clear_mark_obji;
+	mk->array_elems_pinned = wk->vm.objects.array_elems_pinned;
+	mk->dict_elems_pinned = wk->vm.objects.dict_elems_pinned;
+	mk->dict_hashes_pinned = wk->vm.objects.dict_hashes_pinned;
+	wk->vm.objects.clear_mark_obji = mk->obji;
 
 	bucket_arr_save(&wk->vm.objects.chrs, &mk->chrs);
 	bucket_arr_save(&wk->vm.objects.objs, &mk->objs);
+	bucket_arr_save(&wk->vm.objects.dict_elems, &mk->dict_elems);
+	bucket_arr_save(&wk->vm.objects.dict_hashes, &mk->dict_hashes);
 	uint32_t i;
 	for (i = 0; i < obj_type_count - _obj_aos_start; ++i) {
 		bucket_arr_save(&wk->vm.objects.obj_aos[i], &mk->obj_aos[i]);
 	}
 }
 
+static uint64_t
+obj_used_bytes(struct vm_objects *objects)
+{
+	uint64_t bytes = (uint64_t)objects->objs.len * objects->objs.item_size + objects->chrs.len
+			 + (uint64_t)objects->dict_elems.len * objects->dict_elems.item_size
+			 + (uint64_t)objects->dict_hashes.len * objects->dict_hashes.item_size
+			 + (uint64_t)objects->array_elems.len * sizeof(obj);
+
+	uint32_t i;
+	for (i = 0; i < obj_type_count - _obj_aos_start; ++i) {
+		bytes += (uint64_t)objects->obj_aos[i].len * objects->obj_aos[i].item_size;
+	}
+
+	return bytes;
+}
+
+#ifndef NDEBUG
+static bool
+obj_clear_mark_check_obj(const struct obj_clear_mark *mk, obj v)
+{
+	return (v & OBJ_IMMEDIATE_NUMBER_BIT) || v < mk->obji;
+}
+
+static enum iteration_result
+obj_clear_mark_check_array_iter(struct workspace *wk, void *_ctx, obj v)
+{
+	const struct obj_clear_mark *mk = _ctx;
+	assert(obj_clear_mark_check_obj(mk, v) && "container outlives a clear mark but references an object after it");
+	return ir_cont;
+}
+
+static enum iteration_result
+obj_clear_mark_check_dict_iter(struct workspace *wk, void *_ctx, obj k, obj v)
+{
+	const struct obj_clear_mark *mk = _ctx;
+	assert(obj_clear_mark_check_obj(mk, k) && obj_clear_mark_check_obj(mk, v)
+		&& "container outlives a clear mark but references an object after it");
+	return ir_cont;
+}
+
+static enum iteration_result
+obj_clear_mark_check_array_iter_dict_int(struct workspace *wk, void *_ctx, obj k, obj v)
+{
+	return obj_clear_mark_check_array_iter(wk, _ctx, v);
+}
+
+static void
+obj_clear_mark_check_containers(struct workspace *wk, const struct obj_clear_mark *mk)
+{
+	struct arr *stores = &wk->vm.objects.clear_mark_stores;
+	uint32_t i;
+	for (i = 0; i < stores->len; ++i) {
+		obj c = *(obj *)arr_get(stores, i);
+		if (c >= mk->obji) {
+			continue;
+		}
+
+		if (get_obj_type(wk, c) == obj_array) {
+			obj_array_foreach(wk, c, (void *)mk, obj_clear_mark_check_array_iter);
+		} else if (get_obj_dict(wk, c)->flags & obj_dict_flag_int_key) {
+			obj_dict_foreach(wk, c, (void *)mk, obj_clear_mark_check_array_iter_dict_int);
+		} else {
+			obj_dict_foreach(wk, c, (void *)mk, obj_clear_mark_check_dict_iter);
+		}
+	}
+
+	if (!mk->prev_clear_mark_obji) {
+		stores->len = 0;
+	}
+}
+#endif
+
 void
 obj_clear(struct workspace *wk, const struct obj_clear_mark *mk)
 {
+	struct vm_objects *objects = &wk->vm.objects;
+	uint64_t used = obj_used_bytes(objects);
+
+#ifndef NDEBUG
+	obj_clear_mark_check_containers(wk, mk);
+#endif
+
 	struct obj_internal *o;
 	struct str *ss;
+	struct obj_dict *d;
 	uint32_t i;
-	for (i = mk->obji; i < wk->vm.objects.objs.len; ++i) {
-		o = bucket_arr_get(&wk->vm.objects.objs, i);
+	for (i = mk->obji; i < objects->objs.len; ++i) {
+		o = bucket_arr_get(&objects->objs, i);
 		if (o->t == obj_string) {
-			ss = bucket_arr_get(&wk->vm.objects.obj_aos[obj_string - _obj_aos_start], o->val);
+			ss = bucket_arr_get(&objects->obj_aos[obj_string - _obj_aos_start], o->val);
 
 			if (ss->flags & str_flag_big) {
+				used += ss->len;
 				z_free((void *)ss->s);
 			}
+		} else if (o->t == obj_dict) {
+			d = bucket_arr_get(&objects->obj_aos[obj_dict - _obj_aos_start], o->val);
+
+			if (d->flags & obj_dict_flag_big) {
+				hash_destroy(bucket_arr_get(&objects->dict_hashes, d->data));
+			}
 		}
 	}
 
@@ -320,6 +438,43 @@ obj_clear(struct workspace *wk, const struct obj_clear_mark *mk)
 	for (i = 0; i < obj_type_count - _obj_aos_start; ++i) {
 		bucket_arr_restore(&wk->vm.objects.obj_aos[i], &mk->obj_aos[i]);
 	}
+
+	// Array and dict elements allocated after the mark can only be released
+	// if none of them belong to a container that survives the clear.
+	if (objects->array_elems_pinned <= mk->array_elems_len && mk->array_elems_len < objects->array_elems.len) {
+		objects->array_elems.len = mk->array_elems_len;
+	}
+	if (objects->dict_elems_pinned <= mk->dict_elems_len) {
+		bucket_arr_restore(&objects->dict_elems, &mk->dict_elems);
+	}
+	if (objects->dict_hashes_pinned <= mk->dict_hashes_len) {
+		bucket_arr_restore(&objects->dict_hashes, &mk->dict_hashes);
+	}
+
+	// Ids of the cleared objects will be handed out again.
+	memset(wk->vm.owned_strs, 0, sizeof(wk->vm.owned_strs));
+
+	objects->clear_mark_obji = mk->prev_clear_mark_obji;
+	if (!objects->clear_mark_obji) {
+		// Strings interned from here on can no longer be cleared out from
+		// under the str_hash.
+		objects->obj_clear_mark_set = false;
+
+		// Pins only matter while a mark is active.  Those set inside a nested
+		// mark may still protect containers of the enclosing mark, so they
+		// are only dropped once the outermost mark is cleared.
+		objects->array_elems_pinned = mk->array_elems_pinned;
+		objects->dict_elems_pinned = mk->dict_elems_pinned;
+		objects->dict_hashes_pinned = mk->dict_hashes_pinned;
+	}
+
+	objects->reclaimed_bytes += used - obj_used_bytes(objects);
+#ifdef TRACY_ENABLE
+	if (wk->tracy.is_master_workspace) {
+		TracyCPlot("reclaimed memory (mb)", (double)objects->reclaimed_bytes / 1048576.0);
+		TracyCPlot("objects", objects->objs.len);
+	}
+#endif
 }
 
 static struct {
@@ -554,27 +709,109 @@ obj_equal(struct workspace *wk, obj left, obj right)
  * arrays
  */
 
-bool
-obj_array_foreach(struct workspace *wk, obj arr, void *ctx, obj_array_iterator cb)
+/*
+ * Array elements live in wk->vm.objects.array_elems, a single pool shared by
+ * all arrays.  Each array owns the range [data, data + cap) of the pool.
+ * Arrays grow in place if their range is at the end of the pool, and
+ * otherwise move to a new range at the end of the pool.  The old range is
+ * simply abandoned, like every other object in the vm.
+ *
+ * obj_array_dup and obj_array_tail share the source array's elements and mark
+ * both arrays copy-on-write; the first mutation of either array gives it a
+ * private copy.
+ */
+
+/*
+ * Everything created after a clear mark is released by obj_clear, so a
+ * container that outlives the mark must not be left referencing it.  Such
+ * stores are fine as long as they are undone before the clear, e.g. a push
+ * followed by a pop, so the containers are only remembered here and checked
+ * by obj_clear_mark_check_containers.
+ */
+static void
+obj_clear_mark_check_store(struct workspace *wk, obj container, obj v)
+{
+#ifndef NDEBUG
+	struct vm_objects *objects = &wk->vm.objects;
+	uint32_t mark = objects->clear_mark_obji;
+
+	if (!mark || container >= mark || (v & OBJ_IMMEDIATE_NUMBER_BIT) || v < mark) {
+		return;
+	}
+
+	struct arr *stores = &objects->clear_mark_stores;
+	if (stores->len && *(obj *)arr_get(stores, stores->len - 1) == container) {
+		return;
+	}
+
+	arr_push(stores, &container);
+#else
+	(void)wk;
+	(void)container;
+	(void)v;
+#endif
+}
+
+static void
+obj_array_reserve(struct workspace *wk, obj arr, uint32_t need)
 {
+	struct vm_objects *objects = &wk->vm.objects;
 	struct obj_array *a = get_obj_array(wk, arr);
+	uint32_t cap = a->cap;
 
-	if (!a->len) {
-		return true;
+	if (!(a->flags & obj_array_flag_cow)) {
+		if (need <= a->cap) {
+			return;
+		}
+
+		if (a->cap && a->data + a->cap == objects->array_elems.len) {
+			cap = a->cap * 2 > need ? a->cap * 2 : need;
+			arr_grow_by(&objects->array_elems, cap - a->cap);
+			a->cap = cap;
+			goto allocated;
+		}
 	}
 
-	while (true) {
-		switch (cb(wk, ctx, a->val)) {
+	if (need > cap) {
+		cap = cap * 2 > need ? cap * 2 : need;
+	}
+
+	if (cap < 4) {
+		cap = 4;
+	}
+
+	uint32_t data = objects->array_elems.len;
+	arr_grow_by(&objects->array_elems, cap);
+
+	if (a->len) {
+		obj *elems = (obj *)objects->array_elems.e;
+		memcpy(&elems[data], &elems[a->data], a->len * sizeof(obj));
+	}
+
+	a->data = data;
+	a->cap = cap;
+	a->flags &= ~obj_array_flag_cow;
+
+allocated:
+	if (arr < objects->clear_mark_obji && objects->array_elems.len > objects->array_elems_pinned) {
+		objects->array_elems_pinned = objects->array_elems.len;
+	}
+}
+
+bool
+obj_array_foreach(struct workspace *wk, obj arr, void *ctx, obj_array_iterator cb)
+{
+	struct obj_array *a = get_obj_array(wk, arr);
+	uint32_t i;
+
+	// a->len and the pool are reloaded on every iteration since cb may
+	// modify them
+	for (i = 0; i < a->len; ++i) {
+		switch (cb(wk, ctx, obj_array_elem(wk, a, i))) {
 		case ir_cont: break;
 		case ir_done: return true;
 		case ir_err: return false;
 		}
-
-		if (!a->have_next) {
-			break;
-		}
-
-		a = get_obj_array(wk, a->next);
 	}
 
 	return true;
@@ -621,29 +858,12 @@ obj_array_foreach_flat(struct workspace *wk, obj arr, void *usr_ctx, obj_array_i
 void
 obj_array_push(struct workspace *wk, obj arr, obj child)
 {
-	obj child_arr;
-	struct obj_array *a, *tail, *c;
-
-	if (!(a = get_obj_array(wk, arr))->len) {
-		a->tail = arr;
-		a->len = 1;
-		a->val = child;
-		a->have_next = false;
-		return;
-	}
-
-	make_obj(wk, &child_arr, obj_array);
-	c = get_obj_array(wk, child_arr);
-	c->val = child;
-
-	a = get_obj_array(wk, arr);
-	tail = get_obj_array(wk, a->tail);
-	assert(!tail->have_next);
+	struct obj_array *a = get_obj_array(wk, arr);
 
-	tail->have_next = true;
-	tail->next = child_arr;
+	obj_clear_mark_check_store(wk, arr, child);
 
-	a->tail = child_arr;
+	obj_array_reserve(wk, arr, a->len + 1);
+	obj_array_elem(wk, a, a->len) = child;
 	++a->len;
 }
 
@@ -657,34 +877,21 @@ obj_array_prepend(struct workspace *wk, obj *arr, obj val)
 	*arr = prepend;
 }
 
-struct obj_array_index_of_iter_ctx {
-	obj l;
-	bool res;
-	uint32_t i;
-};
-
-static enum iteration_result
-obj_array_index_of_iter(struct workspace *wk, void *_ctx, obj v)
-{
-	struct obj_array_index_of_iter_ctx *ctx = _ctx;
-
-	if (obj_equal(wk, ctx->l, v)) {
-		ctx->res = true;
-		return ir_done;
-	}
-
-	++ctx->i;
-	return ir_cont;
-}
-
 bool
 obj_array_index_of(struct workspace *wk, obj arr, obj val, uint32_t *idx)
 {
-	struct obj_array_index_of_iter_ctx ctx = { .l = val };
-	obj_array_foreach(wk, arr, &ctx, obj_array_index_of_iter);
+	struct obj_array *a = get_obj_array(wk, arr);
+	uint32_t i;
+
+	for (i = 0; i < a->len; ++i) {
+		if (obj_equal(wk, val, obj_array_elem(wk, a, i))) {
+			*idx = i;
+			return true;
+		}
+	}
 
-	*idx = ctx.i;
-	return ctx.res;
+	*idx = i;
+	return false;
 }
 
 bool
@@ -694,89 +901,73 @@ obj_array_in(struct workspace *wk, obj arr, obj val)
 	return obj_array_index_of(wk, arr, val, &_);
 }
 
-struct obj_array_index_iter_ctx {
-	obj res, i, tgt;
-};
-
-static enum iteration_result
-obj_array_index_iter(struct workspace *wk, void *_ctx, obj v)
-{
-	struct obj_array_index_iter_ctx *ctx = _ctx;
-
-	if (ctx->i == ctx->tgt) {
-		ctx->res = v;
-		return ir_done;
-	}
-
-	++ctx->i;
-	return ir_cont;
-}
-
 void
 obj_array_index(struct workspace *wk, obj arr, int64_t i, obj *res)
 {
-	struct obj_array_index_iter_ctx ctx = { .tgt = i };
-	assert(i >= 0 && i < get_obj_array(wk, arr)->len);
-	obj_array_foreach(wk, arr, &ctx, obj_array_index_iter);
-	*res = ctx.res;
+	struct obj_array *a = get_obj_array(wk, arr);
+	assert(i >= 0 && i < a->len);
+	*res = obj_array_elem(wk, a, i);
 }
 
 obj
 obj_array_get_tail(struct workspace *wk, obj arr)
 {
-	return get_obj_array(wk, get_obj_array(wk, arr)->tail)->val;
-}
+	struct obj_array *a = get_obj_array(wk, arr);
 
-struct obj_array_dup_ctx {
-	obj *arr;
-};
+	if (!a->len) {
+		return 0;
+	}
 
-static enum iteration_result
-obj_array_dup_iter(struct workspace *wk, void *_ctx, obj v)
-{
-	struct obj_array_dup_ctx *ctx = _ctx;
-	obj_array_push(wk, *ctx->arr, v);
-	return ir_cont;
+	return obj_array_elem(wk, a, a->len - 1);
 }
 
 void
 obj_array_dup(struct workspace *wk, obj arr, obj *res)
 {
-	struct obj_array_dup_ctx ctx = { .arr = res };
 	make_obj(wk, res, obj_array);
-	obj_array_foreach(wk, arr, &ctx, obj_array_dup_iter);
+
+	struct obj_array *a = get_obj_array(wk, arr), *d = get_obj_array(wk, *res);
+
+	if (!a->len) {
+		return;
+	}
+
+	a->flags |= obj_array_flag_cow;
+	*d = (struct obj_array){
+		.data = a->data,
+		.len = a->len,
+		.cap = a->len,
+		.flags = obj_array_flag_cow,
+	};
 }
 
 void
 obj_array_extend_nodup(struct workspace *wk, obj arr, obj arr2)
 {
-	struct obj_array *a, *b, *tail;
+	struct obj_array *a = get_obj_array(wk, arr), *b = get_obj_array(wk, arr2);
+	uint32_t len = b->len;
 
-	if (!(b = get_obj_array(wk, arr2))->len) {
+	if (!len) {
 		return;
 	}
 
-	if (!(a = get_obj_array(wk, arr))->len) {
-		struct obj_array_dup_ctx ctx = { .arr = &arr };
-		obj_array_foreach(wk, arr2, &ctx, obj_array_dup_iter);
-		return;
+	if (wk->vm.objects.clear_mark_obji && arr < wk->vm.objects.clear_mark_obji) {
+		uint32_t i;
+		for (i = 0; i < len; ++i) {
+			obj_clear_mark_check_store(wk, arr, obj_array_elem(wk, b, i));
+		}
 	}
 
-	tail = get_obj_array(wk, a->tail);
-	assert(!tail->have_next);
-	tail->have_next = true;
-	tail->next = arr2;
-
-	a->tail = b->tail;
-	a->len += b->len;
+	obj_array_reserve(wk, arr, a->len + len);
+	memcpy(&obj_array_elem(wk, a, a->len), &obj_array_elem(wk, b, 0), len * sizeof(obj));
+	a->len += len;
 }
 
 void
 obj_array_extend(struct workspace *wk, obj arr, obj arr2)
 {
-	obj dup;
-	obj_array_dup(wk, arr2, &dup);
-	obj_array_extend_nodup(wk, arr, dup);
+	// elements are copied either way, so there is no need to dup arr2
+	obj_array_extend_nodup(wk, arr, arr2);
 }
 
 struct obj_array_join_ctx {
@@ -849,84 +1040,44 @@ obj_array_join(struct workspace *wk, bool flat, obj arr, obj join, obj *res)
 void
 obj_array_tail(struct workspace *wk, obj arr, obj *res)
 {
-	const struct obj_array *a = get_obj_array(wk, arr);
+	make_obj(wk, res, obj_array);
 
-	if (a->have_next) {
-		struct obj_array *n = get_obj_array(wk, a->next);
-		n->tail = a->tail;
-		n->len = a->len;
-		*res = a->next;
-	} else {
-		// the tail of a zero or single element array is an empty array
-		make_obj(wk, res, obj_array);
+	struct obj_array *a = get_obj_array(wk, arr), *t = get_obj_array(wk, *res);
+
+	// the tail of a zero or single element array is an empty array
+	if (a->len <= 1) {
+		return;
 	}
+
+	a->flags |= obj_array_flag_cow;
+	*t = (struct obj_array){
+		.data = a->data + 1,
+		.len = a->len - 1,
+		.cap = a->len - 1,
+		.flags = obj_array_flag_cow,
+	};
 }
 
 void
 obj_array_set(struct workspace *wk, obj arr, int64_t i, obj v)
 {
-	assert(i >= 0 && i < get_obj_array(wk, arr)->len);
-
-	uint32_t j = 0;
-
-	while (true) {
-		if (j == i) {
-			get_obj_array(wk, arr)->val = v;
-			return;
-		}
-
-		assert(get_obj_array(wk, arr)->have_next);
-		arr = get_obj_array(wk, arr)->next;
-		++j;
-	}
+	struct obj_array *a = get_obj_array(wk, arr);
+	assert(i >= 0 && i < a->len);
+	obj_clear_mark_check_store(wk, arr, v);
 
-	assert(false && "unreachable");
+	obj_array_reserve(wk, arr, a->len);
+	obj_array_elem(wk, a, i) = v;
 }
 
 void
 obj_array_del(struct workspace *wk, obj arr, int64_t i)
 {
-	uint32_t j = 0;
-	obj p = arr;
-	struct obj_array *head = get_obj_array(wk, arr), *prev, *next, *del;
-
-	assert(i >= 0 && i < head->len);
-
-	if (i == 0) {
-		if (head->have_next) {
-			next = get_obj_array(wk, head->next);
-			next->len = head->len - 1;
-			next->tail = head->tail;
-			*head = *next;
-		} else {
-			*head = (struct obj_array){ 0 };
-		}
-
-		return;
-	}
-
-	while (true) {
-		if (j == i) {
-			del = get_obj_array(wk, arr);
-			break;
-		}
-
-		p = arr;
-		assert(get_obj_array(wk, arr)->have_next);
-		arr = get_obj_array(wk, arr)->next;
-		++j;
-	}
-
-	prev = get_obj_array(wk, p);
-
-	if (del->have_next) {
-		prev->next = del->next;
-	} else {
-		head->tail = p;
-		prev->have_next = false;
-	}
+	struct obj_array *a = get_obj_array(wk, arr);
+	assert(i >= 0 && i < a->len);
 
-	--head->len;
+	obj_array_reserve(wk, arr, a->len);
+	memmove(&obj_array_elem(wk, a, i), &obj_array_elem(wk, a, i + 1), (a->len - i - 1) * sizeof(obj));
+	--a->len;
 }
 
 obj
@@ -1004,14 +1155,6 @@ obj_array_sort_by_str(struct workspace *wk, void *_ctx, obj a, obj b)
 	return memcmp(sa->s, sb->s, min);
 }
 
-static enum iteration_result
-obj_array_sort_push_to_da_iter(struct workspace *wk, void *_ctx, obj v)
-{
-	struct arr *da = _ctx;
-	arr_push(da, &v);
-	return ir_cont;
-}
-
 struct obj_array_sort_ctx {
 	struct workspace *wk;
 	void *usr_ctx;
@@ -1038,7 +1181,8 @@ obj_array_sort(struct workspace *wk, void *usr_ctx, obj arr, obj_array_sort_func
 
 	struct arr da;
 	arr_init(&da, len, sizeof(obj));
-	obj_array_foreach(wk, arr, &da, obj_array_sort_push_to_da_iter);
+	arr_grow_to(&da, len);
+	memcpy(da.e, &obj_array_elem(wk, get_obj_array(wk, arr), 0), len * sizeof(obj));
 
 	struct obj_array_sort_ctx ctx = {
 		.wk = wk,
@@ -1050,37 +1194,14 @@ obj_array_sort(struct workspace *wk, void *usr_ctx, obj arr, obj_array_sort_func
 
 	make_obj(wk, res, obj_array);
 
-	uint32_t i;
-	for (i = 0; i < da.len; ++i) {
-		obj_array_push(wk, *res, *(obj *)arr_get(&da, i));
-	}
+	struct obj_array *r = get_obj_array(wk, *res);
+	obj_array_reserve(wk, *res, len);
+	memcpy(&obj_array_elem(wk, r, 0), da.e, len * sizeof(obj));
+	r->len = len;
 
 	arr_destroy(&da);
 }
 
-struct obj_array_slice_ctx {
-	int64_t i, i0, i1;
-	obj res;
-};
-
-static enum iteration_result
-obj_array_slice_iter(struct workspace *wk, void *_ctx, obj v)
-{
-	struct obj_array_slice_ctx *ctx = _ctx;
-
-	if (ctx->i >= ctx->i0) {
-		obj_array_push(wk, ctx->res, v);
-	}
-
-	++ctx->i;
-
-	if (ctx->i > ctx->i1) {
-		return ir_done;
-	}
-
-	return ir_cont;
-}
-
 obj
 obj_array_slice(struct workspace *wk, obj a, int64_t i0, int64_t i1)
 {
@@ -1089,16 +1210,21 @@ obj_array_slice(struct workspace *wk, obj a, int64_t i0, int64_t i1)
 		assert(false && "index out of bounds");
 	}
 
-	struct obj_array_slice_ctx ctx = {
-		.i0 = i0,
-		.i1 = i1,
-	};
+	obj res;
+	make_obj(wk, &res, obj_array);
 
-	make_obj(wk, &ctx.res, obj_array);
+	if (i0 > i1) {
+		return res;
+	}
 
-	obj_array_foreach(wk, a, &ctx, obj_array_slice_iter);
+	// i1 is inclusive
+	uint32_t len = i1 - i0 + 1;
+	struct obj_array *r = get_obj_array(wk, res);
+	obj_array_reserve(wk, res, len);
+	memcpy(&obj_array_elem(wk, r, 0), &obj_array_elem(wk, arr, i0), len * sizeof(obj));
+	r->len = len;
 
-	return ctx.res;
+	return res;
 }
 
 /*
@@ -1115,10 +1241,9 @@ obj_dict_foreach(struct workspace *wk, obj dict, void *ctx, obj_dict_iterator cb
 
 	if (d->flags & obj_dict_flag_big) {
 		uint32_t i;
+		uint64_t *_val;
 		struct hash *h = bucket_arr_get(&wk->vm.objects.dict_hashes, d->data);
-		for (i = 0; i < h->keys.len; ++i) {
-			void *_key = arr_get(&h->keys, i);
-			uint64_t *_val = hash_get(h, _key);
+		for (i = 0; (_val = hash_next_at(h, &i)); ++i) {
 			obj key = *_val >> 32;
 			obj val = *_val & 0xffffffff;
 
@@ -1297,6 +1422,21 @@ obj_dict_in(struct workspace *wk, obj dict, obj key)
 	return obj_dict_index(wk, dict, key, &res);
 }
 
+static void
+obj_dict_pin(struct workspace *wk, obj dict)
+{
+	struct vm_objects *objects = &wk->vm.objects;
+
+	if (dict < objects->clear_mark_obji) {
+		if (objects->dict_elems.len > objects->dict_elems_pinned) {
+			objects->dict_elems_pinned = objects->dict_elems.len;
+		}
+		if (objects->dict_hashes.len > objects->dict_hashes_pinned) {
+			objects->dict_hashes_pinned = objects->dict_hashes.len;
+		}
+	}
+}
+
 static void
 _obj_dict_set(struct workspace *wk,
 	obj dict,
@@ -1308,14 +1448,16 @@ _obj_dict_set(struct workspace *wk,
 	struct obj_dict *d = get_obj_dict(wk, dict);
 
 	assert(key);
+	obj_clear_mark_check_store(wk, dict, val);
 
 	/* empty dict */
-	if (!d->len) {
+	if (!d->len && !(d->flags & obj_dict_flag_big)) {
 		uint32_t e_idx = wk->vm.objects.dict_elems.len;
 		bucket_arr_push(&wk->vm.objects.dict_elems, &(struct obj_dict_elem){ .key = key, .val = val });
 		d->data = e_idx;
 		d->tail = e_idx;
 		++d->len;
+		obj_dict_pin(wk, dict);
 		return;
 	}
 
@@ -1335,7 +1477,7 @@ _obj_dict_set(struct workspace *wk,
 			uint64_t uv = ((uint64_t)(e->key) << 32) | e->val;
 
 			if (d->flags & obj_dict_flag_int_key) {
-				hash_set(h, &key, uv);
+				hash_set(h, &e->key, uv);
 			} else {
 				const struct str *ss = get_str(wk, e->key);
 				/* LO("setting %s, %d to %ld, (%o=%o)\n", ss->s, ss->len, uv, (obj)(uv
@@ -1349,6 +1491,7 @@ _obj_dict_set(struct workspace *wk,
 			e = bucket_arr_get(&wk->vm.objects.dict_elems, e->next);
 		}
 		d->flags |= obj_dict_flag_big;
+		obj_dict_pin(wk, dict);
 	}
 
 	uint64_t *ur;
@@ -1366,7 +1509,7 @@ _obj_dict_set(struct workspace *wk,
 	if ((d->flags & obj_dict_flag_big)) {
 		struct hash *h = bucket_arr_get(&wk->vm.objects.dict_hashes, d->data);
 		if (d->flags & obj_dict_flag_int_key) {
-			hash_set(h, &key, val);
+			hash_set(h, &key, ((uint64_t)key << 32) | val);
 		} else {
 			const struct str *ss = get_str(wk, key);
 			hash_set_strn(h, ss->s, ss->len, ((uint64_t)key << 32) | val);
@@ -1385,6 +1528,7 @@ _obj_dict_set(struct workspace *wk,
 
 		d->tail = e_idx;
 		++d->len;
+		obj_dict_pin(wk, dict);
 	}
 }
 
@@ -1394,6 +1538,7 @@ obj_dict_set(struct workspace *wk, obj dict, obj key, obj val)
 	union obj_dict_key_comparison_key k = {
 		.string = *get_str(wk, key),
 	};
+	obj_clear_mark_check_store(wk, dict, key);
 	_obj_dict_set(wk, dict, &k, obj_dict_key_comparison_func_string, key, val);
 }
 
@@ -1414,6 +1559,7 @@ _obj_dict_del(struct workspace *wk, obj dict, union obj_dict_key_comparison_key
 			hash_unset_strn(h, key->string.s, key->string.len);
 		}
 
+		d->len = h->len;
 		return;
 	}
 
@@ -1579,7 +1725,10 @@ obj_clone_dict_iter(struct workspace *wk_src, void *_ctx, obj key, obj val)
 bool
 obj_clone(struct workspace *wk_src, struct workspace *wk_dest, obj val, obj *ret)
 {
-	if (val >= wk_src->vm.objects.objs.len) {
+	if (val & OBJ_IMMEDIATE_NUMBER_BIT) {
+		*ret = val;
+		return true;
+	} else if (val >= wk_src->vm.objects.objs.len) {
 		LOG_E("invalid object");
 		return false;
 	}
@@ -1589,14 +1738,8 @@ obj_clone(struct workspace *wk_src, struct workspace *wk_dest, obj val, obj *ret
 
 	switch (t) {
 	case obj_null: *ret = 0; return true;
-	case obj_number:
-		make_obj(wk_dest, ret, t);
-		set_obj_number(wk_dest, *ret, get_obj_number(wk_src, val));
-		return true;
-	case obj_bool:
-		make_obj(wk_dest, ret, t);
-		set_obj_bool(wk_dest, *ret, get_obj_bool(wk_src, val));
-		return true;
+	case obj_number: *ret = make_number(wk_dest, get_obj_number(wk_src, val)); return true;
+	case obj_bool: *ret = make_obj_bool(wk_dest, get_obj_bool(wk_src, val)); return true;
 	case obj_string: {
 		*ret = str_clone(wk_src, wk_dest, val);
 		return true;
@@ -8,35 +8,43 @@
 #include "lang/object_iterators.h"
 #include "lang/workspace.h"
 
+static obj
+obj_array_flat_iter_take(struct workspace *wk, struct obj_array_flat_iter_pos *pos)
+{
+	if (pos->i >= pos->a->len) {
+		return 0;
+	}
+
+	return obj_array_elem(wk, pos->a, pos->i++);
+}
+
 obj
 obj_array_flat_iter_next(struct workspace *wk, obj arr, struct obj_array_flat_iter_ctx *ctx)
 {
 	obj v = 0;
 
 	if (!ctx->init) {
-		ctx->a = get_obj_array(wk, arr);
+		ctx->pos = (struct obj_array_flat_iter_pos){ .a = get_obj_array(wk, arr) };
 		ctx->pushed = 0;
 		ctx->init = true;
 	}
 
-	while (ctx->a && !v) {
-		v = ctx->a->val;
+	while (ctx->pos.a && !v) {
+		v = obj_array_flat_iter_take(wk, &ctx->pos);
 
 		while (get_obj_type(wk, v) == obj_array) {
-			stack_push(&wk->stack, ctx->a, get_obj_array(wk, v));
+			stack_push(&wk->stack, ctx->pos, ((struct obj_array_flat_iter_pos){ .a = get_obj_array(wk, v) }));
 			++ctx->pushed;
-			v = ctx->a->val;
+			v = obj_array_flat_iter_take(wk, &ctx->pos);
 		}
 
-		while (!ctx->a->have_next && ctx->pushed) {
-			stack_pop(&wk->stack, ctx->a);
+		while (ctx->pos.i >= ctx->pos.a->len && ctx->pushed) {
+			stack_pop(&wk->stack, ctx->pos);
 			--ctx->pushed;
 		}
 
-		if (ctx->a->have_next) {
-			ctx->a = get_obj_array(wk, ctx->a->next);
-		} else {
-			ctx->a = 0;
+		if (ctx->pos.i >= ctx->pos.a->len) {
+			ctx->pos.a = 0;
 		}
 	}
 
@@ -47,7 +55,7 @@ void
 obj_array_flat_iter_end(struct workspace *wk, struct obj_array_flat_iter_ctx *ctx)
 {
 	while (ctx->pushed) {
-		stack_pop(&wk->stack, ctx->a);
+		stack_pop(&wk->stack, ctx->pos);
 		--ctx->pushed;
 	}
 }
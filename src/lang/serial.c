@@ -5,459 +5,545 @@
 
 #include "compat.h"
 
+#include <stddef.h>
 #include <string.h>
 
 #include "backend/output.h"
 #include "buf_size.h"
+#include "error.h"
+#include "lang/object_iterators.h"
 #include "lang/serial.h"
 #include "lang/workspace.h"
 #include "log.h"
+#include "platform/assert.h"
 #include "platform/filesystem.h"
 #include "platform/mem.h"
 #include "platform/path.h"
 
+/*
+ * Serial dump format
+ *
+ * A dump is a header followed by two sections: a list of object records made
+ * of 32-bit words, and a blob holding the bytes of every string, each
+ * followed by a NUL.  Nothing in a dump is a pointer or an object id of the
+ * workspace that wrote it, records refer to each other by index and to string
+ * data by offset, so a dump is loaded with a single read and no fixups.
+ *
+ * Records are written children first, so every record only refers to records
+ * before it and can be turned into an object as soon as it is reached.  A
+ * reference is 0 for null, an immediate number as is, or a record index + 1.
+ *
+ * The blob is handed over to the loading workspace and strings point into it
+ * directly instead of being copied.  Strings without str_flag_mutable are
+ * copied before they are modified, so the blob is never written to.
+ */
+
 #define SERIAL_MAGIC_LEN 8
 static const char serial_magic[SERIAL_MAGIC_LEN + 1] = "muondump";
-static const uint32_t serial_version = 7;
+static const uint32_t serial_version = 10;
 
-static bool
-corrupted_dump(void)
-{
-	LOG_E("unable to load corrupted serial dump");
-	return false;
-}
+struct serial_header {
+	char magic[SERIAL_MAGIC_LEN];
+	uint32_t version, root, words_len, records_len;
+	uint64_t blob_len;
+};
 
-static bool
-dump_uint32(uint32_t v, FILE *f)
+/* Objects that are stored as their struct, with the obj fields listed here
+ * holding references.  Any other field is stored as is.
+ */
+static const struct serial_struct_type {
+	uint32_t size;
+	uint8_t fields[9], fields_len;
+} serial_struct_types[obj_type_count] = {
+	[obj_test] = { sizeof(struct obj_test),
+		{ offsetof(struct obj_test, name),
+			offsetof(struct obj_test, exe),
+			offsetof(struct obj_test, args),
+			offsetof(struct obj_test, env),
+			offsetof(struct obj_test, suites),
+			offsetof(struct obj_test, workdir),
+			offsetof(struct obj_test, depends),
+			offsetof(struct obj_test, timeout),
+			offsetof(struct obj_test, priority) },
+		9 },
+	[obj_install_target] = { sizeof(struct obj_install_target),
+		{ offsetof(struct obj_install_target, src),
+			offsetof(struct obj_install_target, dest),
+			offsetof(struct obj_install_target, exclude_directories),
+			offsetof(struct obj_install_target, exclude_files) },
+		4 },
+	[obj_environment] = { sizeof(struct obj_environment), { offsetof(struct obj_environment, actions) }, 1 },
+	[obj_option] = { sizeof(struct obj_option),
+		{ offsetof(struct obj_option, name),
+			offsetof(struct obj_option, val),
+			offsetof(struct obj_option, choices),
+			offsetof(struct obj_option, max),
+			offsetof(struct obj_option, min),
+			offsetof(struct obj_option, deprecated),
+			offsetof(struct obj_option, description) },
+		7 },
+	[obj_configuration_data]
+	= { sizeof(struct obj_configuration_data), { offsetof(struct obj_configuration_data, dict) }, 1 },
+	[obj_run_result] = { sizeof(struct obj_run_result),
+		{ offsetof(struct obj_run_result, out), offsetof(struct obj_run_result, err) },
+		2 },
+};
+
+static void *
+serial_struct_get(struct workspace *wk, obj o, enum obj_type t)
 {
-	return fs_fwrite(&v, sizeof(uint32_t), f);
+	switch (t) {
+	case obj_test: return get_obj_test(wk, o);
+	case obj_install_target: return get_obj_install_target(wk, o);
+	case obj_environment: return get_obj_environment(wk, o);
+	case obj_option: return get_obj_option(wk, o);
+	case obj_configuration_data: return get_obj_configuration_data(wk, o);
+	case obj_run_result: return get_obj_run_result(wk, o);
+	default: UNREACHABLE_RETURN;
+	}
 }
 
-static bool
-dump_uint64(uint64_t v, FILE *f)
+static uint32_t
+serial_struct_words(const struct serial_struct_type *st)
 {
-	return fs_fwrite(&v, sizeof(uint64_t), f);
+	return (st->size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
 }
 
 static bool
-load_uint32(uint32_t *v, FILE *f)
+corrupted_dump(void)
 {
-	return fs_fread(v, sizeof(uint32_t), f);
+	LOG_E("unable to load corrupted serial dump");
+	return false;
 }
 
-static bool
-load_uint64(uint64_t *v, FILE *f)
+/*
+ * dumping
+ */
+
+struct serial_dump_ctx {
+	struct workspace *wk;
+	struct arr words, blob;
+	uint32_t records_len;
+	// obj -> reference, and string contents -> reference
+	struct hash objs, strs;
+};
+
+static void
+push_word(struct serial_dump_ctx *ctx, uint32_t v)
 {
-	return fs_fread(v, sizeof(uint64_t), f);
+	arr_push(&ctx->words, &v);
 }
 
-static bool
-dump_bucket_arr(const struct bucket_arr *ba, FILE *f)
+static void
+push_words(struct serial_dump_ctx *ctx, struct arr *words)
 {
-	uint32_t i;
-
-	if (!dump_uint32(ba->buckets.len, f)) {
-		return false;
+	if (words->len) {
+		arr_grow_by(&ctx->words, words->len);
+		memcpy(arr_get(&ctx->words, ctx->words.len - words->len), words->e, words->len * sizeof(uint32_t));
 	}
+	arr_destroy(words);
+}
 
-	for (i = 0; i < ba->buckets.len; ++i) {
-		struct bucket *b = arr_get(&ba->buckets, i);
-
-		if (!dump_uint32(b->len, f)) {
-			return false;
-		}
-
-		if (!fs_fwrite(b->mem, ba->item_size * b->len, f)) {
-			return false;
-		}
-	}
+static bool serial_dump_obj(struct serial_dump_ctx *ctx, obj o, uint32_t *ref);
 
-	return true;
+static uint32_t
+serial_dump_finish_record(struct serial_dump_ctx *ctx, obj o)
+{
+	uint32_t ref = ++ctx->records_len;
+	hash_set(&ctx->objs, &o, ref);
+	return ref;
 }
 
 static bool
-load_bucket_arr(struct bucket_arr *ba, FILE *f)
+serial_dump_str(struct serial_dump_ctx *ctx, obj o, uint32_t *ref)
 {
-	uint32_t buckets_len;
-	uint32_t i;
-	struct bucket b = { 0 };
-
-	assert(ba->len == 0);
+	const struct str *ss = get_str(ctx->wk, o);
+	const uint64_t *v;
+	if ((v = hash_get_strn(&ctx->strs, ss->s, ss->len))) {
+		*ref = *v;
+		return true;
+	}
 
-	if (!load_uint32(&buckets_len, f)) {
+	uint32_t off = ctx->blob.len;
+	if ((uint64_t)off + ss->len + 1 > UINT32_MAX) {
+		LOG_E("serial dump too large");
 		return false;
 	}
 
-	z_free(((struct bucket *)arr_get(&ba->buckets, 0))->mem);
-	arr_clear(&ba->buckets);
-
-	for (i = 0; i < buckets_len; ++i) {
-		init_bucket(ba, &b);
-
-		if (!load_uint32(&b.len, f)) {
-			goto done;
-		}
-
-		if (b.len > ba->bucket_size) {
-			corrupted_dump();
-			goto done;
-		}
-
-		ba->len += b.len;
-
-		if (!fs_fread(b.mem, ba->item_size * b.len, f)) {
-			goto done;
-		}
-
-		arr_push(&ba->buckets, &b);
-		continue;
-done:
-		z_free(b.mem);
-		return corrupted_dump();
-	}
+	arr_grow_by(&ctx->blob, ss->len + 1);
+	memcpy(ctx->blob.e + off, ss->s, ss->len);
+	ctx->blob.e[off + ss->len] = 0;
 
+	push_word(ctx, obj_string);
+	push_word(ctx, off);
+	push_word(ctx, ss->len);
+	*ref = serial_dump_finish_record(ctx, o);
+	hash_set_strn(&ctx->strs, ss->s, ss->len, *ref);
 	return true;
 }
 
 static bool
-dump_serial_header(FILE *f)
+serial_dump_obj(struct serial_dump_ctx *ctx, obj o, uint32_t *ref)
 {
-	return fs_fwrite(serial_magic, SERIAL_MAGIC_LEN, f) && dump_uint32(serial_version, f);
-}
+	struct workspace *wk = ctx->wk;
 
-static bool
-load_serial_header(FILE *f)
-{
-	char buf[SERIAL_MAGIC_LEN] = { 0 };
-
-	if (!fs_fread(buf, SERIAL_MAGIC_LEN, f)) {
+	if (!o || (o & OBJ_IMMEDIATE_NUMBER_BIT)) {
+		*ref = o;
+		return true;
+	} else if (o >= wk->vm.objects.objs.len) {
+		LOG_E("invalid object");
 		return false;
 	}
 
-	if (memcmp(buf, serial_magic, SERIAL_MAGIC_LEN) != 0) {
-		LOG_E("invalid file (missing magic)");
-		return false;
+	const uint64_t *v;
+	if ((v = hash_get(&ctx->objs, &o))) {
+		*ref = *v;
+		return true;
 	}
 
-	uint32_t v;
-	if (!load_uint32(&v, f)) {
-		return false;
+	enum obj_type t = get_obj_type(wk, o);
+	switch (t) {
+	case obj_null: *ref = 0; return true;
+	case obj_string: return serial_dump_str(ctx, o, ref);
+	case obj_number: {
+		uint64_t n = get_obj_number(wk, o);
+		push_word(ctx, t);
+		push_word(ctx, n & 0xffffffff);
+		push_word(ctx, n >> 32);
+		break;
 	}
+	case obj_bool:
+		push_word(ctx, t);
+		push_word(ctx, get_obj_bool(wk, o));
+		break;
+	case obj_feature_opt:
+		push_word(ctx, t);
+		push_word(ctx, get_obj_feature_opt(wk, o));
+		break;
+	case obj_file: {
+		uint32_t s;
+		if (!serial_dump_str(ctx, *get_obj_file(wk, o), &s)) {
+			return false;
+		}
 
-	if (v != serial_version) {
-		LOG_E("unable to load data file created by a different version of muon (%d != %d)", v, serial_version);
-		return false;
+		push_word(ctx, t);
+		push_word(ctx, s);
+		break;
 	}
+	case obj_array: {
+		struct arr refs;
+		arr_init(&refs, 8, sizeof(uint32_t));
+
+		// obj_array_for stops at the first null element, which arrays such as
+		// the test_setups slot of serialized tests may contain.
+		const struct obj_array *a = get_obj_array(wk, o);
+		uint32_t i, r;
+		for (i = 0; i < a->len; ++i) {
+			if (!serial_dump_obj(ctx, obj_array_elem(wk, a, i), &r)) {
+				arr_destroy(&refs);
+				return false;
+			}
+			arr_push(&refs, &r);
+		}
 
-	return true;
-}
-
-static bool
-dump_big_strings(struct workspace *wk, struct arr *offsets, FILE *f)
-{
-	uint64_t len = 0;
-	uint64_t start, end;
+		push_word(ctx, t);
+		push_word(ctx, refs.len);
+		push_words(ctx, &refs);
+		break;
+	}
+	case obj_dict: {
+		const bool int_key = get_obj_dict(wk, o)->flags & obj_dict_flag_int_key;
+		struct arr refs;
+		arr_init(&refs, 8, sizeof(uint32_t));
+
+		obj k, v;
+		uint32_t r[2];
+		obj_dict_for(wk, o, k, v) {
+			r[0] = k;
+			if ((!int_key && !serial_dump_obj(ctx, k, &r[0])) || !serial_dump_obj(ctx, v, &r[1])) {
+				arr_destroy(&refs);
+				return false;
+			}
+			arr_push(&refs, &r[0]);
+			arr_push(&refs, &r[1]);
+		}
 
-	// dump a placeholder at the start
-	if (!fs_ftell(f, &start)) {
-		return false;
-	} else if (!dump_uint64(0, f)) {
-		return false;
+		push_word(ctx, t);
+		push_word(ctx, int_key);
+		push_word(ctx, refs.len / 2);
+		push_words(ctx, &refs);
+		break;
 	}
+	default: {
+		const struct serial_struct_type *st = &serial_struct_types[t];
+		if (!st->size) {
+			LOG_E("unable to serialize '%s'", obj_type_to_s(t));
+			return false;
+		}
 
-	uint32_t i;
-	struct bucket_arr *str_ba = &wk->vm.objects.obj_aos[obj_string - _obj_aos_start];
-	for (i = 0; i < str_ba->len; ++i) {
-		struct str *ss = bucket_arr_get(str_ba, i);
+		uint32_t words[32] = { 0 }, i;
+		assert(serial_struct_words(st) <= ARRAY_LEN(words));
+		memcpy(words, serial_struct_get(wk, o, t), st->size);
 
-		if (!(ss->flags & str_flag_big)) {
-			continue;
+		for (i = 0; i < st->fields_len; ++i) {
+			obj field;
+			memcpy(&field, (uint8_t *)words + st->fields[i], sizeof(obj));
+			if (!serial_dump_obj(ctx, field, &field)) {
+				return false;
+			}
+			memcpy((uint8_t *)words + st->fields[i], &field, sizeof(obj));
 		}
 
-		if (!fs_fwrite(ss->s, ss->len + 1, f)) {
-			return false;
+		push_word(ctx, t);
+		for (i = 0; i < serial_struct_words(st); ++i) {
+			push_word(ctx, words[i]);
 		}
-
-		arr_push(offsets, &len);
-		len += ss->len + 1;
+		break;
 	}
-
-	// jump back to the beginning, write the length, and then return
-	if (!fs_ftell(f, &end)) {
-		return false;
-	} else if (!fs_fseek(f, start)) {
-		return false;
-	} else if (!dump_uint64(len, f)) {
-		return false;
-	} else if (!fs_fseek(f, end)) {
-		return false;
 	}
 
+	*ref = serial_dump_finish_record(ctx, o);
 	return true;
 }
 
-struct big_string_table {
-	uint8_t *data;
-	uint64_t len;
-};
-
-static bool
-load_big_strings(struct workspace *wk, struct big_string_table *bst, FILE *f)
+bool
+serial_dump(struct workspace *wk_src, obj o, FILE *f)
 {
-	uint64_t len;
-	uint8_t *buf = NULL;
-	if (!load_uint64(&len, f)) {
-		return false;
-	}
+	bool ret = false;
+	struct serial_dump_ctx ctx = { .wk = wk_src };
+	arr_init(&ctx.words, 1024, sizeof(uint32_t));
+	arr_init(&ctx.blob, 4096, 1);
+	hash_init(&ctx.objs, 256, sizeof(obj));
+	hash_init_str(&ctx.strs, 256);
 
-	if (len) {
-		if (len > UINT32_MAX) {
-			return corrupted_dump();
-		}
+	struct serial_header hdr = { .version = serial_version };
+	memcpy(hdr.magic, serial_magic, SERIAL_MAGIC_LEN);
 
-		buf = z_calloc(1, len);
-		if (!fs_fread(buf, len, f)) {
-			return false;
-		}
+	if (!serial_dump_obj(&ctx, o, &hdr.root)) {
+		goto ret;
 	}
 
-	*bst = (struct big_string_table){
-		.data = buf,
-		.len = len,
-	};
+	hdr.words_len = ctx.words.len;
+	hdr.records_len = ctx.records_len;
+	hdr.blob_len = ctx.blob.len;
 
-	return true;
+	if (!(fs_fwrite(&hdr, sizeof(hdr), f) && fs_fwrite(ctx.words.e, (size_t)ctx.words.len * sizeof(uint32_t), f)
+		    && fs_fwrite(ctx.blob.e, ctx.blob.len, f))) {
+		goto ret;
+	}
+
+	ret = true;
+ret:
+	arr_destroy(&ctx.words);
+	arr_destroy(&ctx.blob);
+	hash_destroy(&ctx.objs);
+	hash_destroy(&ctx.strs);
+	return ret;
 }
 
-// store flags as a u64 to prevent padding in this struct, which makes memsan
-// upset when we fwrite it out
-struct serial_str {
-	uint64_t s, len, flags;
+/*
+ * loading
+ */
+
+struct serial_load_ctx {
+	struct workspace *wk;
+	const uint32_t *words;
+	const char *blob;
+	uint32_t words_len, records_len;
+	uint64_t blob_len;
+	obj *records;
 };
 
 static bool
-get_big_string(struct workspace *wk, const struct big_string_table *bst, struct serial_str *src, struct str *res)
+serial_load_ref(const struct serial_load_ctx *ctx, uint32_t loaded, uint32_t ref, obj *res)
 {
-	assert(src->flags & str_flag_big);
-
-	if (src->s >= bst->len) {
+	if (!ref || (ref & OBJ_IMMEDIATE_NUMBER_BIT)) {
+		*res = ref;
+		return true;
+	} else if (ref > loaded) {
 		return corrupted_dump();
 	}
 
-	char *buf = z_calloc(1, src->len + 1);
-	memcpy(buf, &bst->data[src->s], src->len);
-
-	*res = (struct str){
-		.flags = src->flags,
-		.len = src->len,
-		.s = buf,
-	};
-
+	*res = ctx->records[ref - 1];
 	return true;
 }
 
 static bool
-dump_objs(struct workspace *wk, struct arr *big_string_offsets, FILE *f)
+serial_load_records(struct serial_load_ctx *ctx)
 {
-	if (!dump_uint32(wk->vm.objects.objs.len - 1, f)) {
-		return false;
-	}
-
-	struct serial_str ser_s = { 0 };
-
-	void *data;
-	size_t len;
-	uint8_t type_tag;
-
-	assert(obj_type_count < UINT8_MAX && "increase size of type tag");
-
-	uint32_t i, big_string_i = 0;
-	for (i = 1; i < wk->vm.objects.objs.len; ++i) {
-		struct obj_internal *o = bucket_arr_get(&wk->vm.objects.objs, i);
-		type_tag = o->t;
-
-		if (!fs_fwrite(&type_tag, sizeof(uint8_t), f)) {
-			return false;
-		}
-
-		if (o->t == obj_string) {
-			const struct str *ss
-				= bucket_arr_get(&wk->vm.objects.obj_aos[obj_string - _obj_aos_start], o->val);
-
-			ser_s = (struct serial_str){
-				.len = ss->len,
-				.flags = ss->flags,
-			};
-
-			if (ss->flags & str_flag_big) {
-				ser_s.s = *(uint64_t *)arr_get(big_string_offsets, big_string_i);
-				++big_string_i;
-			} else {
-				if (!bucket_arr_lookup_pointer(&wk->vm.objects.chrs, (uint8_t *)ss->s, &ser_s.s)) {
-					assert(false && "pointer not found");
-				}
+	struct workspace *wk = ctx->wk;
+	uint32_t wi = 0, ri, i;
+
+// reserve n words of the current record
+#define RECORD_WORDS(n)                                            \
+	if ((uint64_t)wi + (n) > ctx->words_len) {                 \
+		return corrupted_dump();                           \
+	}                                                          \
+	w = &ctx->words[wi];                                       \
+	wi += (n);
+
+	for (ri = 0; ri < ctx->records_len; ++ri) {
+		const uint32_t *w;
+		obj o = 0;
+
+		RECORD_WORDS(1);
+		const enum obj_type t = w[0];
+
+		switch (t) {
+		case obj_string: {
+			RECORD_WORDS(2);
+			if ((uint64_t)w[0] + w[1] >= ctx->blob_len || ctx->blob[w[0] + w[1]]) {
+				return corrupted_dump();
 			}
 
-			data = &ser_s;
-			len = sizeof(struct serial_str);
-		} else if (o->t < _obj_aos_start) {
-			data = &o->val;
-			len = sizeof(uint32_t);
-		} else {
-			struct bucket_arr *ba = &wk->vm.objects.obj_aos[o->t - _obj_aos_start];
-			data = bucket_arr_get(ba, o->val);
-			len = ba->item_size;
+			make_obj(wk, &o, obj_string);
+			*(struct str *)get_str(wk, o) = (struct str){ .s = &ctx->blob[w[0]], .len = w[1] };
+			break;
 		}
+		case obj_number:
+			RECORD_WORDS(2);
+			o = make_number(wk, (int64_t)((uint64_t)w[1] << 32 | w[0]));
+			break;
+		case obj_bool:
+			RECORD_WORDS(1);
+			o = make_obj_bool(wk, w[0]);
+			break;
+		case obj_feature_opt:
+			RECORD_WORDS(1);
+			make_obj(wk, &o, t);
+			set_obj_feature_opt(wk, o, w[0]);
+			break;
+		case obj_file: {
+			obj s;
+			RECORD_WORDS(1);
+			if (!serial_load_ref(ctx, ri, w[0], &s) || get_obj_type(wk, s) != obj_string) {
+				return corrupted_dump();
+			}
 
-		if (!fs_fwrite(data, len, f)) {
-			return false;
-		}
-	}
-
-	return true;
-}
-
-static bool
-load_objs(struct workspace *wk, const struct big_string_table *bst, FILE *f)
-{
-	uint32_t len;
-	if (!load_uint32(&len, f)) {
-		return false;
-	}
-
-	if (!len) {
-		return true;
-	}
-
-	uint8_t type_tag;
-	struct serial_str ser_s;
-	struct bucket_arr *ba;
-
-	uint32_t i;
-	for (i = 0; i < len; ++i) {
-		if (!fs_fread(&type_tag, sizeof(uint8_t), f)) {
-			return false;
+			make_obj(wk, &o, t);
+			*get_obj_file(wk, o) = s;
+			break;
 		}
-
-		bucket_arr_pushn(&wk->vm.objects.objs, NULL, 0, 1);
-		struct obj_internal *o = bucket_arr_get(&wk->vm.objects.objs, wk->vm.objects.objs.len - 1);
-
-		*o = (struct obj_internal){
-			.t = type_tag,
-		};
-
-		if (type_tag < _obj_aos_start) {
-			if (!fs_fread(&o->val, sizeof(uint32_t), f)) {
-				return false;
+		case obj_array: {
+			RECORD_WORDS(1);
+			const uint32_t len = w[0];
+			RECORD_WORDS(len);
+
+			make_obj(wk, &o, t);
+			for (i = 0; i < len; ++i) {
+				obj v;
+				if (!serial_load_ref(ctx, ri, w[i], &v)) {
+					return false;
+				}
+				obj_array_push(wk, o, v);
 			}
-			continue;
-		}
-
-		if (type_tag >= obj_type_count) {
-			return corrupted_dump();
+			break;
 		}
-
-		ba = &wk->vm.objects.obj_aos[type_tag - _obj_aos_start];
-		o->val = ba->len;
-		bucket_arr_pushn(ba, NULL, 0, 1);
-
-		if (type_tag == obj_string) {
-			if (!fs_fread(&ser_s, sizeof(struct serial_str), f)) {
-				return false;
+		case obj_dict: {
+			RECORD_WORDS(2);
+			const bool int_key = w[0];
+			const uint32_t len = w[1];
+			RECORD_WORDS((uint64_t)len * 2);
+
+			make_obj(wk, &o, t);
+			if (int_key) {
+				get_obj_dict(wk, o)->flags |= obj_dict_flag_int_key;
 			}
 
-			struct str *ss = bucket_arr_get(ba, o->val);
-
-			if (ser_s.flags & str_flag_big) {
-				if (!get_big_string(wk, bst, &ser_s, ss)) {
+			for (i = 0; i < len; ++i) {
+				obj k = w[i * 2], v;
+				if (!serial_load_ref(ctx, ri, w[i * 2 + 1], &v)) {
 					return false;
 				}
-			} else {
-				uint32_t bucket_i = ser_s.s % wk->vm.objects.chrs.bucket_size,
-					 buckets_i = ser_s.s / wk->vm.objects.chrs.bucket_size;
-				if (buckets_i > wk->vm.objects.chrs.buckets.len
-					|| bucket_i > ((struct bucket *)(arr_get(
-							       &wk->vm.objects.chrs.buckets, buckets_i)))
-							      ->len) {
+
+				if (int_key) {
+					obj_dict_seti(wk, o, k, v);
+				} else if (!serial_load_ref(ctx, ri, k, &k) || !k || (k & OBJ_IMMEDIATE_NUMBER_BIT)
+					   || get_obj_type(wk, k) != obj_string) {
 					return corrupted_dump();
+				} else {
+					obj_dict_set(wk, o, k, v);
 				}
-
-				*ss = (struct str){
-					.s = bucket_arr_get(&wk->vm.objects.chrs, ser_s.s),
-					.len = ser_s.len,
-					.flags = ser_s.flags,
-				};
-			}
-		} else {
-			if (!fs_fread(bucket_arr_get(ba, o->val), ba->item_size, f)) {
-				return false;
 			}
+			break;
 		}
-	}
-
-	return true;
-}
+		default: {
+			const struct serial_struct_type *st = t < obj_type_count ? &serial_struct_types[t] : 0;
+			if (!st || !st->size) {
+				return corrupted_dump();
+			}
 
-bool
-serial_dump(struct workspace *wk_src, obj o, FILE *f)
-{
-	bool ret = false;
-	struct workspace wk_dest = { 0 };
-	vm_init_objects(&wk_dest);
+			RECORD_WORDS(serial_struct_words(st));
+			make_obj(wk, &o, t);
+			uint8_t *dest = serial_struct_get(wk, o, t);
+			memcpy(dest, w, st->size);
 
-	struct arr big_string_offsets;
-	arr_init(&big_string_offsets, 32, sizeof(uint64_t));
+			for (i = 0; i < st->fields_len; ++i) {
+				obj field;
+				memcpy(&field, dest + st->fields[i], sizeof(obj));
+				if (!serial_load_ref(ctx, ri, field, &field)) {
+					return false;
+				}
+				memcpy(dest + st->fields[i], &field, sizeof(obj));
+			}
+			break;
+		}
+		}
 
-	obj obj_dest;
-	if (!obj_clone(wk_src, &wk_dest, o, &obj_dest)) {
-		goto ret;
+		ctx->records[ri] = o;
 	}
 
-	/* obj_fprintf(&wk_dest, log_file(), "saving %o\n", obj_dest); */
-
-	if (!(dump_serial_header(f) && dump_uint32(obj_dest, f) && dump_bucket_arr(&wk_dest.vm.objects.chrs, f)
-		    && dump_big_strings(&wk_dest, &big_string_offsets, f) && dump_objs(&wk_dest, &big_string_offsets, f)
-		    && dump_bucket_arr(&wk_dest.vm.objects.dict_elems, f))) {
-		goto ret;
-	}
+#undef RECORD_WORDS
 
-	ret = true;
-ret:
-	vm_destroy_objects(&wk_dest);
-	arr_destroy(&big_string_offsets);
-	return ret;
+	return wi == ctx->words_len ? true : corrupted_dump();
 }
 
 bool
 serial_load(struct workspace *wk, obj *res, FILE *f)
 {
-	bool ret = false;
-	struct workspace wk_src = { 0 };
-	vm_init_objects(&wk_src);
-	bucket_arr_clear(&wk_src.vm.objects.dict_elems); // remove null dict_elem
+	struct serial_header hdr;
 
-	struct big_string_table bst = { 0 };
+	if (!fs_fread(&hdr, sizeof(hdr), f)) {
+		return false;
+	}
 
-	obj obj_src;
-	if (!(load_serial_header(f) && load_uint32(&obj_src, f) && load_bucket_arr(&wk_src.vm.objects.chrs, f)
-		    && load_big_strings(&wk_src, &bst, f) && load_objs(&wk_src, &bst, f)
-		    && load_bucket_arr(&wk_src.vm.objects.dict_elems, f))) {
-		goto ret;
+	if (memcmp(hdr.magic, serial_magic, SERIAL_MAGIC_LEN) != 0) {
+		LOG_E("invalid file (missing magic)");
+		return false;
 	}
 
-	/* obj_fprintf(&wk_src, log_file(), "loaded %o\n", obj_src); */
+	if (hdr.version != serial_version) {
+		LOG_E("unable to load data file created by a different version of muon (%d != %d)",
+			hdr.version,
+			serial_version);
+		return false;
+	}
 
-	if (!obj_clone(&wk_src, wk, obj_src, res)) {
-		corrupted_dump();
-		goto ret;
+	if (hdr.blob_len > UINT32_MAX || hdr.records_len > hdr.words_len) {
+		return corrupted_dump();
 	}
 
-	ret = true;
-ret:
-	if (bst.data) {
-		z_free(bst.data);
+	// The words and the blob are read at once into a buffer owned by the
+	// workspace, see vm_destroy_objects.
+	const uint64_t words_size = (uint64_t)hdr.words_len * sizeof(uint32_t);
+	uint8_t *buf = z_malloc(words_size + hdr.blob_len + 1);
+	arr_push(&wk->vm.objects.serial_bufs, &buf);
+	if (!fs_fread(buf, words_size + hdr.blob_len, f)) {
+		return false;
 	}
-	vm_destroy_objects(&wk_src);
+
+	struct serial_load_ctx ctx = {
+		.wk = wk,
+		.words = (const uint32_t *)buf,
+		.words_len = hdr.words_len,
+		.records_len = hdr.records_len,
+		.blob = (const char *)buf + words_size,
+		.blob_len = hdr.blob_len,
+		.records = z_malloc(((size_t)hdr.records_len + 1) * sizeof(obj)),
+	};
+
+	bool ret = serial_load_records(&ctx) && serial_load_ref(&ctx, ctx.records_len, hdr.root, res);
+	z_free(ctx.records);
 	return ret;
 }
 
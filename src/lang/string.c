@@ -222,6 +222,44 @@ str_apps(struct workspace *wk, obj *s, obj s_id)
 	str_appn(wk, s, str->s, str->len);
 }
 
+/*
+ * Appends s_id to s in place.  s must not be referenced by anything that
+ * expects it to stay unchanged.  *cap is the capacity of s's buffer, or 0 if
+ * s doesn't have a growable buffer yet, and grows geometrically so that
+ * repeated appends take amortized constant time.
+ */
+void
+str_apps_owned(struct workspace *wk, obj s, uint32_t *cap, obj s_id)
+{
+	struct str *ss = (struct str *)get_str(wk, s);
+	const struct str *str = get_str(wk, s_id);
+	uint32_t need = ss->len + str->len + 1;
+
+	if (need > *cap) {
+		uint32_t new_cap = *cap * 2 > need ? *cap * 2 : need;
+		if (new_cap < SMALL_STR_LEN) {
+			new_cap = SMALL_STR_LEN;
+		}
+
+		if (ss->flags & str_flag_big) {
+			ss->s = z_realloc((void *)ss->s, new_cap);
+		} else {
+			char *p = z_malloc(new_cap);
+			memcpy(p, ss->s, ss->len);
+			ss->s = p;
+			ss->flags |= str_flag_big;
+		}
+
+		ss->flags |= str_flag_mutable;
+		*cap = new_cap;
+	}
+
+	char *p = (char *)ss->s;
+	memcpy(&p[ss->len], str->s, str->len);
+	ss->len += str->len;
+	p[ss->len] = 0;
+}
+
 void
 str_app(struct workspace *wk, obj *s, const char *str)
 {
@@ -28,12 +28,15 @@ const uint32_t op_operands[op_count] = {
 	[op_iterator] = 1,
 	[op_iterator_next] = 1,
 	[op_add_store] = 1,
+	[op_load_local] = 2,
+	[op_store_local] = 2,
+	[op_add_store_local] = 2,
 	[op_constant] = 1,
 	[op_constant_list] = 1,
 	[op_constant_dict] = 1,
 	[op_constant_func] = 1,
 	[op_call] = 2,
-	[op_call_method] = 3,
+	[op_call_method] = 4,
 	[op_call_native] = 3,
 	[op_jmp_if_true] = 1,
 	[op_jmp_if_false] = 1,
@@ -604,7 +607,7 @@ vm_dis_inst(struct workspace *wk, uint8_t *code, uint32_t base_ip)
 	uint32_t ip = base_ip;
 	buf_push("%04x ", ip);
 
-	uint32_t op = code[ip], constants[3];
+	uint32_t op = code[ip], constants[4];
 	{
 		++ip;
 		uint32_t j;
@@ -646,6 +649,15 @@ vm_dis_inst(struct workspace *wk, uint8_t *code, uint32_t base_ip)
 	op_case(op_add_store)
 		buf_push(":%s", get_str(wk, constants[0])->s);
 		break;
+	op_case(op_load_local)
+		buf_push(":%d,%s", constants[0], get_str(wk, constants[1])->s);
+		break;
+	op_case(op_store_local)
+		buf_push(":%d,%s", constants[0], get_str(wk, constants[1])->s);
+		break;
+	op_case(op_add_store_local)
+		buf_push(":%d,%s", constants[0], get_str(wk, constants[1])->s);
+		break;
 	op_case(op_constant)
 		buf_push(":%o", constants[0]);
 		break;
@@ -663,9 +675,9 @@ vm_dis_inst(struct workspace *wk, uint8_t *code, uint32_t base_ip)
 		break;
 	op_case(op_call_method) {
 		uint32_t a, b, c;
-		a = constants[0];
-		b = constants[1];
-		c = constants[2];
+		a = constants[1];
+		b = constants[2];
+		c = constants[3];
 		buf_push(":%o,%d,%d", a, b, c);
 		break;
 	}
@@ -743,6 +755,47 @@ vm_push_dummy(struct workspace *wk)
 	object_stack_push(wk, make_typeinfo(wk, tc_any));
 }
 
+static const obj vm_local_unset = UINT32_MAX;
+
+static obj
+vm_capture_kwarg_val(struct workspace *wk, struct obj_capture *capture, uint32_t i)
+{
+	obj val = 0;
+	if (capture->func->akw[i].set) {
+		val = capture->func->akw[i].val;
+	} else if (capture->defargs) {
+		const struct str s = WKSTR(capture->func->akw[i].key);
+		obj_dict_index_strn(wk, capture->defargs, s.s, s.len, &val);
+	}
+	return val;
+}
+
+/* Arguments of functions compiled with local slots occupy the first slots,
+ * positional arguments first followed by keyword arguments, see
+ * vm_comp_func_locals.
+ */
+static void
+vm_execute_capture_slots(struct workspace *wk, struct obj_capture *capture)
+{
+	uint32_t i, j = 0;
+
+	if (!capture->func->nlocals) {
+		return;
+	}
+
+	arr_grow_by(&wk->vm.locals, capture->func->nlocals);
+	obj *slots = arr_get(&wk->vm.locals, wk->vm.locals_base);
+	memset(slots, 0xff, sizeof(obj) * capture->func->nlocals);
+
+	for (i = 0; capture->func->an[i].type != ARG_TYPE_NULL; ++i) {
+		slots[j++] = capture->func->an[i].val;
+	}
+
+	for (i = 0; capture->func->akw[i].key; ++i) {
+		slots[j++] = vm_capture_kwarg_val(wk, capture, i);
+	}
+}
+
 static void
 vm_execute_capture(struct workspace *wk, obj a)
 {
@@ -781,6 +834,7 @@ vm_execute_capture(struct workspace *wk, obj a)
 			.scope_stack = wk->vm.scope_stack,
 			.expected_return_type = capture->func->return_type,
 			.lang_mode = wk->vm.lang_mode,
+			.locals_base = wk->vm.locals_base,
 		});
 
 	wk->vm.lang_mode = capture->func->lang_mode;
@@ -788,6 +842,13 @@ vm_execute_capture(struct workspace *wk, obj a)
 	wk->vm.scope_stack = capture->scope_stack;
 	wk->vm.behavior.push_local_scope(wk);
 
+	wk->vm.locals_base = wk->vm.locals.len;
+	if (capture->func->local_slots) {
+		vm_execute_capture_slots(wk, capture);
+		wk->vm.ip = capture->func->entry;
+		return;
+	}
+
 	for (i = 0; capture->func->an[i].type != ARG_TYPE_NULL; ++i) {
 		wk->vm.behavior.assign_variable(wk,
 			capture->func->an[i].name,
@@ -797,16 +858,11 @@ vm_execute_capture(struct workspace *wk, obj a)
 	}
 
 	for (i = 0; capture->func->akw[i].key; ++i) {
-		obj val = 0;
-		if (capture->func->akw[i].set) {
-			val = capture->func->akw[i].val;
-		} else if (capture->defargs) {
-			const struct str s = WKSTR(capture->func->akw[i].key);
-			obj_dict_index_strn(wk, capture->defargs, s.s, s.len, &val);
-		}
-
-		wk->vm.behavior.assign_variable(
-			wk, capture->func->akw[i].key, val, capture->func->akw[i].node, assign_local);
+		wk->vm.behavior.assign_variable(wk,
+			capture->func->akw[i].key,
+			vm_capture_kwarg_val(wk, capture, i),
+			capture->func->akw[i].node,
+			assign_local);
 	}
 
 	wk->vm.ip = capture->func->entry;
@@ -953,8 +1009,7 @@ vm_op_add(struct workspace *wk)
 	case obj_number: {
 		typecheck_operand(b, b_t, obj_number, tc_number, tc_number);
 
-		make_obj(wk, &res, obj_number);
-		set_obj_number(wk, res, get_obj_number(wk, a) + get_obj_number(wk, b));
+		res = make_number(wk, get_obj_number(wk, a) + get_obj_number(wk, b));
 		break;
 	}
 	case obj_string: {
@@ -1005,39 +1060,66 @@ type_err:
 	object_stack_push(wk, res);
 }
 
-static void
-vm_op_add_store(struct workspace *wk)
+/*
+ * A string produced by += is owned by the variable it is assigned to until
+ * that variable is read, so a following += can append to it in place instead
+ * of copying the whole string, making accumulation loops linear.  Every
+ * variable read disowns the value it returns, as does capturing the scope
+ * stack.  Owned strings are tracked in a small direct-mapped table keyed by
+ * object id, a collision only costs a copy.
+ */
+static struct vm_owned_str *
+vm_owned_str(struct workspace *wk, obj s)
 {
-	obj a, b;
+	return &wk->vm.owned_strs[s & (ARRAY_LEN(wk->vm.owned_strs) - 1)];
+}
 
-	b = object_stack_pop(&wk->vm.stack);
-	obj a_id = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
-	const struct str *id = get_str(wk, a_id);
-	if (!wk->vm.behavior.get_variable(wk, id->s, &a)) {
-		vm_error(wk, "undefined object %s", get_cstr(wk, a_id));
-		vm_push_dummy(wk);
-		return;
+static void
+vm_disown(struct workspace *wk, obj o)
+{
+	struct vm_owned_str *owned = vm_owned_str(wk, o);
+	if (owned->s == o) {
+		owned->s = 0;
 	}
+}
+
+static bool vm_get_local_variable(struct workspace *wk, const char *name, obj *res, obj *scope);
 
+/* Computes a += b.  *assign is set when the result is a new object that has
+ * to be written back to the variable rather than an in-place update of a.
+ */
+static bool
+vm_add_store_value(struct workspace *wk, obj a, obj b, obj *_res, bool *assign)
+{
 	enum obj_type a_t = get_obj_type(wk, a), b_t = get_obj_type(wk, b);
 	obj res;
-	bool assign = false;
+
+	*assign = false;
 
 	switch (a_t) {
 	case obj_number: {
-		assign = true;
+		*assign = true;
 		typecheck_operand(b, b_t, obj_number, tc_number, tc_number);
 
-		make_obj(wk, &res, obj_number);
-		set_obj_number(wk, res, get_obj_number(wk, a) + get_obj_number(wk, b));
+		res = make_number(wk, get_obj_number(wk, a) + get_obj_number(wk, b));
 		break;
 	}
 	case obj_string: {
-		assign = true;
 		typecheck_operand(b, b_t, obj_string, tc_string, tc_string);
 
-		// TODO: could use str_appn, but would have to dup on store
+		struct vm_owned_str *owned = vm_owned_str(wk, a);
+		if (owned->s == a) {
+			str_apps_owned(wk, a, &owned->cap, b);
+			res = a;
+			break;
+		}
+
+		*assign = true;
 		res = str_join(wk, a, b);
+
+		if (!wk->vm.in_analyzer) {
+			*vm_owned_str(wk, res) = (struct vm_owned_str){ .s = res };
+		}
 		break;
 	}
 	case obj_array: {
@@ -1057,7 +1139,7 @@ vm_op_add_store(struct workspace *wk)
 		break;
 	}
 	case obj_typeinfo: {
-		assign = true;
+		*assign = true;
 		struct check_obj_typeinfo_map map[obj_type_count] = {
 			[obj_number] = { tc_number, tc_number },
 			[obj_string] = { tc_string, tc_string },
@@ -1072,6 +1154,31 @@ vm_op_add_store(struct workspace *wk)
 	default:
 type_err:
 		vm_error(wk, "+= not defined for %s and %s", obj_typestr(wk, a), obj_typestr(wk, b));
+		return false;
+	}
+
+	*_res = res;
+	return true;
+}
+
+static void
+vm_add_store_named(struct workspace *wk, obj a_id, obj b)
+{
+	obj a, res;
+	bool assign;
+
+	// Look the variable up directly when possible, since going through
+	// get_variable would disown its value.
+	const struct str *id = get_str(wk, a_id);
+	obj _scope;
+	if (!(wk->vm.in_analyzer ? wk->vm.behavior.get_variable(wk, id->s, &a) :
+				   vm_get_local_variable(wk, id->s, &a, &_scope))) {
+		vm_error(wk, "undefined object %s", get_cstr(wk, a_id));
+		vm_push_dummy(wk);
+		return;
+	}
+
+	if (!vm_add_store_value(wk, a, b, &res, &assign)) {
 		vm_push_dummy(wk);
 		return;
 	}
@@ -1083,6 +1190,43 @@ type_err:
 	object_stack_push(wk, res);
 }
 
+static void
+vm_op_add_store(struct workspace *wk)
+{
+	obj b = object_stack_pop(&wk->vm.stack);
+	obj a_id = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
+	vm_add_store_named(wk, a_id, b);
+}
+
+static void
+vm_op_add_store_local(struct workspace *wk)
+{
+	obj res;
+	bool assign;
+
+	obj b = object_stack_pop(&wk->vm.stack);
+	uint32_t slot = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
+	obj a_id = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
+	obj *a = arr_get(&wk->vm.locals, wk->vm.locals_base + slot);
+
+	if (*a == vm_local_unset) {
+		// Not yet assigned in this frame, so += updates an enclosing scope.
+		vm_add_store_named(wk, a_id, b);
+		return;
+	}
+
+	if (!vm_add_store_value(wk, *a, b, &res, &assign)) {
+		vm_push_dummy(wk);
+		return;
+	}
+
+	if (assign) {
+		*a = res;
+	}
+
+	object_stack_push(wk, res);
+}
+
 #define vm_simple_integer_op_body(__op, __strop)                                                            \
 	obj a, b;                                                                                           \
 	b = object_stack_pop(&wk->vm.stack);                                                                \
@@ -1096,8 +1240,7 @@ type_err:
 	case obj_number: {                                                                                  \
 		typecheck_operand(b, b_t, obj_number, tc_number, tc_number);                                \
                                                                                                             \
-		make_obj(wk, &res, obj_number);                                                             \
-		set_obj_number(wk, res, get_obj_number(wk, a) __op get_obj_number(wk, b));                  \
+		res = make_number(wk, get_obj_number(wk, a) __op get_obj_number(wk, b));                    \
 		break;                                                                                      \
 	}                                                                                                   \
 	case obj_typeinfo: {                                                                                \
@@ -1151,8 +1294,7 @@ vm_op_div(struct workspace *wk)
 	case obj_number:
 		typecheck_operand(b, b_t, obj_number, tc_number, tc_number);
 
-		make_obj(wk, &res, obj_number);
-		set_obj_number(wk, res, get_obj_number(wk, a) / get_obj_number(wk, b));
+		res = make_number(wk, get_obj_number(wk, a) / get_obj_number(wk, b));
 		break;
 	case obj_string: {
 		typecheck_operand(b, b_t, obj_string, tc_string, tc_string);
@@ -1358,8 +1500,7 @@ vm_op_negate(struct workspace *wk)
 
 	switch (a_t) {
 	case obj_number: {
-		make_obj(wk, &res, obj_number);
-		set_obj_number(wk, res, get_obj_number(wk, a) * -1);
+		res = make_number(wk, get_obj_number(wk, a) * -1);
 		break;
 	}
 	case obj_typeinfo: {
@@ -1402,19 +1543,9 @@ vm_op_stringify(struct workspace *wk)
 	object_stack_push(wk, res);
 }
 
-static void
-vm_op_store(struct workspace *wk)
+static obj
+vm_store_value(struct workspace *wk, obj b)
 {
-	struct obj_stack_entry *a_entry;
-	obj a, b;
-	a_entry = object_stack_pop_entry(&wk->vm.stack);
-	a = a_entry->o;
-	b = object_stack_peek(&wk->vm.stack, 1);
-
-	if (get_obj_type(wk, a) == obj_typeinfo) {
-		return;
-	}
-
 	switch (get_obj_type(wk, b)) {
 	case obj_environment:
 	case obj_configuration_data: {
@@ -1440,10 +1571,38 @@ vm_op_store(struct workspace *wk)
 	default: break;
 	}
 
+	return b;
+}
+
+static void
+vm_op_store(struct workspace *wk)
+{
+	struct obj_stack_entry *a_entry;
+	obj a, b;
+	a_entry = object_stack_pop_entry(&wk->vm.stack);
+	a = a_entry->o;
+	b = object_stack_peek(&wk->vm.stack, 1);
+
+	if (get_obj_type(wk, a) == obj_typeinfo) {
+		return;
+	}
+
+	b = vm_store_value(wk, b);
+
 	wk->vm.behavior.assign_variable(wk, get_str(wk, a)->s, b, a_entry->ip, assign_local);
 	/* LO("%o <= %o\n", a, b); */
 }
 
+static void
+vm_op_store_local(struct workspace *wk)
+{
+	uint32_t slot = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
+	vm_get_constant(wk->vm.code.e, &wk->vm.ip);
+
+	obj b = vm_store_value(wk, object_stack_peek(&wk->vm.stack, 1));
+	*(obj *)arr_get(&wk->vm.locals, wk->vm.locals_base + slot) = b;
+}
+
 static void
 vm_op_load(struct workspace *wk)
 {
@@ -1469,6 +1628,30 @@ vm_op_load(struct workspace *wk)
 	object_stack_push(wk, b);
 }
 
+static void
+vm_op_load_local(struct workspace *wk)
+{
+	obj a, b;
+	uint32_t slot = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
+	a = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
+
+	b = *(obj *)arr_get(&wk->vm.locals, wk->vm.locals_base + slot);
+	if (b != vm_local_unset) {
+		vm_disown(wk, b);
+		object_stack_push(wk, b);
+		return;
+	}
+
+	// Not yet assigned in this frame, fall back to the enclosing scopes.
+	if (!wk->vm.behavior.get_variable(wk, get_str(wk, a)->s, &b)) {
+		vm_error(wk, "undefined object %s", get_cstr(wk, a));
+		vm_push_dummy(wk);
+		return;
+	}
+
+	object_stack_push(wk, b);
+}
+
 static void
 vm_op_try_load(struct workspace *wk)
 {
@@ -1573,8 +1756,7 @@ vm_op_index(struct workspace *wk)
 			break;
 		}
 
-		make_obj(wk, &res, obj_number);
-		set_obj_number(wk, res, (i * iter->data.range.step) + iter->data.range.start);
+		res = make_number(wk, (i * iter->data.range.step) + iter->data.range.start);
 		break;
 	}
 	case obj_typeinfo: {
@@ -1615,13 +1797,24 @@ vm_op_call_method(struct workspace *wk)
 {
 	obj a, b, f = 0;
 	uint32_t idx;
+	struct vm_method_cache_entry *cache;
 
 	b = object_stack_pop(&wk->vm.stack);
+	cache = arr_get(&wk->vm.method_cache, vm_get_constant(wk->vm.code.e, &wk->vm.ip));
 	a = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
 	wk->vm.nargs = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
 	wk->vm.nkwargs = vm_get_constant(wk->vm.code.e, &wk->vm.ip);
 
-	if (!wk->vm.behavior.func_lookup(wk, b, get_str(wk, a)->s, &idx, &f)) {
+	enum obj_type t = get_obj_type(wk, b);
+
+	// Only plain native methods are cached, module lookups can
+	// produce errors or script functions and the analyzer's lookup
+	// depends on more than the receiver type.
+	bool cacheable = wk->vm.behavior.func_lookup == func_lookup && t != obj_module && t != obj_typeinfo;
+
+	if (cacheable && cache->valid && cache->type == t && cache->lang_mode == wk->vm.lang_mode) {
+		idx = cache->idx;
+	} else if (!wk->vm.behavior.func_lookup(wk, b, get_str(wk, a)->s, &idx, &f)) {
 		if (b == disabler_id) {
 			object_stack_discard(&wk->vm.stack, wk->vm.nargs + wk->vm.nkwargs * 2);
 			object_stack_push(wk, disabler_id);
@@ -1630,6 +1823,13 @@ vm_op_call_method(struct workspace *wk)
 		vm_error(wk, "method %o not found on %#o", a, obj_type_to_typestr(wk, b));
 		vm_push_dummy(wk);
 		return;
+	} else if (cacheable && !f) {
+		*cache = (struct vm_method_cache_entry){
+			.idx = idx,
+			.type = t,
+			.lang_mode = wk->vm.lang_mode,
+			.valid = true,
+		};
 	}
 
 	if (f) {
@@ -1751,11 +1951,8 @@ vm_op_iterator(struct workspace *wk)
 		iterator = get_obj_iterator(wk, iter);
 
 		iterator->type = obj_iterator_type_array;
-		iterator->data.array = get_obj_array(wk, a);
-		if (!iterator->data.array->len) {
-			// TODO: update this when we implement array_elem
-			iterator->data.array = 0;
-		}
+		iterator->data.array.a = get_obj_array(wk, a);
+		iterator->data.array.i = 0;
 		break;
 	case obj_dict: {
 		expected_args_to_unpack = 2;
@@ -1854,20 +2051,18 @@ vm_op_iterator_next(struct workspace *wk)
 
 	switch (iterator->type) {
 	case obj_iterator_type_array:
-		if (!iterator->data.array) {
+		if (iterator->data.array.i >= iterator->data.array.a->len) {
 			val = 0;
 		} else {
-			val = iterator->data.array->val;
-			iterator->data.array
-				= iterator->data.array->have_next ? get_obj_array(wk, iterator->data.array->next) : 0;
+			val = obj_array_elem(wk, iterator->data.array.a, iterator->data.array.i);
+			++iterator->data.array.i;
 		}
 		break;
 	case obj_iterator_type_range:
 		if (iterator->data.range.i >= iterator->data.range.stop) {
 			val = 0;
 		} else {
-			make_obj(wk, &val, obj_number);
-			set_obj_number(wk, val, iterator->data.range.i);
+			val = make_number(wk, iterator->data.range.i);
 			iterator->data.range.i += iterator->data.range.step;
 		}
 		break;
@@ -1885,17 +2080,17 @@ vm_op_iterator_next(struct workspace *wk)
 			}
 		}
 		break;
-	case obj_iterator_type_dict_big:
-		if (iterator->data.dict_big.i >= iterator->data.dict_big.h->keys.len) {
+	case obj_iterator_type_dict_big: {
+		uint64_t *v = hash_next_at(iterator->data.dict_big.h, &iterator->data.dict_big.i);
+		if (!v) {
 			val = 0;
 		} else {
-			void *k = arr_get(&iterator->data.dict_big.h->keys, iterator->data.dict_big.i);
-			uint64_t *v = hash_get(iterator->data.dict_big.h, k);
 			key = *v >> 32;
 			val = *v & 0xffffffff;
 			++iterator->data.dict_big.i;
 		}
 		break;
+	}
 	case obj_iterator_type_typeinfo: {
 		if (iterator->data.typeinfo.i) {
 			val = 0;
@@ -2044,6 +2239,8 @@ vm_op_return(struct workspace *wk)
 	case call_frame_type_func:
 		wk->vm.behavior.pop_local_scope(wk);
 		wk->vm.scope_stack = frame->scope_stack;
+		wk->vm.locals.len = wk->vm.locals_base;
+		wk->vm.locals_base = frame->locals_base;
 		wk->vm.lang_mode = frame->lang_mode;
 		vm_peek(a, 1);
 		typecheck_custom(wk, a_ip, a, frame->expected_return_type, "expected return type %s, got %s");
@@ -2128,7 +2325,10 @@ vm_unwind_call_stack(struct workspace *wk)
 			wk->vm.ip = frame->return_ip;
 			return;
 		}
-		case call_frame_type_func: break;
+		case call_frame_type_func:
+			wk->vm.locals.len = wk->vm.locals_base;
+			wk->vm.locals_base = frame->locals_base;
+			break;
 		}
 
 		if (frame->return_ip) {
@@ -2156,7 +2356,10 @@ vm_execute(struct workspace *wk)
 		object_stack_discard(&wk->vm.stack, wk->vm.stack.ba.len - object_stack_base);
 		return 0;
 	} else {
-		return object_stack_pop(&wk->vm.stack);
+		// The value of a trailing += is still owned by its variable.
+		obj res = object_stack_pop(&wk->vm.stack);
+		vm_disown(wk, res);
+		return res;
 	}
 }
 
@@ -2191,33 +2394,18 @@ vm_execute(struct workspace *wk)
  * scope_stack.
  */
 
-struct vm_check_scope_ctx {
-	const char *name;
-	obj res, scope;
-	bool found;
-};
-
-static enum iteration_result
-vm_check_scope(struct workspace *wk, void *_ctx, obj scope)
-{
-	struct vm_check_scope_ctx *ctx = _ctx;
-	if (obj_dict_index_str(wk, scope, ctx->name, &ctx->res)) {
-		ctx->scope = scope;
-		ctx->found = true;
-	}
-	return ir_cont;
-}
-
 static bool
 vm_get_local_variable(struct workspace *wk, const char *name, obj *res, obj *scope)
 {
-	struct vm_check_scope_ctx ctx = { .name = name };
-	obj_array_foreach(wk, wk->vm.scope_stack, &ctx, vm_check_scope);
+	struct obj_array *scopes = get_obj_array(wk, wk->vm.scope_stack);
+	uint32_t i;
 
-	if (ctx.found) {
-		*res = ctx.res;
-		*scope = ctx.scope;
-		return true;
+	for (i = scopes->len; i > 0; --i) {
+		obj s = obj_array_elem(wk, scopes, i - 1);
+		if (obj_dict_index_str(wk, s, name, res)) {
+			*scope = s;
+			return true;
+		}
 	}
 
 	return false;
@@ -2229,6 +2417,7 @@ vm_get_variable(struct workspace *wk, const char *name, obj *res)
 	obj o, _scope;
 
 	if (vm_get_local_variable(wk, name, &o, &_scope)) {
+		vm_disown(wk, o);
 		*res = o;
 		return true;
 	} else {
@@ -2252,6 +2441,9 @@ vm_scope_stack_dup(struct workspace *wk, obj scope_stack)
 	obj r;
 	make_obj(wk, &r, obj_array);
 
+	// The copied scopes share their values with the originals.
+	memset(wk->vm.owned_strs, 0, sizeof(wk->vm.owned_strs));
+
 	obj_array_foreach(wk, scope_stack, &r, vm_scope_stack_dup_iter);
 	return r;
 }
@@ -2434,6 +2626,9 @@ vm_init_objects(struct workspace *wk)
 	bucket_arr_init(&wk->vm.objects.objs, 1024, sizeof(struct obj_internal));
 	bucket_arr_init(&wk->vm.objects.dict_elems, 1024, sizeof(struct obj_dict_elem));
 	bucket_arr_init(&wk->vm.objects.dict_hashes, 16, sizeof(struct hash));
+	arr_init(&wk->vm.objects.array_elems, 1024, sizeof(obj));
+	arr_init(&wk->vm.objects.clear_mark_stores, 16, sizeof(obj));
+	arr_init(&wk->vm.objects.serial_bufs, 1, sizeof(void *));
 
 	const struct {
 		uint32_t item_size;
@@ -2485,6 +2680,15 @@ vm_init_objects(struct workspace *wk)
 	obj id;
 	make_obj(wk, &id, obj_null);
 	assert(id == 0);
+
+	make_obj(wk, &id, obj_disabler);
+	assert(id == disabler_id);
+
+	make_obj(wk, &id, obj_bool);
+	assert(id == obj_bool_true);
+
+	make_obj(wk, &id, obj_bool);
+	assert(id == obj_bool_false);
 }
 
 void
@@ -2498,11 +2702,14 @@ vm_init(struct workspace *wk)
 	arr_init(&wk->vm.code, 4 * 1024, 1);
 	arr_init(&wk->vm.src, 64, sizeof(struct source));
 	arr_init(&wk->vm.locations, 1024, sizeof(struct source_location_mapping));
+	arr_init(&wk->vm.method_cache, 256, sizeof(struct vm_method_cache_entry));
+	arr_init(&wk->vm.locals, 256, sizeof(obj));
 
 	/* compiler state */
 	arr_init(&wk->vm.compiler_state.node_stack, 4096, sizeof(struct node *));
 	arr_init(&wk->vm.compiler_state.if_jmp_stack, 64, sizeof(uint32_t));
 	arr_init(&wk->vm.compiler_state.loop_jmp_stack, 64, sizeof(uint32_t));
+	arr_init(&wk->vm.compiler_state.locals, 64, sizeof(obj));
 	bucket_arr_init(&wk->vm.compiler_state.nodes, 2048, sizeof(struct node));
 
 	/* behavior pointers */
@@ -2542,6 +2749,9 @@ vm_init(struct workspace *wk)
 					      [op_add_store] = vm_op_add_store,
 					      [op_try_load] = vm_op_try_load,
 					      [op_load] = vm_op_load,
+					      [op_load_local] = vm_op_load_local,
+					      [op_store_local] = vm_op_store_local,
+					      [op_add_store_local] = vm_op_add_store_local,
 					      [op_return] = vm_op_return,
 					      [op_return_end] = vm_op_return,
 					      [op_call] = vm_op_call,
@@ -2565,16 +2775,6 @@ vm_init(struct workspace *wk)
 	vm_init_objects(wk);
 
 	obj id;
-	make_obj(wk, &id, obj_disabler);
-	assert(id == disabler_id);
-
-	make_obj(wk, &id, obj_bool);
-	assert(id == obj_bool_true);
-	set_obj_bool(wk, id, true);
-
-	make_obj(wk, &id, obj_bool);
-	assert(id == obj_bool_false);
-	set_obj_bool(wk, id, false);
 
 	/* func impl tables */
 	build_func_impl_tables();
@@ -2628,6 +2828,13 @@ vm_destroy_objects(struct workspace *wk)
 	bucket_arr_destroy(&wk->vm.objects.objs);
 	bucket_arr_destroy(&wk->vm.objects.dict_elems);
 	bucket_arr_destroy(&wk->vm.objects.dict_hashes);
+	arr_destroy(&wk->vm.objects.array_elems);
+	arr_destroy(&wk->vm.objects.clear_mark_stores);
+
+	for (i = 0; i < wk->vm.objects.serial_bufs.len; ++i) {
+		z_free(*(void **)arr_get(&wk->vm.objects.serial_bufs, i));
+	}
+	arr_destroy(&wk->vm.objects.serial_bufs);
 
 	hash_destroy(&wk->vm.objects.obj_hash);
 	hash_destroy(&wk->vm.objects.str_hash);
@@ -2649,9 +2856,12 @@ vm_destroy(struct workspace *wk)
 	}
 	arr_destroy(&wk->vm.src);
 	arr_destroy(&wk->vm.locations);
+	arr_destroy(&wk->vm.method_cache);
+	arr_destroy(&wk->vm.locals);
 
 	arr_destroy(&wk->vm.compiler_state.node_stack);
 	arr_destroy(&wk->vm.compiler_state.if_jmp_stack);
 	arr_destroy(&wk->vm.compiler_state.loop_jmp_stack);
+	arr_destroy(&wk->vm.compiler_state.locals);
 	bucket_arr_destroy(&wk->vm.compiler_state.nodes);
 }
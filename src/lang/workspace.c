@@ -15,6 +15,7 @@
 #include "options.h"
 #include "platform/mem.h"
 #include "platform/path.h"
+#include "profile.h"
 
 struct project *
 make_project(struct workspace *wk, uint32_t *id, const char *subproject_name, const char *cwd, const char *build_dir)
@@ -128,6 +129,8 @@ workspace_init_runtime(struct workspace *wk)
 	make_obj(wk, &wk->global_opts, obj_dict);
 	make_obj(wk, &wk->compiler_check_cache, obj_dict);
 	make_obj(wk, &wk->dependency_handlers, obj_dict);
+	make_obj(wk, &wk->fingerprint_env, obj_dict);
+	make_obj(wk, &wk->fingerprint_run_commands, obj_array);
 }
 
 void
@@ -170,6 +173,9 @@ workspace_destroy(struct workspace *wk)
 {
 	arr_destroy(&wk->projects);
 	arr_destroy(&wk->option_overrides);
+	if (wk->profile) {
+		profile_destroy(wk);
+	}
 	workspace_destroy_bare(wk);
 }
 
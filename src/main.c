@@ -15,6 +15,7 @@
 #include "backend/output.h"
 #include "cmd_install.h"
 #include "cmd_test.h"
+#include "configure_fingerprint.h"
 #include "embedded.h"
 #include "external/libarchive.h"
 #include "external/libcurl.h"
@@ -31,8 +32,10 @@
 #include "opts.h"
 #include "platform/init.h"
 #include "platform/mem.h"
+#include "platform/os.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "profile.h"
 #include "tracy.h"
 #include "version.h"
 #include "wrap.h"
@@ -452,8 +455,18 @@ ret:
 
 struct cmd_subprojects_download_ctx {
 	const char *subprojects;
+	struct arr wrap_files;
 };
 
+static void
+cmd_subprojects_download_push(struct cmd_subprojects_download_ctx *ctx, const char *path)
+{
+	uint32_t len = strlen(path);
+	char *p = z_malloc(len + 1);
+	memcpy(p, path, len + 1);
+	arr_push(&ctx->wrap_files, &p);
+}
+
 static enum iteration_result
 cmd_subprojects_download_iter(void *_ctx, const char *name)
 {
@@ -471,13 +484,7 @@ cmd_subprojects_download_iter(void *_ctx, const char *name)
 		goto cont;
 	}
 
-	LOG_I("fetching %s", name);
-	struct wrap wrap = { 0 };
-	if (!wrap_handle(path.buf, ctx->subprojects, &wrap, true)) {
-		goto cont;
-	}
-
-	wrap_destroy(&wrap);
+	cmd_subprojects_download_push(ctx, path.buf);
 cont:
 	sbuf_destroy(&path);
 	return ir_cont;
@@ -487,10 +494,27 @@ static bool
 cmd_subprojects_download(uint32_t argc, uint32_t argi, char *const argv[])
 {
 	bool res = false;
+	uint32_t i, jobs = os_parallel_job_count();
 
-	OPTSTART("") {
+	OPTSTART("j:") {
+	case 'j': {
+		char *endptr;
+		unsigned long n = strtoul(optarg, &endptr, 10);
+
+		if (n > UINT32_MAX || !n || !*optarg || *endptr) {
+			LOG_E("invalid number of jobs: %s", optarg);
+			return false;
+		}
+
+		jobs = n;
+		break;
+	}
 	}
-	OPTEND(argv[argi], " <list of subprojects>", "", NULL, -1)
+	OPTEND(argv[argi],
+		" <list of subprojects>",
+		"  -j <jobs> - set the number of parallel downloads\n",
+		NULL,
+		-1)
 
 	SBUF_manual(path);
 	path_make_absolute(NULL, &path, cmd_subprojects_subprojects_dir);
@@ -499,6 +523,8 @@ cmd_subprojects_download(uint32_t argc, uint32_t argi, char *const argv[])
 		.subprojects = path.buf,
 	};
 
+	arr_init(&ctx.wrap_files, 8, sizeof(char *));
+
 	if (argc > argi) {
 		SBUF_manual(wrap_file);
 
@@ -509,21 +535,25 @@ cmd_subprojects_download(uint32_t argc, uint32_t argi, char *const argv[])
 
 			if (!fs_file_exists(wrap_file.buf)) {
 				LOG_E("wrap file for '%s' not found", argv[argi]);
+				sbuf_destroy(&wrap_file);
 				goto ret;
 			}
 
-			if (cmd_subprojects_download_iter(&ctx, wrap_file.buf) == ir_err) {
-				goto ret;
-			}
+			cmd_subprojects_download_push(&ctx, wrap_file.buf);
 		}
 
 		sbuf_destroy(&wrap_file);
-		res = true;
-	} else {
-		res = fs_dir_foreach(path.buf, &ctx, cmd_subprojects_download_iter);
+	} else if (!fs_dir_foreach(path.buf, &ctx, cmd_subprojects_download_iter)) {
+		goto ret;
 	}
 
+	res = wrap_handle_all(
+		(const char *const *)ctx.wrap_files.e, ctx.wrap_files.len, ctx.subprojects, jobs);
 ret:
+	for (i = 0; i < ctx.wrap_files.len; ++i) {
+		z_free(*(char **)arr_get(&ctx.wrap_files, i));
+	}
+	arr_destroy(&ctx.wrap_files);
 	sbuf_destroy(&path);
 	return res;
 }
@@ -805,8 +835,10 @@ cmd_setup(uint32_t argc, uint32_t argi, char *const argv[])
 	workspace_init_runtime(&wk);
 
 	uint32_t original_argi = argi + 1;
+	const char *profile_path = NULL;
+	bool force = false, regenerate = false;
 
-	OPTSTART("D:c:b:") {
+	OPTSTART("D:c:b:p:r") {
 	case 'D':
 		if (!parse_and_set_cmdline_option(&wk, optarg)) {
 			goto ret;
@@ -826,14 +858,19 @@ cmd_setup(uint32_t argc, uint32_t argi, char *const argv[])
 	}
 	case 'b': {
 		vm_dbg_push_breakpoint(&wk, optarg);
+		force = true;
 		break;
 	}
+	case 'p': profile_path = optarg; break;
+	case 'r': regenerate = true; break;
 	}
 	OPTEND(argv[argi],
 		" <build dir>",
 		"  -D <option>=<value> - set project options\n"
 		"  -c <compiler_check_cache.dat> - path to compiler check cache dump\n"
-		"  -b <breakpoint> - set breakpoint\n",
+		"  -b <breakpoint> - set breakpoint\n"
+		"  -p <file> - write a configure profile to <file>\n"
+		"  -r - only reconfigure if inputs changed since the last configure\n",
 		NULL,
 		1)
 
@@ -846,6 +883,17 @@ cmd_setup(uint32_t argc, uint32_t argi, char *const argv[])
 
 	workspace_init_startup_files(&wk);
 
+	obj fingerprint_opts;
+	if (configure_fingerprint_check(&wk, !regenerate || force || profile_path, &fingerprint_opts)) {
+		LOG_I("configuration is up to date");
+		res = true;
+		goto ret;
+	}
+
+	if (profile_path) {
+		profile_init(&wk, profile_path);
+	}
+
 	uint32_t project_id;
 	if (!eval_project(&wk, NULL, wk.source_root, wk.build_root, &project_id)) {
 		goto ret;
@@ -853,16 +901,32 @@ cmd_setup(uint32_t argc, uint32_t argi, char *const argv[])
 
 	log_plain("\n");
 
+	if (wk.profile) {
+		profile_push(&wk, "[backend]");
+	}
+
 	if (!backend_output(&wk)) {
 		goto ret;
 	}
 
+	if (wk.profile) {
+		profile_pop(&wk);
+	}
+
+	if (!configure_fingerprint_write(&wk, fingerprint_opts)) {
+		goto ret;
+	}
+
 	workspace_print_summaries(&wk, log_file());
 
 	LOG_I("setup complete");
 
 	res = true;
 ret:
+	if (wk.profile && !profile_write(&wk)) {
+		res = false;
+	}
+
 	workspace_destroy(&wk);
 	TracyCZoneAutoE;
 	return res;
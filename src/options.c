@@ -10,6 +10,7 @@
 #include <string.h>
 
 #include "backend/output.h"
+#include "configure_fingerprint.h"
 #include "embedded.h"
 #include "error.h"
 #include "lang/serial.h"
@@ -318,8 +319,7 @@ coerce_option_override(struct workspace *wk, struct obj_option *opt, obj sval, o
 			return false;
 		}
 
-		make_obj(wk, res, obj_bool);
-		set_obj_bool(wk, *res, b);
+		*res = make_obj_bool(wk, b);
 		break;
 	}
 	case op_integer: {
@@ -332,8 +332,7 @@ coerce_option_override(struct workspace *wk, struct obj_option *opt, obj sval, o
 			return false;
 		}
 
-		make_obj(wk, res, obj_number);
-		set_obj_number(wk, *res, num);
+		*res = make_number(wk, num);
 		break;
 	}
 	case op_array: {
@@ -615,7 +614,7 @@ set_binary_from_env(struct workspace *wk, const char *envvar, const char *dest)
 	}
 
 	const char *v;
-	if (!(v = getenv(envvar)) || !*v) {
+	if (!(v = configure_fingerprint_getenv(wk, envvar)) || !*v) {
 		return;
 	}
 
@@ -632,11 +631,11 @@ set_compile_opt_from_env(struct workspace *wk, const char *name, const char *fla
 		UNREACHABLE;
 	}
 
-	if ((flags = getenv(flags)) && *flags) {
+	if ((flags = configure_fingerprint_getenv(wk, flags)) && *flags) {
 		extend_array_option(wk, opt, str_split(wk, &WKSTR(flags), NULL), option_value_source_environment);
 	}
 
-	if ((extra = getenv(extra)) && *extra) {
+	if ((extra = configure_fingerprint_getenv(wk, extra)) && *extra) {
 		extend_array_option(wk, opt, str_split(wk, &WKSTR(extra), NULL), option_value_source_environment);
 	}
 }
@@ -650,7 +649,7 @@ set_str_opt_from_env(struct workspace *wk, const char *env_name, const char *opt
 	}
 
 	const char *env_val;
-	if ((env_val = getenv(env_name)) && *env_val) {
+	if ((env_val = configure_fingerprint_getenv(wk, env_name)) && *env_val) {
 		set_option(wk, opt, make_str(wk, env_val), option_value_source_environment, false);
 	}
 }
@@ -811,11 +810,20 @@ init_global_options(struct workspace *wk)
 		    "option('c_args', type: 'array', value: [])\n"
 		    "option('c_link_args', type: 'array', value: [])\n"
 		    "option('werror', type: 'boolean', value: false)\n"
+		    "option('unity', type: 'combo', value: 'off', choices: ['on', 'off', 'subprojects'])\n"
+		    "option('unity_size', type: 'integer', value: 4, min: 2)\n"
+		    "option('b_pch', type: 'boolean', value: true)\n"
+		    "option('b_lto_threads', type: 'integer', value: 0, min: 0)\n"
+		    "option('b_lto_mode', type: 'combo', value: 'default', choices: ['default', 'thin'])\n"
+		    "option('b_thinlto_cache', type: 'boolean', value: false)\n"
+		    "option('b_thinlto_cache_dir', type: 'string', value: '')\n"
 
 		    "option('env.CC', type: 'array', value: ['cc'])\n"
 		    "option('env.NINJA', type: 'array', value: ['ninja'])\n"
 		    "option('env.AR', type: 'array', value: ['ar'])\n"
-		    "option('env.LD', type: 'array', value: ['ld'])\n")) {
+		    "option('env.LD', type: 'array', value: ['ld'])\n"
+
+		    "option('muon.configure_cache', type: 'boolean', value: true)\n")) {
 		return false;
 	}
 
@@ -1028,6 +1036,26 @@ get_option_bool(struct workspace *wk, obj overrides, const char *name, bool fall
 	}
 }
 
+/*
+ * Returns true if targets of proj with the given override_options should be
+ * built as unity builds, and the number of sources per unity file.
+ */
+bool
+get_option_unity(struct workspace *wk, const struct project *proj, obj overrides, uint32_t *unity_size)
+{
+	obj opt;
+	get_option_value_overridable(wk, proj, overrides, "unity", &opt);
+
+	if (str_eql(get_str(wk, opt), &WKSTR("off"))
+		|| (str_eql(get_str(wk, opt), &WKSTR("subprojects")) && !proj->subproject_name)) {
+		return false;
+	}
+
+	get_option_value_overridable(wk, proj, overrides, "unity_size", &opt);
+	*unity_size = get_obj_number(wk, opt);
+	return true;
+}
+
 /* options listing subcommand */
 
 struct make_option_choices_ctx {
@@ -303,6 +303,49 @@ fs_remove(const char *path)
 	return true;
 }
 
+bool
+fs_rename(const char *src, const char *dest)
+{
+	if (rename(src, dest) != 0) {
+		LOG_E("failed rename(\"%s\", \"%s\"): %s", src, dest, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool
+fs_memstream_open(struct fs_memstream *ms)
+{
+	*ms = (struct fs_memstream){ 0 };
+	if (!(ms->f = open_memstream(&ms->buf, &ms->len))) {
+		LOG_E("failed open_memstream(): %s", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool
+fs_memstream_close(struct fs_memstream *ms)
+{
+	FILE *f = ms->f;
+	ms->f = NULL;
+	return fs_fclose(f);
+}
+
+void
+fs_memstream_destroy(struct fs_memstream *ms)
+{
+	if (ms->f) {
+		fs_fclose(ms->f);
+	}
+
+	// allocated by open_memstream
+	free(ms->buf);
+	*ms = (struct fs_memstream){ 0 };
+}
+
 bool
 fs_make_symlink(const char *target, const char *path, bool force)
 {
@@ -23,6 +23,7 @@
 #include "platform/mem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "platform/timer.h"
 
 extern char **environ;
 
@@ -330,7 +331,11 @@ run_cmd_internal(struct run_cmd_ctx *ctx, const char *_cmd, char *const *argv, c
 		return true;
 	}
 
-	return run_cmd_collect(ctx) == run_cmd_finished;
+	struct timer t;
+	timer_start(&t);
+	bool ok = run_cmd_collect(ctx) == run_cmd_finished;
+	run_cmd_wait_time += timer_read(&t);
+	return ok;
 err:
 	return false;
 }
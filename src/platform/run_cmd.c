@@ -20,6 +20,8 @@
 #include "platform/mem.h"
 #include "platform/run_cmd.h"
 
+double run_cmd_wait_time;
+
 void
 push_argv_single(const char **argv, uint32_t *len, uint32_t max, const char *arg)
 {
@@ -539,3 +539,66 @@ fs_remove(const char *path)
 
 	return true;
 }
+
+bool
+fs_rename(const char *src, const char *dest)
+{
+	if (!MoveFileExA(src, dest, MOVEFILE_REPLACE_EXISTING)) {
+		LOG_E("failed MoveFileEx(\"%s\", \"%s\"): %s", src, dest, win32_error());
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * There is no open_memstream, so the stream is an anonymous temporary file
+ * that is read back when it is closed.
+ */
+bool
+fs_memstream_open(struct fs_memstream *ms)
+{
+	*ms = (struct fs_memstream){ 0 };
+	if (!(ms->f = tmpfile())) {
+		LOG_E("failed tmpfile(): %s", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool
+fs_memstream_close(struct fs_memstream *ms)
+{
+	uint64_t size;
+	bool ret = false;
+
+	if (!fs_fsize(ms->f, &size)) {
+		goto ret;
+	}
+
+	ms->len = size;
+	ms->buf = z_malloc(ms->len + 1);
+	if (ms->len && !fs_fread(ms->buf, ms->len, ms->f)) {
+		goto ret;
+	}
+
+	ret = true;
+ret:
+	if (!fs_fclose(ms->f)) {
+		ret = false;
+	}
+	ms->f = NULL;
+	return ret;
+}
+
+void
+fs_memstream_destroy(struct fs_memstream *ms)
+{
+	if (ms->f) {
+		fs_fclose(ms->f);
+	}
+
+	z_free(ms->buf);
+	*ms = (struct fs_memstream){ 0 };
+}
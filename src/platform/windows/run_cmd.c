@@ -480,7 +480,11 @@ run_cmd_internal(struct run_cmd_ctx *ctx, char *command_line, const char *envstr
 		return true;
 	}
 
-	return run_cmd_collect(ctx) == run_cmd_finished;
+	struct timer t;
+	timer_start(&t);
+	bool ok = run_cmd_collect(ctx) == run_cmd_finished;
+	run_cmd_wait_time += timer_read(&t);
+	return ok;
 }
 
 static bool
@@ -0,0 +1,373 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error.h"
+#include "lang/func_lookup.h"
+#include "log.h"
+#include "platform/filesystem.h"
+#include "platform/mem.h"
+#include "platform/path.h"
+#include "platform/run_cmd.h"
+#include "platform/timer.h"
+#include "profile.h"
+
+/*
+ * Configure profiler, enabled with `muon setup -p <file>`.
+ *
+ * Time is attributed to a tree of frames: the project files being evaluated,
+ * native function calls identified by their call site, and a few phases such
+ * as backend output.  Every frame records its wall time, the part of it spent
+ * waiting on synchronously run commands, e.g. compiler checks and
+ * run_command(), and how many compiler checks it performed along with how
+ * many of those were answered by the compiler check cache.
+ *
+ * The tree is written as folded stacks with self times in microseconds, ready
+ * to be passed to flamegraph tools.  Time spent waiting on commands shows up
+ * as a [process] child of the frame that ran them.  A table of the call sites
+ * with the most self time is printed as well.
+ *
+ * Frame names are plain C strings rather than objects so that they survive
+ * objects being cleared, e.g. during backend output.
+ */
+
+enum {
+	profile_summary_len = 20,
+};
+
+struct profile_node {
+	const char *name;
+	uint32_t parent;
+	uint32_t calls, checks, checks_cached;
+	double total, wait;
+};
+
+struct profile_frame {
+	uint32_t node;
+	struct timer t;
+	double wait_start;
+};
+
+struct profile_call_site {
+	uint32_t parent, func_idx, src_idx, off;
+};
+
+struct profile {
+	const char *path;
+	struct arr nodes, frames;
+	// struct profile_call_site -> node
+	struct hash call_sites;
+	// labels of wk->vm.src entries, by index
+	struct arr src_labels;
+	bool((*native_func_dispatch)(struct workspace *wk, uint32_t func_idx, obj self, obj *res));
+};
+
+static const char *
+profile_strdup(const char *s)
+{
+	uint32_t len = strlen(s);
+	char *r = z_malloc(len + 1);
+	memcpy(r, s, len + 1);
+	return r;
+}
+
+// Paths inside the source root are shown relative to it.
+static const char *
+profile_label(struct workspace *wk, const char *path)
+{
+	if (wk->source_root && path_is_absolute(path) && path_is_subpath(wk->source_root, path)) {
+		SBUF(rel);
+		path_relative_to(wk, &rel, wk->source_root, path);
+		return profile_strdup(rel.buf);
+	}
+
+	return profile_strdup(path);
+}
+
+static const char *
+profile_src_label(struct workspace *wk, uint32_t src_idx)
+{
+	struct profile *p = wk->profile;
+
+	while (p->src_labels.len <= src_idx) {
+		arr_push(&p->src_labels, &(const char *){ 0 });
+	}
+
+	const char **label = arr_get(&p->src_labels, src_idx);
+	if (!*label) {
+		*label = profile_label(wk, ((struct source *)arr_get(&wk->vm.src, src_idx))->label);
+	}
+
+	return *label;
+}
+
+static uint32_t
+profile_make_node(struct profile *p, const char *name)
+{
+	uint32_t parent = p->frames.len ? ((struct profile_frame *)arr_peek(&p->frames, 1))->node : UINT32_MAX;
+	return arr_push(&p->nodes, &(struct profile_node){ .name = name, .parent = parent });
+}
+
+static void
+profile_push_node(struct profile *p, uint32_t node)
+{
+	struct profile_frame frame = { .node = node, .wait_start = run_cmd_wait_time };
+	timer_start(&frame.t);
+	arr_push(&p->frames, &frame);
+}
+
+static bool
+profile_native_func_dispatch(struct workspace *wk, uint32_t func_idx, obj self, obj *res)
+{
+	struct profile *p = wk->profile;
+
+	struct source_location loc;
+	uint32_t src_idx;
+	vm_lookup_inst_location_src_idx(&wk->vm, wk->vm.ip - 1, &loc, &src_idx);
+
+	const struct profile_call_site key = {
+		.parent = ((struct profile_frame *)arr_peek(&p->frames, 1))->node,
+		.func_idx = func_idx,
+		.src_idx = src_idx,
+		.off = loc.off,
+	};
+
+	uint32_t node;
+	const uint64_t *v;
+	if ((v = hash_get(&p->call_sites, &key))) {
+		node = *v;
+	} else {
+		char name[1024];
+		uint32_t len = 0;
+
+		if (src_idx < wk->vm.src.len) {
+			struct detailed_source_location dloc;
+			get_detailed_source_location(arr_get(&wk->vm.src, src_idx), loc, &dloc, 0);
+			len = snprintf(name, sizeof(name), "%s:%d ", profile_src_label(wk, src_idx), dloc.line);
+		}
+
+		if (self && len < sizeof(name)) {
+			len += snprintf(&name[len], sizeof(name) - len, "%s.", obj_type_to_s(get_obj_type(wk, self)));
+		}
+
+		if (len < sizeof(name)) {
+			snprintf(&name[len], sizeof(name) - len, "%s()", native_funcs[func_idx].name);
+		}
+
+		node = profile_make_node(p, profile_strdup(name));
+		hash_set(&p->call_sites, &key, node);
+	}
+
+	profile_push_node(p, node);
+	bool ok = p->native_func_dispatch(wk, func_idx, self, res);
+	profile_pop(wk);
+	return ok;
+}
+
+void
+profile_init(struct workspace *wk, const char *path)
+{
+	struct profile *p = z_calloc(1, sizeof(struct profile));
+	p->path = path;
+	arr_init(&p->nodes, 256, sizeof(struct profile_node));
+	arr_init(&p->frames, 16, sizeof(struct profile_frame));
+	arr_init(&p->src_labels, 16, sizeof(const char *));
+	hash_init(&p->call_sites, 256, sizeof(struct profile_call_site));
+
+	p->native_func_dispatch = wk->vm.behavior.native_func_dispatch;
+	wk->vm.behavior.native_func_dispatch = profile_native_func_dispatch;
+
+	wk->profile = p;
+	profile_push(wk, "setup");
+}
+
+void
+profile_push(struct workspace *wk, const char *name)
+{
+	struct profile *p = wk->profile;
+	profile_push_node(p, profile_make_node(p, profile_label(wk, name)));
+}
+
+void
+profile_pop(struct workspace *wk)
+{
+	struct profile *p = wk->profile;
+	struct profile_frame *frame = arr_pop(&p->frames);
+	struct profile_node *n = arr_get(&p->nodes, frame->node);
+
+	++n->calls;
+	n->total += timer_read(&frame->t);
+	n->wait += run_cmd_wait_time - frame->wait_start;
+}
+
+void
+profile_compiler_check(struct workspace *wk, bool cached)
+{
+	struct profile *p = wk->profile;
+	struct profile_node *n = arr_get(&p->nodes, ((struct profile_frame *)arr_peek(&p->frames, 1))->node);
+
+	++n->checks;
+	if (cached) {
+		++n->checks_cached;
+	}
+}
+
+static uint64_t
+profile_us(double secs)
+{
+	return secs > 0 ? (uint64_t)(secs * 1e6 + 0.5) : 0;
+}
+
+static void
+profile_write_stack(FILE *f, struct profile *p, uint32_t node)
+{
+	const struct profile_node *n = arr_get(&p->nodes, node);
+	if (n->parent != UINT32_MAX) {
+		profile_write_stack(f, p, n->parent);
+		fputc(';', f);
+	}
+
+	fputs(n->name, f);
+}
+
+struct profile_summary_entry {
+	const char *name;
+	uint32_t calls, checks, checks_cached;
+	double self, total, wait;
+};
+
+static int32_t
+profile_summary_entry_cmp(const void *_a, const void *_b, void *_ctx)
+{
+	const struct profile_summary_entry *a = _a, *b = _b;
+	return a->self < b->self ? 1 : a->self > b->self ? -1 : 0;
+}
+
+bool
+profile_write(struct workspace *wk)
+{
+	struct profile *p = wk->profile;
+	uint32_t i;
+
+	while (p->frames.len) {
+		profile_pop(wk);
+	}
+
+	const uint32_t len = p->nodes.len;
+	double *self = z_calloc(len, sizeof(double) * 2), *self_wait = &self[len];
+	for (i = 0; i < len; ++i) {
+		const struct profile_node *n = arr_get(&p->nodes, i);
+		self[i] += n->total;
+		self_wait[i] += n->wait;
+		if (n->parent != UINT32_MAX) {
+			self[n->parent] -= n->total;
+			self_wait[n->parent] -= n->wait;
+		}
+	}
+
+	bool ok = false;
+	FILE *f;
+	if (!(f = fs_fopen(p->path, "wb"))) {
+		goto ret;
+	}
+
+	for (i = 0; i < len; ++i) {
+		uint64_t wall_us = profile_us(self[i] - self_wait[i]), wait_us = profile_us(self_wait[i]);
+		if (wall_us) {
+			profile_write_stack(f, p, i);
+			fprintf(f, " %" PRIu64 "\n", wall_us);
+		}
+
+		if (wait_us) {
+			profile_write_stack(f, p, i);
+			fprintf(f, ";[process] %" PRIu64 "\n", wait_us);
+		}
+	}
+
+	if (!fs_fclose(f)) {
+		goto ret;
+	}
+
+	// The same call site may be reached through several stacks, e.g. a
+	// function called from different places, so merge those first.
+	struct hash by_name;
+	struct arr entries;
+	hash_init_str(&by_name, 256);
+	arr_init(&entries, 256, sizeof(struct profile_summary_entry));
+
+	for (i = 1; i < len; ++i) {
+		const struct profile_node *n = arr_get(&p->nodes, i);
+		struct profile_summary_entry *e;
+		const uint64_t *v;
+		if ((v = hash_get_strn(&by_name, n->name, strlen(n->name)))) {
+			e = arr_get(&entries, *v);
+		} else {
+			hash_set_strn(&by_name, n->name, strlen(n->name), entries.len);
+			e = arr_get(&entries, arr_push(&entries, &(struct profile_summary_entry){ .name = n->name }));
+		}
+
+		e->calls += n->calls;
+		e->checks += n->checks;
+		e->checks_cached += n->checks_cached;
+		e->self += self[i];
+		e->total += n->total;
+		e->wait += self_wait[i];
+	}
+
+	arr_sort(&entries, NULL, profile_summary_entry_cmp);
+
+	const struct profile_node *root = arr_get(&p->nodes, 0);
+	log_plain("\nprofile: %.3fs total, %.3fs waiting on commands, written to %s\n", root->total, root->wait, p->path);
+	log_plain("%10s %10s %10s %8s %9s  %s\n", "self ms", "total ms", "cmd ms", "calls", "checks", "location");
+	for (i = 0; i < entries.len && i < profile_summary_len; ++i) {
+		const struct profile_summary_entry *e = arr_get(&entries, i);
+		char checks[32] = "";
+		if (e->checks) {
+			snprintf(checks, sizeof(checks), "%d/%d", e->checks_cached, e->checks);
+		}
+
+		log_plain("%10.2f %10.2f %10.2f %8d %9s  %s\n",
+			e->self * 1e3,
+			e->total * 1e3,
+			e->wait * 1e3,
+			e->calls,
+			checks,
+			e->name);
+	}
+	log_plain("checks are shown as cached/total\n");
+
+	hash_destroy(&by_name);
+	arr_destroy(&entries);
+	ok = true;
+ret:
+	z_free(self);
+	return ok;
+}
+
+void
+profile_destroy(struct workspace *wk)
+{
+	struct profile *p = wk->profile;
+	uint32_t i;
+
+	for (i = 0; i < p->nodes.len; ++i) {
+		const struct profile_node *n = arr_get(&p->nodes, i);
+		z_free((void *)n->name);
+	}
+
+	arr_destroy(&p->nodes);
+	arr_destroy(&p->frames);
+	arr_destroy(&p->src_labels);
+	hash_destroy(&p->call_sites);
+
+	wk->vm.behavior.native_func_dispatch = p->native_func_dispatch;
+	z_free(p);
+	wk->profile = NULL;
+}
@@ -120,4 +120,5 @@ print(json.dumps({
   'link_libpython': links_against_libpython(),
   'suffix': suffix,
   'limited_api_suffix': limited_api_suffix,
+  'sys_path': sys.path,
 }))
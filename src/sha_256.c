@@ -91,14 +91,6 @@ static const uint32_t k[] = { 0x428a2f98,
 	0xbef9a3f7,
 	0xc67178f2 };
 
-struct buffer_state {
-	const uint8_t *p;
-	size_t len;
-	size_t total_len;
-	int single_one_delivered; /* bool */
-	int total_len_delivered; /* bool */
-};
-
 static inline uint32_t
 right_rot(uint32_t value, unsigned int count)
 {
@@ -109,182 +101,183 @@ right_rot(uint32_t value, unsigned int count)
 }
 
 static void
-init_buf_state(struct buffer_state *state, const void *input, size_t len)
-{
-	state->p = input;
-	state->len = len;
-	state->total_len = len;
-	state->single_one_delivered = 0;
-	state->total_len_delivered = 0;
-}
-
-static inline const uint8_t *
-calc_chunk(uint8_t chunk[CHUNK_SIZE], struct buffer_state *state)
+consume_chunk(uint32_t h[8], const uint8_t *p)
 {
-	if (state->total_len_delivered) {
-		return NULL;
-	}
+	unsigned i, j;
+	uint32_t ah[8];
 
-	/* For whole chunks, there is no need to copy data, we just return the original chunk. */
-	if (state->len >= CHUNK_SIZE) {
-		const uint8_t *const chunk_start = state->p;
-		state->p += CHUNK_SIZE;
-		state->len -= CHUNK_SIZE;
-		return chunk_start;
+	/* Initialize working variables to current hash value: */
+	for (i = 0; i < 8; i++) {
+		ah[i] = h[i];
 	}
 
-	const uint8_t *const chunk_start = chunk;
-	memcpy(chunk, state->p, state->len);
-	chunk += state->len;
-	size_t space_in_chunk = CHUNK_SIZE - state->len;
-	state->p += state->len;
-	state->len = 0;
-
-	/* If we are here, space_in_chunk is one at minimum. */
-	if (!state->single_one_delivered) {
-		*chunk++ = 0x80;
-		space_in_chunk -= 1;
-		state->single_one_delivered = 1;
-	}
+	/*
+	 * The w-array is really w[64], but since we only need 16 of them at a time, we save stack by calculating 16 at
+	 * a time.
+	 *
+	 * This optimization was not there initially and the rest of the comments about w[64] are kept in their initial
+	 * state.
+	 */
 
 	/*
-	 * Now:
-	 * - either there is enough space left for the total length, and we can conclude,
-	 * - or there is too little space left, and we have to pad the rest of this chunk with zeroes. In the latter
-	 *   case, we will conclude at the next invocation of this function.
+	 * create a 64-entry message schedule array w[0..63] of 32-bit words (The initial values in w[0..63] don't
+	 * matter, so many implementations zero them here) copy chunk into first 16 words w[0..15] of the message
+	 * schedule array
 	 */
-	if (space_in_chunk >= TOTAL_LEN_LEN) {
-		const size_t left = space_in_chunk - TOTAL_LEN_LEN;
-		size_t len = state->total_len;
-		int i;
-		memset(chunk, 0x00, left);
-		chunk += left;
+	uint32_t w[16];
+
+	/* Compression function main loop: */
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < 16; j++) {
+			if (i == 0) {
+				w[j] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+				p += 4;
+			} else {
+				/* Extend the first 16 words into the remaining 48 words w[16..63] of the message
+				 * schedule array: */
+				const uint32_t s0 = right_rot(w[(j + 1) & 0xf], 7) ^ right_rot(w[(j + 1) & 0xf], 18)
+						    ^ (w[(j + 1) & 0xf] >> 3);
+				const uint32_t s1 = right_rot(w[(j + 14) & 0xf], 17) ^ right_rot(w[(j + 14) & 0xf], 19)
+						    ^ (w[(j + 14) & 0xf] >> 10);
+				w[j] = w[j] + s0 + w[(j + 9) & 0xf] + s1;
+			}
+			const uint32_t s1 = right_rot(ah[4], 6) ^ right_rot(ah[4], 11) ^ right_rot(ah[4], 25);
+			const uint32_t ch = (ah[4] & ah[5]) ^ (~ah[4] & ah[6]);
+			const uint32_t temp1 = ah[7] + s1 + ch + k[i << 4 | j] + w[j];
+			const uint32_t s0 = right_rot(ah[0], 2) ^ right_rot(ah[0], 13) ^ right_rot(ah[0], 22);
+			const uint32_t maj = (ah[0] & ah[1]) ^ (ah[0] & ah[2]) ^ (ah[1] & ah[2]);
+			const uint32_t temp2 = s0 + maj;
 
-		/* Storing of len * 8 as a big endian 64-bit without overflow. */
-		chunk[7] = (uint8_t)(len << 3);
-		len >>= 5;
-		for (i = 6; i >= 0; i--) {
-			chunk[i] = (uint8_t)len;
-			len >>= 8;
+			ah[7] = ah[6];
+			ah[6] = ah[5];
+			ah[5] = ah[4];
+			ah[4] = ah[3] + temp1;
+			ah[3] = ah[2];
+			ah[2] = ah[1];
+			ah[1] = ah[0];
+			ah[0] = temp1 + temp2;
 		}
-		state->total_len_delivered = 1;
-	} else {
-		memset(chunk, 0x00, space_in_chunk);
 	}
 
-	return chunk_start;
+	/* Add the compressed chunk to the current hash value: */
+	for (i = 0; i < 8; i++) {
+		h[i] += ah[i];
+	}
 }
 
-/*
- * Limitations:
- * - Since input is a pointer, the data to hash must be directly accessible to the processor, which could be a problem
- *   for large data sizes.
- * - SHA algorithms theoretically operate on bit strings. However, this implementation has no support for bit string
- *   lengths that are not multiples of eight, and it really operates on arrays of bytes.  In particular, the len
- *   parameter is a number of bytes.
- */
 void
-calc_sha_256(uint8_t hash[32], const void *input, size_t len)
+sha_256_init(struct sha_256 *sha)
 {
-	/*
-	 * Note 1: All integers (expect indexes) are 32-bit unsigned integers and addition is calculated modulo 2^32.
-	 *
-	 * Note 2: For each round, there is one round constant k[i] and one entry in the message schedule array w[i], 0
-	 * <= i <= 63.
-	 *
-	 * Note 3: The compression function uses 8 working variables, a through h.
-	 *
-	 * Note 4: Big-endian convention is used when expressing the constants in this pseudocode, and when parsing
-	 * message block data from bytes to words, for example, the first word of the input message "abc" after padding
-	 * is 0x61626380.
-	 */
-
 	/*
 	 * Initialize hash values (first 32 bits of the fractional parts of the square roots of the first 8 primes
 	 * 2..19):
 	 */
-	uint32_t h[]
-		= { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
-	unsigned i, j;
-
-	/* 512-bit chunks is what we will operate on. */
-	uint8_t chunk[CHUNK_SIZE];
+	static const uint32_t h[] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
 
-	struct buffer_state state;
+	memcpy(sha->h, h, sizeof(h));
+	sha->chunk_len = 0;
+	sha->total_len = 0;
+}
 
-	init_buf_state(&state, input, len);
+/*
+ * Data can be fed in pieces of any size, the result is the same as hashing
+ * the concatenation of all pieces at once.
+ */
+void
+sha_256_write(struct sha_256 *sha, const void *input, size_t len)
+{
+	const uint8_t *p = input;
+	sha->total_len += len;
 
-	const uint8_t *p;
+	if (sha->chunk_len) {
+		size_t n = CHUNK_SIZE - sha->chunk_len;
+		if (n > len) {
+			n = len;
+		}
 
-	while ((p = calc_chunk(chunk, &state))) {
-		uint32_t ah[8];
+		memcpy(&sha->chunk[sha->chunk_len], p, n);
+		sha->chunk_len += n;
+		p += n;
+		len -= n;
 
-		/* Initialize working variables to current hash value: */
-		for (i = 0; i < 8; i++) {
-			ah[i] = h[i];
+		if (sha->chunk_len < CHUNK_SIZE) {
+			return;
 		}
 
-		/*
-		 * The w-array is really w[64], but since we only need 16 of them at a time, we save stack by
-		 * calculating 16 at a time.
-		 *
-		 * This optimization was not there initially and the rest of the comments about w[64] are kept in their
-		 * initial state.
-		 */
+		consume_chunk(sha->h, sha->chunk);
+		sha->chunk_len = 0;
+	}
 
-		/*
-		 * create a 64-entry message schedule array w[0..63] of 32-bit words (The initial values in w[0..63]
-		 * don't matter, so many implementations zero them here) copy chunk into first 16 words w[0..15] of the
-		 * message schedule array
-		 */
-		uint32_t w[16];
+	/* For whole chunks, there is no need to copy data, we just consume the original chunk. */
+	while (len >= CHUNK_SIZE) {
+		consume_chunk(sha->h, p);
+		p += CHUNK_SIZE;
+		len -= CHUNK_SIZE;
+	}
 
-		/* Compression function main loop: */
-		for (i = 0; i < 4; i++) {
-			for (j = 0; j < 16; j++) {
-				if (i == 0) {
-					w[j] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8
-					       | (uint32_t)p[3];
-					p += 4;
-				} else {
-					/* Extend the first 16 words into the remaining 48 words w[16..63] of the
-					 * message schedule array: */
-					const uint32_t s0 = right_rot(w[(j + 1) & 0xf], 7)
-							    ^ right_rot(w[(j + 1) & 0xf], 18) ^ (w[(j + 1) & 0xf] >> 3);
-					const uint32_t s1 = right_rot(w[(j + 14) & 0xf], 17)
-							    ^ right_rot(w[(j + 14) & 0xf], 19)
-							    ^ (w[(j + 14) & 0xf] >> 10);
-					w[j] = w[j] + s0 + w[(j + 9) & 0xf] + s1;
-				}
-				const uint32_t s1 = right_rot(ah[4], 6) ^ right_rot(ah[4], 11) ^ right_rot(ah[4], 25);
-				const uint32_t ch = (ah[4] & ah[5]) ^ (~ah[4] & ah[6]);
-				const uint32_t temp1 = ah[7] + s1 + ch + k[i << 4 | j] + w[j];
-				const uint32_t s0 = right_rot(ah[0], 2) ^ right_rot(ah[0], 13) ^ right_rot(ah[0], 22);
-				const uint32_t maj = (ah[0] & ah[1]) ^ (ah[0] & ah[2]) ^ (ah[1] & ah[2]);
-				const uint32_t temp2 = s0 + maj;
+	memcpy(sha->chunk, p, len);
+	sha->chunk_len = len;
+}
 
-				ah[7] = ah[6];
-				ah[6] = ah[5];
-				ah[5] = ah[4];
-				ah[4] = ah[3] + temp1;
-				ah[3] = ah[2];
-				ah[2] = ah[1];
-				ah[1] = ah[0];
-				ah[0] = temp1 + temp2;
-			}
-		}
+void
+sha_256_close(struct sha_256 *sha, uint8_t hash[32])
+{
+	unsigned i, j;
+	uint8_t *chunk = &sha->chunk[sha->chunk_len];
+	size_t space_in_chunk = CHUNK_SIZE - sha->chunk_len;
 
-		/* Add the compressed chunk to the current hash value: */
-		for (i = 0; i < 8; i++) {
-			h[i] += ah[i];
-		}
+	/* There is always at least one byte of space left in the chunk. */
+	*chunk++ = 0x80;
+	space_in_chunk -= 1;
+
+	/*
+	 * Either there is enough space left for the total length, or we have to pad the rest of this chunk with
+	 * zeroes and put the length in another one.
+	 */
+	if (space_in_chunk < TOTAL_LEN_LEN) {
+		memset(chunk, 0x00, space_in_chunk);
+		consume_chunk(sha->h, sha->chunk);
+		chunk = sha->chunk;
+		space_in_chunk = CHUNK_SIZE;
+	}
+
+	const size_t left = space_in_chunk - TOTAL_LEN_LEN;
+	size_t len = sha->total_len;
+	int k;
+	memset(chunk, 0x00, left);
+	chunk += left;
+
+	/* Storing of len * 8 as a big endian 64-bit without overflow. */
+	chunk[7] = (uint8_t)(len << 3);
+	len >>= 5;
+	for (k = 6; k >= 0; k--) {
+		chunk[k] = (uint8_t)len;
+		len >>= 8;
 	}
+	consume_chunk(sha->h, sha->chunk);
 
 	/* Produce the final hash value (big-endian): */
 	for (i = 0, j = 0; i < 8; i++) {
-		hash[j++] = (uint8_t)(h[i] >> 24);
-		hash[j++] = (uint8_t)(h[i] >> 16);
-		hash[j++] = (uint8_t)(h[i] >> 8);
-		hash[j++] = (uint8_t)h[i];
+		hash[j++] = (uint8_t)(sha->h[i] >> 24);
+		hash[j++] = (uint8_t)(sha->h[i] >> 16);
+		hash[j++] = (uint8_t)(sha->h[i] >> 8);
+		hash[j++] = (uint8_t)sha->h[i];
 	}
 }
+
+/*
+ * Limitations:
+ * - SHA algorithms theoretically operate on bit strings. However, this implementation has no support for bit string
+ *   lengths that are not multiples of eight, and it really operates on arrays of bytes.  In particular, the len
+ *   parameter is a number of bytes.
+ */
+void
+calc_sha_256(uint8_t hash[32], const void *input, size_t len)
+{
+	struct sha_256 sha;
+	sha_256_init(&sha);
+	sha_256_write(&sha, input, len);
+	sha_256_close(&sha, hash);
+}
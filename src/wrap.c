@@ -234,19 +234,17 @@ wrap_parse_provides_cb(void *_ctx,
 }
 
 static bool
-checksum(const uint8_t *file_buf, uint64_t len, const char *sha256)
+checksum_verify(const uint8_t hash[32], const char *sha256)
 {
 	char buf[3] = { 0 };
 	uint32_t i;
-	uint8_t b, hash[32];
+	uint8_t b;
 
 	if (strlen(sha256) != 64) {
 		LOG_E("checksum '%s' is not 64 characters long", sha256);
 		return false;
 	}
 
-	calc_sha_256(hash, file_buf, len);
-
 	for (i = 0; i < 64; i += 2) {
 		memcpy(buf, &sha256[i], 2);
 		b = strtol(buf, NULL, 16);
@@ -262,98 +260,20 @@ checksum(const uint8_t *file_buf, uint64_t len, const char *sha256)
 static bool
 checksum_extract(const char *buf, size_t len, const char *sha256, const char *dest_dir)
 {
-	if (sha256 && !checksum((const uint8_t *)buf, len, sha256)) {
-		return false;
-	} else if (!muon_archive_extract(buf, len, dest_dir)) {
-		return false;
-	}
-
-	return true;
-}
-
-static bool
-fetch_checksum_extract(const char *src, const char *dest, const char *sha256, const char *dest_dir)
-{
-	bool res = false;
-	uint8_t *dlbuf = NULL;
-	uint64_t dlbuf_len;
+	if (sha256) {
+		uint8_t hash[32];
+		calc_sha_256(hash, buf, len);
 
-	muon_curl_init();
-
-	if (!muon_curl_fetch(src, &dlbuf, &dlbuf_len)) {
-		goto ret;
-	} else if (!checksum_extract((const char *)dlbuf, dlbuf_len, sha256, dest_dir)) {
-		goto ret;
-	}
-
-	res = true;
-ret:
-	if (dlbuf) {
-		z_free(dlbuf);
-	}
-	muon_curl_deinit();
-	return res;
-}
-
-static bool
-wrap_download_or_check_packagefiles(const char *filename,
-	const char *url,
-	const char *hash,
-	const char *subprojects,
-	const char *dest_dir,
-	bool download)
-{
-	bool res = false;
-	SBUF_manual(source_path);
-
-	path_join(NULL, &source_path, subprojects, "packagefiles");
-	path_push(NULL, &source_path, filename);
-
-	if (fs_file_exists(source_path.buf)) {
-		if (!hash) {
-			LOG_W("local file '%s' specified without a hash", source_path.buf);
-		}
-
-		if (url) {
-			LOG_W("url specified, but local file '%s' is being used", source_path.buf);
-		}
-
-		struct source src = { 0 };
-		if (!fs_read_entire_file(source_path.buf, &src)) {
-			goto ret;
-		}
-
-		if (!checksum_extract(src.src, src.len, hash, dest_dir)) {
-			fs_source_destroy(&src);
-			goto ret;
-		}
-
-		fs_source_destroy(&src);
-
-		res = true;
-	} else if (fs_dir_exists(source_path.buf)) {
-		if (url) {
-			LOG_W("url specified, but local directory '%s' is being used", source_path.buf);
-		}
-
-		if (!fs_copy_dir(source_path.buf, dest_dir)) {
-			goto ret;
+		if (!checksum_verify(hash, sha256)) {
+			return false;
 		}
+	}
 
-		res = true;
-	} else if (url) {
-		if (!download) {
-			LOG_E("wrap downloading is disabled");
-			goto ret;
-		}
-		res = fetch_checksum_extract(url, filename, hash, dest_dir);
-	} else {
-		LOG_E("no url specified, but '%s' is not a file or directory", source_path.buf);
+	if (!muon_archive_extract(buf, len, dest_dir)) {
+		return false;
 	}
 
-ret:
-	sbuf_destroy(&source_path);
-	return res;
+	return true;
 }
 
 static bool
@@ -505,7 +425,7 @@ wrap_run_cmd(const char *const argv[], const char *chdir, const char *feed)
 }
 
 static bool
-wrap_apply_diff_files(struct wrap *wrap, const char *subprojects, const char *dest_dir)
+wrap_apply_diff_files(struct wrap *wrap, const char *subprojects)
 {
 	bool res = false;
 	SBUF_manual(packagefiles);
@@ -570,128 +490,511 @@ ret:
 }
 
 static bool
-wrap_apply_patch(struct wrap *wrap, const char *subprojects, bool download)
+wrap_handle_git(struct wrap *wrap)
 {
-	const char *dest_dir, *filename = NULL;
-	if (wrap->fields[wf_patch_directory]) {
-		dest_dir = wrap->dest_dir.buf;
-		filename = wrap->fields[wf_patch_directory];
+	if (!wrap_run_cmd((const char *const[]){ "git", "clone", wrap->fields[wf_url], wrap->dest_dir.buf, NULL },
+		    NULL,
+		    NULL)) {
+		return false;
+	}
+
+	if (!wrap_run_cmd(
+		    (const char *const[]){
+			    "git", "-c", "advice.detachedHead=false", "checkout", wrap->fields[wf_revision], "--", NULL },
+		    wrap->dest_dir.buf,
+		    NULL)) {
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Wraps are handled as jobs made up of a source step and a patch step,
+ * followed by applying diff_files.  Steps backed by a remote url are
+ * downloaded concurrently with every other job's downloads, and each step is
+ * applied as soon as its data is available and the steps before it have
+ * completed.
+ */
+
+enum wrap_step_state {
+	wrap_step_state_none,
+	wrap_step_state_fetch,
+	wrap_step_state_ready,
+	wrap_step_state_done,
+	wrap_step_state_failed,
+};
+
+struct wrap_step {
+	struct wrap_job *job;
+	enum wrap_step_state state;
+	const char *filename, *url, *hash, *dest_dir;
+	bool downloaded;
+	struct sha_256 sha;
+	uint8_t *buf;
+	uint64_t len, cap;
+};
+
+struct wrap_job {
+	struct wrap *wrap;
+	const char *subprojects;
+	struct wrap_step source, patch;
+	bool done, ok;
+};
+
+static bool
+wrap_step_init(struct wrap_job *job,
+	struct wrap_step *step,
+	const char *filename,
+	const char *url,
+	const char *hash,
+	const char *dest_dir,
+	bool download)
+{
+	*step = (struct wrap_step){
+		.job = job,
+		.filename = filename,
+		.url = url,
+		.hash = hash,
+		.dest_dir = dest_dir,
+	};
+
+	if (!filename) {
+		return true;
+	}
+
+	bool res = false;
+	SBUF_manual(source_path);
+
+	path_join(NULL, &source_path, job->subprojects, "packagefiles");
+	path_push(NULL, &source_path, filename);
+
+	if (fs_file_exists(source_path.buf) || fs_dir_exists(source_path.buf)) {
+		step->state = wrap_step_state_ready;
+	} else if (url) {
+		if (!download) {
+			LOG_E("wrap downloading is disabled");
+			goto ret;
+		}
+
+		step->state = wrap_step_state_fetch;
+		step->downloaded = true;
+		sha_256_init(&step->sha);
 	} else {
-		dest_dir = subprojects;
-		filename = wrap->fields[wf_patch_filename];
+		LOG_E("no url specified, but '%s' is not a file or directory", source_path.buf);
+		goto ret;
 	}
 
-	if (filename) {
-		if (!wrap_download_or_check_packagefiles(filename,
-			    wrap->fields[wf_patch_url],
-			    wrap->fields[wf_patch_hash],
-			    subprojects,
-			    dest_dir,
-			    download)) {
-			return false;
+	res = true;
+ret:
+	sbuf_destroy(&source_path);
+	return res;
+}
+
+static bool
+wrap_step_apply_local(struct wrap_step *step)
+{
+	bool res = false;
+	SBUF_manual(source_path);
+
+	path_join(NULL, &source_path, step->job->subprojects, "packagefiles");
+	path_push(NULL, &source_path, step->filename);
+
+	if (fs_file_exists(source_path.buf)) {
+		if (!step->hash) {
+			LOG_W("local file '%s' specified without a hash", source_path.buf);
+		}
+
+		if (step->url) {
+			LOG_W("url specified, but local file '%s' is being used", source_path.buf);
+		}
+
+		struct source src = { 0 };
+		if (!fs_read_entire_file(source_path.buf, &src)) {
+			goto ret;
+		}
+
+		if (!checksum_extract(src.src, src.len, step->hash, step->dest_dir)) {
+			fs_source_destroy(&src);
+			goto ret;
+		}
+
+		fs_source_destroy(&src);
+	} else {
+		if (step->url) {
+			LOG_W("url specified, but local directory '%s' is being used", source_path.buf);
+		}
+
+		if (!fs_copy_dir(source_path.buf, step->dest_dir)) {
+			goto ret;
 		}
 	}
 
-	if (wrap->fields[wf_diff_files]) {
-		if (!wrap_apply_diff_files(wrap, subprojects, dest_dir)) {
-			return false;
+	res = true;
+ret:
+	sbuf_destroy(&source_path);
+	return res;
+}
+
+static void
+wrap_step_apply(struct wrap_step *step)
+{
+	bool ok;
+
+	if (step->downloaded) {
+		// the checksum was computed while the data was being received
+		ok = muon_archive_extract((const char *)step->buf, step->len, step->dest_dir);
+	} else {
+		ok = wrap_step_apply_local(step);
+	}
+
+	if (step->buf) {
+		z_free(step->buf);
+		step->buf = NULL;
+	}
+
+	step->state = ok ? wrap_step_state_done : wrap_step_state_failed;
+}
+
+static void
+wrap_job_advance(struct wrap_job *job)
+{
+	struct wrap_step *steps[] = { &job->source, &job->patch };
+	uint32_t i;
+
+	if (job->done) {
+		return;
+	}
+
+	for (i = 0; i < ARRAY_LEN(steps); ++i) {
+		if (steps[i]->state == wrap_step_state_ready) {
+			wrap_step_apply(steps[i]);
+		}
+
+		switch (steps[i]->state) {
+		case wrap_step_state_none:
+		case wrap_step_state_done: break;
+		case wrap_step_state_fetch:
+		case wrap_step_state_ready: return;
+		case wrap_step_state_failed: job->done = true; return;
 		}
 	}
 
-	return true;
+	job->done = true;
+
+	if (job->wrap->fields[wf_diff_files]) {
+		if (!wrap_apply_diff_files(job->wrap, job->subprojects)) {
+			return;
+		}
+	}
+
+	job->ok = true;
 }
 
 static bool
-wrap_handle_git(struct wrap *wrap, const char *subprojects)
+wrap_fetch_write(void *_ctx, const uint8_t *buf, uint64_t len)
 {
-	if (!wrap_run_cmd((const char *const[]){ "git", "clone", wrap->fields[wf_url], wrap->dest_dir.buf, NULL },
-		    NULL,
-		    NULL)) {
-		return false;
+	struct wrap_step *step = _ctx;
+
+	if (step->len + len > step->cap) {
+		step->cap = step->cap * 2 > step->len + len ? step->cap * 2 : step->len + len;
+		step->buf = z_realloc(step->buf, step->cap);
 	}
 
-	if (!wrap_run_cmd(
-		    (const char *const[]){
-			    "git", "-c", "advice.detachedHead=false", "checkout", wrap->fields[wf_revision], "--", NULL },
-		    wrap->dest_dir.buf,
-		    NULL)) {
-		return false;
+	memcpy(&step->buf[step->len], buf, len);
+	step->len += len;
+
+	if (step->hash) {
+		sha_256_write(&step->sha, buf, len);
 	}
 
 	return true;
 }
 
-static bool
-wrap_handle_file(struct wrap *wrap, const char *subprojects, bool download)
+static void
+wrap_fetch_done(void *_ctx, bool ok)
 {
-	const char *dest;
+	struct wrap_step *step = _ctx;
 
-	if (wrap->fields[wf_lead_directory_missing]) {
-		dest = wrap->dest_dir.buf;
-	} else {
-		dest = subprojects;
+	if (ok && step->hash) {
+		uint8_t hash[32];
+		sha_256_close(&step->sha, hash);
+		ok = checksum_verify(hash, step->hash);
 	}
 
-	if (!fs_dir_exists(dest)) {
-		if (!fs_mkdir(dest)) {
-			return false;
+	if (!ok && step->buf) {
+		z_free(step->buf);
+		step->buf = NULL;
+	}
+
+	step->state = ok ? wrap_step_state_ready : wrap_step_state_failed;
+	wrap_job_advance(step->job);
+}
+
+/*
+ * file:// urls are read directly, through the same callbacks as a network
+ * transfer.
+ */
+static void
+wrap_fetch_file_url(struct muon_curl_fetch_req *req)
+{
+	bool ok = false;
+	FILE *f;
+	uint64_t size;
+	uint8_t buf[BUF_SIZE_32k];
+	const char *path = req->url + strlen("file://");
+
+	LOG_I("fetching '%s'", req->url);
+
+	if (!(f = fs_fopen(path, "rb"))) {
+		goto ret;
+	}
+
+	if (!fs_fsize(f, &size)) {
+		goto close;
+	}
+
+	while (size) {
+		uint64_t n = size > sizeof(buf) ? sizeof(buf) : size;
+
+		if (!fs_fread(buf, n, f)) {
+			goto close;
+		} else if (!req->write(req->ctx, buf, n)) {
+			goto close;
 		}
+
+		size -= n;
 	}
 
-	return wrap_download_or_check_packagefiles(wrap->fields[wf_source_filename],
-		wrap->fields[wf_source_url],
-		wrap->fields[wf_source_hash],
-		subprojects,
-		dest,
-		download);
+	ok = true;
+close:
+	if (!fs_fclose(f)) {
+		ok = false;
+	}
+ret:
+	req->done(req->ctx, ok);
 }
 
-bool
-wrap_handle(const char *wrap_file, const char *subprojects, struct wrap *wrap, bool download)
+static bool
+wrap_job_init(struct wrap_job *job, struct wrap *wrap, const char *subprojects, bool download)
 {
 	bool res = false;
 	SBUF_manual(meson_build);
 
-	if (!wrap_parse(wrap_file, wrap)) {
-		goto ret;
-	}
+	*job = (struct wrap_job){ .wrap = wrap, .subprojects = subprojects };
 
 	path_join(NULL, &meson_build, wrap->dest_dir.buf, "meson.build");
 
 	if (fs_file_exists(meson_build.buf)) {
+		job->done = job->ok = true;
 		res = true;
 		goto ret;
 	}
 
 	switch (wrap->type) {
-	case wrap_type_file:
-		if (!wrap_handle_file(wrap, subprojects, download)) {
+	case wrap_type_file: {
+		const char *dest;
+
+		if (wrap->fields[wf_lead_directory_missing]) {
+			dest = wrap->dest_dir.buf;
+		} else {
+			dest = subprojects;
+		}
+
+		if (!fs_dir_exists(dest)) {
+			if (!fs_mkdir(dest)) {
+				goto ret;
+			}
+		}
+
+		if (!wrap_step_init(job,
+			    &job->source,
+			    wrap->fields[wf_source_filename],
+			    wrap->fields[wf_source_url],
+			    wrap->fields[wf_source_hash],
+			    dest,
+			    download)) {
 			goto ret;
 		}
 		break;
+	}
 	case wrap_type_git:
 		if (!download) {
 			LOG_E("wrap downloading disabled");
 			goto ret;
 		}
 
-		if (!wrap_handle_git(wrap, subprojects)) {
+		if (!wrap_handle_git(wrap)) {
 			goto ret;
 		}
 		break;
 	default: assert(false && "unreachable"); goto ret;
 	}
 
-	if (!wrap_apply_patch(wrap, subprojects, download)) {
+	const char *dest_dir, *filename = NULL;
+	if (wrap->fields[wf_patch_directory]) {
+		dest_dir = wrap->dest_dir.buf;
+		filename = wrap->fields[wf_patch_directory];
+	} else {
+		dest_dir = subprojects;
+		filename = wrap->fields[wf_patch_filename];
+	}
+
+	if (!wrap_step_init(job,
+		    &job->patch,
+		    filename,
+		    wrap->fields[wf_patch_url],
+		    wrap->fields[wf_patch_hash],
+		    dest_dir,
+		    download)) {
 		goto ret;
 	}
 
 	res = true;
 ret:
+	if (!res) {
+		job->done = true;
+	}
 	sbuf_destroy(&meson_build);
 	return res;
 }
 
+static void
+wrap_job_destroy(struct wrap_job *job)
+{
+	if (job->source.buf) {
+		z_free(job->source.buf);
+	}
+
+	if (job->patch.buf) {
+		z_free(job->patch.buf);
+	}
+}
+
+static bool
+wrap_run_jobs(struct wrap_job *jobs, uint32_t len, uint32_t parallel)
+{
+	uint32_t i, j;
+	struct arr reqs;
+	bool res = true;
+
+	arr_init(&reqs, 8, sizeof(struct muon_curl_fetch_req));
+
+	for (i = 0; i < len; ++i) {
+		// apply everything that is available locally up front
+		wrap_job_advance(&jobs[i]);
+	}
+
+	for (i = 0; i < len; ++i) {
+		struct wrap_step *steps[] = { &jobs[i].source, &jobs[i].patch };
+
+		for (j = 0; j < ARRAY_LEN(steps); ++j) {
+			if (steps[j]->state != wrap_step_state_fetch) {
+				continue;
+			}
+
+			struct muon_curl_fetch_req req = {
+				.url = steps[j]->url,
+				.ctx = steps[j],
+				.write = wrap_fetch_write,
+				.done = wrap_fetch_done,
+			};
+
+			if (str_startswith(&WKSTR(req.url), &WKSTR("file://"))) {
+				wrap_fetch_file_url(&req);
+			} else {
+				arr_push(&reqs, &req);
+			}
+		}
+	}
+
+	if (reqs.len) {
+		muon_curl_init();
+		muon_curl_fetch_all((struct muon_curl_fetch_req *)reqs.e, reqs.len, parallel ? parallel : 1);
+		muon_curl_deinit();
+	}
+
+	for (i = 0; i < len; ++i) {
+		struct wrap_step *steps[] = { &jobs[i].source, &jobs[i].patch };
+
+		for (j = 0; j < ARRAY_LEN(steps); ++j) {
+			// a fetch that was never started, e.g. because curl failed
+			// to initialize
+			if (steps[j]->state == wrap_step_state_fetch) {
+				steps[j]->state = wrap_step_state_failed;
+			}
+		}
+
+		wrap_job_advance(&jobs[i]);
+		assert(jobs[i].done);
+
+		if (!jobs[i].ok) {
+			LOG_E("failed to setup wrap '%s'", jobs[i].wrap->name.buf);
+			res = false;
+		}
+	}
+
+	arr_destroy(&reqs);
+	return res;
+}
+
+bool
+wrap_handle(const char *wrap_file, const char *subprojects, struct wrap *wrap, bool download)
+{
+	if (!wrap_parse(wrap_file, wrap)) {
+		return false;
+	}
+
+	struct wrap_job job;
+	if (!wrap_job_init(&job, wrap, subprojects, download)) {
+		return false;
+	}
+
+	// the source and patch of a single wrap can still be fetched in
+	// parallel
+	bool res = wrap_run_jobs(&job, 1, 2);
+	wrap_job_destroy(&job);
+	return res;
+}
+
+bool
+wrap_handle_all(const char *const wrap_files[], uint32_t len, const char *subprojects, uint32_t parallel)
+{
+	uint32_t i, jobs_len = 0;
+	bool res = true;
+	struct wrap *wraps = z_calloc(len, sizeof(struct wrap));
+	struct wrap_job *jobs = z_calloc(len, sizeof(struct wrap_job));
+
+	for (i = 0; i < len; ++i) {
+		if (!wrap_parse(wrap_files[i], &wraps[jobs_len])) {
+			res = false;
+			continue;
+		}
+
+		if (!wrap_job_init(&jobs[jobs_len], &wraps[jobs_len], subprojects, true)) {
+			LOG_E("failed to setup wrap '%s'", wraps[jobs_len].name.buf);
+			wrap_destroy(&wraps[jobs_len]);
+			res = false;
+			continue;
+		}
+
+		++jobs_len;
+	}
+
+	if (!wrap_run_jobs(jobs, jobs_len, parallel)) {
+		res = false;
+	}
+
+	for (i = 0; i < jobs_len; ++i) {
+		wrap_job_destroy(&jobs[i]);
+		wrap_destroy(&wraps[i]);
+	}
+
+	z_free(jobs);
+	z_free(wraps);
+	return res;
+}
+
 struct wrap_load_all_ctx {
 	struct workspace *wk;
 	const char *subprojects;
@@ -0,0 +1,248 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+ * Times insert, hit, miss and unset on struct hash, for fixed size and string
+ * keys, at a few table sizes.  Only the hash table and what it needs are
+ * linked in, so the numbers aren't buried under interpreter overhead like
+ * they are in dict.meson.
+ */
+
+#include "compat.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datastructures/hash.h"
+#include "error.h"
+#include "log.h"
+#include "platform/timer.h"
+
+// The hash table only logs before aborting, so these stand in for the rest
+// of muon.
+void
+log_print(bool nl, enum log_level lvl, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+
+	if (nl) {
+		fputc('\n', stderr);
+	}
+}
+
+void
+error_unrecoverable(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	abort();
+}
+
+enum bench_op {
+	bench_op_insert,
+	bench_op_hit,
+	bench_op_miss,
+	bench_op_unset,
+	bench_op_count,
+};
+
+static const char *bench_op_names[bench_op_count] = {
+	[bench_op_insert] = "insert",
+	[bench_op_hit] = "hit",
+	[bench_op_miss] = "miss",
+	[bench_op_unset] = "unset",
+};
+
+struct bench_keys {
+	bool str;
+	uint32_t n;
+	// 2 * n keys, the second half is never inserted
+	uint64_t *nums;
+	char *strs;
+};
+
+enum {
+	bench_str_key_len = 24,
+	// Roughly the same number of operations at every size.
+	bench_ops = 1 << 21,
+};
+
+static void
+bench_keys_init(struct bench_keys *keys, bool str, uint32_t n)
+{
+	uint32_t i;
+
+	*keys = (struct bench_keys){ .str = str, .n = n };
+
+	if (str) {
+		keys->strs = calloc((size_t)n * 2, bench_str_key_len);
+		for (i = 0; i < n * 2; ++i) {
+			snprintf(&keys->strs[i * bench_str_key_len], bench_str_key_len, "src/file_%" PRIu32 ".c", i);
+		}
+	} else {
+		keys->nums = calloc((size_t)n * 2, sizeof(uint64_t));
+		for (i = 0; i < n * 2; ++i) {
+			keys->nums[i] = (uint64_t)i * 0x9e3779b97f4a7c15u;
+		}
+	}
+}
+
+static void
+bench_keys_destroy(struct bench_keys *keys)
+{
+	free(keys->nums);
+	free(keys->strs);
+}
+
+static void
+bench_init(struct hash *h, const struct bench_keys *keys)
+{
+	if (keys->str) {
+		hash_init_str(h, 8);
+	} else {
+		hash_init(h, 8, sizeof(uint64_t));
+	}
+}
+
+static void
+bench_set(struct hash *h, const struct bench_keys *keys, uint32_t i)
+{
+	if (keys->str) {
+		const char *s = &keys->strs[i * bench_str_key_len];
+		hash_set_strn(h, s, strlen(s), i);
+	} else {
+		hash_set(h, &keys->nums[i], i);
+	}
+}
+
+static uint64_t *
+bench_get(struct hash *h, const struct bench_keys *keys, uint32_t i)
+{
+	if (keys->str) {
+		const char *s = &keys->strs[i * bench_str_key_len];
+		return hash_get_strn(h, s, strlen(s));
+	} else {
+		return hash_get(h, &keys->nums[i]);
+	}
+}
+
+static void
+bench_unset(struct hash *h, const struct bench_keys *keys, uint32_t i)
+{
+	if (keys->str) {
+		const char *s = &keys->strs[i * bench_str_key_len];
+		hash_unset_strn(h, s, strlen(s));
+	} else {
+		hash_unset(h, &keys->nums[i]);
+	}
+}
+
+static void
+bench_fill(struct hash *h, const struct bench_keys *keys)
+{
+	uint32_t i;
+	bench_init(h, keys);
+	for (i = 0; i < keys->n; ++i) {
+		bench_set(h, keys, i);
+	}
+}
+
+/*
+ * Returns the time taken by op in seconds, over rounds runs of n operations.
+ * Tables are built outside of the timed region, except for insert.
+ */
+static float
+bench_run(enum bench_op op, const struct bench_keys *keys, uint32_t rounds, uint64_t *found)
+{
+	struct hash h;
+	struct timer t;
+	float secs = 0;
+	uint32_t r, i;
+	uint64_t *v;
+
+	if (op == bench_op_hit || op == bench_op_miss) {
+		bench_fill(&h, keys);
+	}
+
+	for (r = 0; r < rounds; ++r) {
+		if (op == bench_op_unset) {
+			bench_fill(&h, keys);
+		}
+
+		timer_start(&t);
+		switch (op) {
+		case bench_op_insert: bench_fill(&h, keys); break;
+		case bench_op_hit:
+		case bench_op_miss: {
+			const uint32_t base = op == bench_op_miss ? keys->n : 0;
+			for (i = 0; i < keys->n; ++i) {
+				if ((v = bench_get(&h, keys, base + i))) {
+					*found += *v;
+				}
+			}
+			break;
+		}
+		case bench_op_unset:
+			for (i = 0; i < keys->n; ++i) {
+				bench_unset(&h, keys, i);
+			}
+			*found += h.len;
+			break;
+		default: abort();
+		}
+		secs += timer_read(&t);
+
+		if (op == bench_op_insert || op == bench_op_unset) {
+			*found += h.len;
+			hash_destroy(&h);
+		}
+	}
+
+	if (op == bench_op_hit || op == bench_op_miss) {
+		hash_destroy(&h);
+	}
+
+	return secs;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const uint32_t sizes[] = { 64, 1024, 16384 };
+	uint32_t size_i, str, op, rounds;
+	uint64_t found = 0;
+	struct bench_keys keys;
+	float secs;
+
+	for (str = 0; str < 2; ++str) {
+		for (size_i = 0; size_i < sizeof(sizes) / sizeof(sizes[0]); ++size_i) {
+			bench_keys_init(&keys, str, sizes[size_i]);
+			rounds = bench_ops / keys.n;
+
+			for (op = 0; op < bench_op_count; ++op) {
+				secs = bench_run(op, &keys, rounds, &found);
+				printf("%-4s %-6s %6" PRIu32 " keys: %7.2f ns/op\n",
+					str ? "str" : "int",
+					bench_op_names[op],
+					keys.n,
+					secs * 1e9 / ((double)rounds * keys.n));
+			}
+
+			bench_keys_destroy(&keys);
+		}
+	}
+
+	// Keep the lookups from being optimized out.
+	return found == UINT64_MAX;
+}
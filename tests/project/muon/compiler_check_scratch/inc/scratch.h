@@ -0,0 +1,9 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef SCRATCH_H
+#define SCRATCH_H
+#define SCRATCH_HEADER 1
+#endif
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "scratch.h"
+
+int
+main(void)
+{
+	return SCRATCH_DEP + SCRATCH_HEADER == 2 ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+int
+lib_add(int a, int b)
+{
+	return a + b;
+}
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+int lib_add(int a, int b);
+
+int
+main(void)
+{
+	return lib_add(1, 2) == 3 ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+int one(void);
+int two(void);
+int three(void);
+int four(void);
+
+int
+main(void)
+{
+	return one() + two() + three() + four() == 10 ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#if defined(UNITY_CHECK) && !defined(TWO_C_INCLUDED)
+#error "three.c should be built together with two.c"
+#endif
+
+int
+three(void)
+{
+	return 3;
+}
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#define TWO_C_INCLUDED
+
+int
+two(void)
+{
+	return 2;
+}
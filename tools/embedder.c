@@ -9,6 +9,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "embedded.h"
 
 static bool
 embed(const char *path, const char *embedded_name)
@@ -38,6 +41,54 @@ embed(const char *path, const char *embedded_name)
 	return fclose(f) == 0;
 }
 
+/*
+ * Find a seed for embedded_hash that maps each name to a distinct slot, so
+ * that embedded_get can find a file with a single probe.
+ */
+static bool
+write_slots(char *const names[], uint32_t len)
+{
+	uint8_t slots[256];
+	uint32_t size = 2, seed, i;
+	while (size < len * 2) {
+		size *= 2;
+	}
+
+	for (; size <= sizeof(slots); size *= 2) {
+		for (seed = 0; seed < 1 << 16; ++seed) {
+			memset(slots, 0, size);
+
+			for (i = 0; i < len; ++i) {
+				uint8_t *slot = &slots[embedded_hash(names[i * 2], seed) & (size - 1)];
+				if (*slot) {
+					break;
+				}
+
+				*slot = i + 1;
+			}
+
+			if (i == len) {
+				goto found;
+			}
+		}
+	}
+
+	fprintf(stderr, "unable to find a perfect hash for the embedded files\n");
+	return false;
+found:
+	printf("static const uint32_t embedded_seed = %d;\n"
+	       "static const uint8_t embedded_slots[%d] = {\n",
+		seed,
+		size);
+
+	for (i = 0; i < size; ++i) {
+		printf("%d, ", slots[i]);
+	}
+
+	printf("\n};\n");
+	return true;
+}
+
 int
 main(int argc, char *const argv[])
 {
@@ -58,4 +109,8 @@ main(int argc, char *const argv[])
 	}
 
 	printf("};\n");
+
+	if (!write_slots(&argv[2], (argc - 1) / 2)) {
+		return 1;
+	}
 }